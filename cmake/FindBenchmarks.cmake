@@ -0,0 +1,15 @@
+# LibreSprite
+# Copyright (C) 2026  LibreSprite contributors
+# Find benchmarks and add rules to compile them (they aren't run by ctest)
+
+function(find_benchmarks dir dependencies)
+  file(GLOB benchmarks ${CMAKE_CURRENT_SOURCE_DIR}/${dir}/*_benchmark.cpp)
+  list(REMOVE_AT ARGV 0)
+
+  foreach(benchmarksourcefile ${benchmarks})
+    get_filename_component(benchmarkname ${benchmarksourcefile} NAME_WE)
+
+    add_executable(${benchmarkname} ${benchmarksourcefile})
+    target_link_libraries(${benchmarkname} ${ARGV} ${PLATFORM_LIBS})
+  endforeach()
+endfunction()
@@ -74,6 +74,7 @@
 #include "ui/intern.h"
 #include "ui/ui.h"
 
+#include <cstdlib>
 #include <iostream>
 
 namespace app {
@@ -232,8 +233,11 @@ void App::initialize(const AppOptions& options)
     std::string filenameFormat;
     std::string frameTagName;
     std::string frameRange;
+    bool streamFrames = false;
 
-    for (const auto& value : options.values()) {
+    const auto& values = options.values();
+    for (auto it=values.begin(); it!=values.end(); ++it) {
+      const auto& value = *it;
       const AppOptions::Option* opt = value.option();
 
       // Special options/commands
@@ -351,6 +355,24 @@ void App::initialize(const AppOptions& options)
         else if (opt == &options.filenameFormat()) {
           filenameFormat = value.value();
         }
+        // --stream-frames
+        else if (opt == &options.streamFrames()) {
+          streamFrames = true;
+        }
+        // --compression-level <level>
+        else if (opt == &options.compressionLevel()) {
+          const std::string& str = value.value();
+          char* end = nullptr;
+          long level = (str.empty() ? -1: std::strtol(str.c_str(), &end, 10));
+          if (!end || *end != 0 || level < 0 || level > 9)
+            throw std::runtime_error("--compression-level must be a number from 0 to 9\n"
+                                     "Usage: --compression-level 9");
+
+          // Just for this session (the option isn't saved)
+          auto& option = preferences().general.aseCompressionLevel;
+          option(int(level));
+          option.cleanDirtyFlag();
+        }
         // --save-as <filename>
         else if (opt == &options.saveAs()) {
           Document* doc = nullptr;
@@ -525,6 +547,25 @@ void App::initialize(const AppOptions& options)
       else {
         const std::string& filename = base::normalize_path(value.value());
 
+        // --stream-frames <filename> --save-as <filename>: Convert
+        // the file without opening the document (it's possible only
+        // if we don't have to modify or export it)
+        auto next = it+1;
+        if (streamFrames &&
+            next != values.end() &&
+            next->option() == &options.saveAs() &&
+            cropParams.empty() && !trim && !m_exporter &&
+            !splitLayersSaveAs && importLayerSaveAs.empty() &&
+            !listLayers && !listTags) {
+          streamFrames = false;
+          convert_document_frames(ctx, filename.c_str(),
+                                  next->value().c_str(),
+                                  filenameFormat.c_str());
+          it = next;
+          continue;
+        }
+        streamFrames = false;
+
         app::Document* oldDoc = ctx->activeDocument();
 
         Command* openCommand = CommandsModule::instance()->getCommandByName(CommandId::OpenFile);
@@ -29,6 +29,8 @@ AppOptions::AppOptions(int argc, const char* argv[])
   , m_shell(m_po.add("shell").description("Start an interactive console to execute scripts"))
   , m_batch(m_po.add("batch").mnemonic('b').description("Do not start the UI"))
   , m_saveAs(m_po.add("save-as").requiresValue("<filename>").description("Save the last given document with other format"))
+  , m_streamFrames(m_po.add("stream-frames").description("Save the next given file with the next --save-as\nframe by frame without loading the whole\nanimation (only for sequences of images)"))
+  , m_compressionLevel(m_po.add("compression-level").requiresValue("<level>").description("Compression level to save .ase files\n(0=no compression, 1=fastest, 9=maximum)"))
   , m_scale(m_po.add("scale").requiresValue("<factor>").description("Resize all previous opened documents"))
   , m_shrinkTo(m_po.add("shrink-to").requiresValue("width,height").description("Shrink each sprite if it is\nlarger than width or height"))
   , m_data(m_po.add("data").requiresValue("<filename.json>").description("File to store the sprite sheet metadata"))
@@ -41,6 +41,8 @@ public:
 
   // Export options
   const Option& saveAs() const { return m_saveAs; }
+  const Option& streamFrames() const { return m_streamFrames; }
+  const Option& compressionLevel() const { return m_compressionLevel; }
   const Option& scale() const { return m_scale; }
   const Option& shrinkTo() const { return m_shrinkTo; }
   const Option& data() const { return m_data; }
@@ -83,6 +85,8 @@ private:
   Option& m_shell;
   Option& m_batch;
   Option& m_saveAs;
+  Option& m_streamFrames;
+  Option& m_compressionLevel;
   Option& m_scale;
   Option& m_shrinkTo;
   Option& m_data;
@@ -82,6 +82,16 @@ size_t Cmd::memSize() const
   return onMemSize();
 }
 
+void Cmd::spill()
+{
+  onSpill();
+}
+
+size_t Cmd::trackMemSize(const MemSizeCounter& counter)
+{
+  return onTrackMemSize(counter);
+}
+
 void Cmd::onExecute()
 {
   // Do nothing
@@ -112,4 +122,15 @@ size_t Cmd::onMemSize() const {
   return sizeof(*this);
 }
 
+void Cmd::onSpill()
+{
+  // Do nothing
+}
+
+size_t Cmd::onTrackMemSize(const MemSizeCounter& counter)
+{
+  // By default all the memory is included in onMemSize()
+  return 0;
+}
+
 } // namespace app
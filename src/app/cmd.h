@@ -11,12 +11,19 @@
 #include "doc/sprite_position.h"
 #include "undo/undo_command.h"
 
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <string>
 
 namespace app {
   class Context;
 
+  // Memory used by the commands of an undo history. It's shared with
+  // the commands (and their background tasks) to report changes in
+  // their memory use (see Cmd::trackMemSize()).
+  typedef std::shared_ptr<std::atomic<size_t>> MemSizeCounter;
+
   class Cmd : public undo::UndoCommand {
   public:
     Cmd();
@@ -30,8 +37,22 @@ namespace app {
     void dispose() override;
 
     std::string label() const;
+
+    // Memory used by the command, without the memory reported through
+    // trackMemSize().
     size_t memSize() const;
 
+    // Moves the data needed to undo/redo this command to disk (see
+    // UndoSpillFile), it's used for commands far from the current
+    // undo state.
+    void spill();
+
+    // Returns the memory used by data that can change in other
+    // threads (e.g. data compressed in background), and from now on
+    // the command adds any change of it to "counter". A nullptr
+    // counter stops the reports.
+    size_t trackMemSize(const MemSizeCounter& counter);
+
     Context* context() const { return m_ctx; }
 
   protected:
@@ -41,6 +62,8 @@ namespace app {
     virtual void onFireNotifications();
     virtual std::string onLabel() const;
     virtual size_t onMemSize() const;
+    virtual void onSpill();
+    virtual size_t onTrackMemSize(const MemSizeCounter& counter);
 
   private:
     Context* m_ctx;
@@ -93,7 +93,7 @@ void AddCel::addCel(Layer* layer, std::shared_ptr<Cel> cel)
   ev.sprite(layer->sprite());
   ev.layer(layer);
   ev.cel(cel);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onAddCel, ev);
+  doc->notifyCelEvent(&DocumentObserver::onAddCel, ev);
 }
 
 void AddCel::removeCel(Layer* layer, std::shared_ptr<Cel> cel)
@@ -103,7 +103,7 @@ void AddCel::removeCel(Layer* layer, std::shared_ptr<Cel> cel)
   ev.sprite(layer->sprite());
   ev.layer(layer);
   ev.cel(cel);
-  doc->notifyObservers<DocumentEvent&>(&DocumentObserver::onRemoveCel, ev);
+  doc->notifyCelEvent(&DocumentObserver::onRemoveCel, ev);
 
   static_cast<LayerImage*>(layer)->removeCel(cel);
   layer->incrementVersion();
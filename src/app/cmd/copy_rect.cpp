@@ -13,8 +13,6 @@
 
 #include "doc/image.h"
 
-#include <algorithm>
-
 namespace app {
 namespace cmd {
 
@@ -27,19 +25,8 @@ CopyRect::CopyRect(Image* dst, const Image* src, const gfx::Clip& clip)
         src->width(), src->height()))
     return;
 
-  // Fill m_data with "src" data
-
-  int lineSize = src->getRowStrideSize(m_clip.size.w);
-  m_data.resize(static_cast<long>(lineSize) * m_clip.size.h);
-
-  auto it = m_data.begin();
-  for (int v=0; v<m_clip.size.h; ++v) {
-    uint8_t* addr = src->getPixelAddress(
-      m_clip.dst.x, m_clip.dst.y+v);
-
-    std::copy(addr, addr+lineSize, it);
-    it += lineSize;
-  }
+  // Save "src" pixels
+  m_payload.reset(new RowsPayload(src, gfx::Region(m_clip.dstBounds())));
 }
 
 void CopyRect::onExecute()
@@ -59,32 +46,16 @@ void CopyRect::onRedo()
 
 void CopyRect::swap()
 {
-  if (m_clip.size.w < 1 || m_clip.size.h < 1)
+  if (!m_payload)
     return;
 
   Image* image = this->image();
-  int lineSize = this->lineSize();
-  std::vector<uint8_t> tmp(lineSize);
-
-  auto it = m_data.begin();
-  for (int v=0; v<m_clip.size.h; ++v) {
-    uint8_t* addr = image->getPixelAddress(
-      m_clip.dst.x, m_clip.dst.y+v);
 
-    std::copy(addr, addr+lineSize, tmp.begin());
-    std::copy(it, it+lineSize, addr);
-    std::copy(tmp.begin(), tmp.end(), it);
-
-    it += lineSize;
-  }
+  m_payload->swap(image);
+  m_payload->compressInBackground();
 
   image->incrementVersion();
 }
 
-int CopyRect::lineSize()
-{
-  return image()->getRowStrideSize(m_clip.size.w);
-}
-
 } // namespace cmd
 } // namespace app
@@ -8,10 +8,11 @@
 #pragma once
 
 #include "app/cmd.h"
+#include "app/cmd/rows_payload.h"
 #include "app/cmd/with_image.h"
 #include "gfx/clip.h"
 
-#include <vector>
+#include <memory>
 
 namespace doc {
   class Image;
@@ -30,16 +31,24 @@ namespace cmd {
     void onExecute() override;
     void onUndo() override;
     void onRedo() override;
+    // The memory of the saved pixels is reported by the RowsPayload
+    // (it can change in a background thread)
     size_t onMemSize() const override {
-      return sizeof(*this) + m_data.size();
+      return sizeof(*this);
+    }
+    void onSpill() override {
+      if (m_payload)
+        m_payload->spill();
+    }
+    size_t onTrackMemSize(const MemSizeCounter& counter) override {
+      return (m_payload ? m_payload->trackMemSize(counter): 0);
     }
 
   private:
     void swap();
-    int lineSize();
 
     gfx::Clip m_clip;
-    std::vector<uint8_t> m_data;
+    std::unique_ptr<RowsPayload> m_payload;
   };
 
 } // namespace cmd
@@ -13,8 +13,6 @@
 
 #include "doc/image.h"
 
-#include <algorithm>
-
 namespace app {
 namespace cmd {
 
@@ -23,10 +21,10 @@ CopyRegion::CopyRegion(Image* dst, const Image* src,
                        const gfx::Point& dstPos,
                        bool alreadyCopied)
   : WithImage(dst)
-  , m_size(0)
   , m_alreadyCopied(alreadyCopied)
 {
   // Create region to save/swap later
+  gfx::Region dstRegion;
   for (const auto& rc : region) {
     gfx::Clip clip(
       rc.x+dstPos.x, rc.y+dstPos.y,
@@ -36,25 +34,19 @@ CopyRegion::CopyRegion(Image* dst, const Image* src,
           src->width(), src->height()))
       continue;
 
-    m_region.createUnion(m_region, gfx::Region(clip.dstBounds()));
+    dstRegion.createUnion(dstRegion, gfx::Region(clip.dstBounds()));
   }
 
   // Save region pixels
-  for (const auto& rc : m_region) {
-    for (int y=0; y<rc.h; ++y) {
-      m_stream.write(
-        (const char*)src->getPixelAddress(rc.x-dstPos.x,
-                                          rc.y-dstPos.y+y),
-        src->getRowStrideSize(rc.w));
-    }
-  }
-  m_size = size_t(m_stream.tellp());
+  m_payload.reset(new RowsPayload(src, dstRegion, dstPos));
 }
 
 void CopyRegion::onExecute()
 {
   if (!m_alreadyCopied)
     swap();
+  else
+    m_payload->compressInBackground();
 }
 
 void CopyRegion::onUndo()
@@ -71,27 +63,8 @@ void CopyRegion::swap()
 {
   Image* image = this->image();
 
-  // Save current image region in "tmp" stream
-  std::stringstream tmp;
-  for (const auto& rc : m_region)
-    for (int y=0; y<rc.h; ++y)
-      tmp.write(
-        (const char*)image->getPixelAddress(rc.x, rc.y+y),
-        image->getRowStrideSize(rc.w));
-
-  // Restore m_stream into the image
-  m_stream.seekg(0, std::ios_base::beg);
-  for (const auto& rc : m_region) {
-    for (int y=0; y<rc.h; ++y) {
-      m_stream.read(
-        (char*)image->getPixelAddress(rc.x, rc.y+y),
-        image->getRowStrideSize(rc.w));
-    }
-  }
-
-  // TODO use m_stream.swap(tmp) when clang and gcc support it
-  m_stream.str(tmp.str());
-  m_stream.clear();
+  m_payload->swap(image);
+  m_payload->compressInBackground();
 
   image->incrementVersion();
 }
@@ -8,11 +8,12 @@
 #pragma once
 
 #include "app/cmd.h"
+#include "app/cmd/rows_payload.h"
 #include "app/cmd/with_image.h"
 #include "gfx/point.h"
 #include "gfx/region.h"
 
-#include <sstream>
+#include <memory>
 
 namespace app {
 namespace cmd {
@@ -34,17 +35,24 @@ namespace cmd {
     void onExecute() override;
     void onUndo() override;
     void onRedo() override;
+    // The memory of the saved pixels is reported by the RowsPayload
+    // (it can change in a background thread)
     size_t onMemSize() const override {
-      return sizeof(*this) + m_size;
+      return sizeof(*this);
+    }
+    void onSpill() override {
+      if (m_payload)
+        m_payload->spill();
+    }
+    size_t onTrackMemSize(const MemSizeCounter& counter) override {
+      return (m_payload ? m_payload->trackMemSize(counter): 0);
     }
 
   private:
     void swap();
 
-    size_t m_size;
     bool m_alreadyCopied;
-    gfx::Region m_region;
-    std::stringstream m_stream;
+    std::unique_ptr<RowsPayload> m_payload;
   };
 
 } // namespace cmd
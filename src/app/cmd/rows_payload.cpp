@@ -0,0 +1,262 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/cmd/rows_payload.h"
+
+#include "app/task_manager.h"
+#include "app/undo_spill_file.h"
+#include "base/buffer.h"
+#include "base/debug.h"
+#include "base/exception.h"
+#include "base/lz_rows.h"
+#include "doc/image.h"
+
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace app {
+namespace cmd {
+
+struct RowsPayload::Data {
+  doc::PixelFormat pixelFormat;
+  gfx::Region region;
+  std::size_t rawSize = 0;
+
+  // Protects the following fields, which are shared with the
+  // background compression task.
+  mutable std::mutex mutex;
+  std::shared_ptr<const base::buffer> raw;
+  base::buffer compressed;
+  // Incremented each time the pixels are swapped, so the result of a
+  // compression of old pixels is discarded.
+  int generation = 0;
+  bool compressing = false;
+  // True if the pixels were moved to the UndoSpillFile.
+  bool spilled = false;
+  bool spilledCompressed = false;
+  UndoSpillFile::Entry spillEntry;
+  MemSizeCounter sizeCounter;
+
+  ~Data() {
+    if (spilled)
+      UndoSpillFile::release(spillEntry);
+  }
+
+  size_t memSize() const {
+    return sizeof(Data)
+      + (raw ? raw->size(): 0)
+      + compressed.size();
+  }
+
+  // Adds the difference between memSize() and "oldSize" to the
+  // counter of the undo history.
+  void reportMemSize(size_t oldSize) {
+    if (sizeCounter) {
+      *sizeCounter += memSize();
+      *sizeCounter -= oldSize;
+    }
+  }
+
+  // Calls func(x, y, size) for each row of the region.
+  template<typename Func>
+  void forEachRow(Func func) const {
+    for (const auto& rc : region) {
+      const int size = doc::calculate_rowstride_bytes(pixelFormat, rc.w);
+      for (int y=0; y<rc.h; ++y)
+        func(rc.x, rc.y+y, size);
+    }
+  }
+};
+
+RowsPayload::RowsPayload(const doc::Image* src,
+                         const gfx::Region& region,
+                         const gfx::Point& srcOffset)
+  : m_data(std::make_shared<Data>())
+{
+  m_data->pixelFormat = src->pixelFormat();
+  m_data->region = region;
+  m_data->forEachRow([this](int x, int y, int size){
+      m_data->rawSize += size;
+    });
+
+  auto raw = std::make_shared<base::buffer>(m_data->rawSize);
+  uint8_t* p = raw->data();
+  m_data->forEachRow([&p, src, srcOffset](int x, int y, int size){
+      std::memcpy(p, src->getPixelAddress(x-srcOffset.x, y-srcOffset.y), size);
+      p += size;
+    });
+  m_data->raw = raw;
+}
+
+void RowsPayload::swap(doc::Image* image)
+{
+  ASSERT(image->pixelFormat() == m_data->pixelFormat);
+
+  std::lock_guard<std::mutex> lock(m_data->mutex);
+  const size_t oldSize = m_data->memSize();
+
+  // Read spilled pixels before touching the image (or this payload)
+  std::shared_ptr<const base::buffer> raw = m_data->raw;
+  const base::buffer* compressed = &m_data->compressed;
+  base::buffer data;
+  if (!raw && m_data->spilled) {
+    data.resize(m_data->spillEntry.size);
+    UndoSpillFile* file = UndoSpillFile::instance();
+    if (!file || !file->read(m_data->spillEntry, data.data()))
+      throw base::Exception("Cannot read undo data from disk");
+
+    if (m_data->spilledCompressed)
+      compressed = &data;
+    else
+      raw = std::make_shared<base::buffer>(std::move(data));
+  }
+
+  // Save the current image pixels and restore the saved ones
+  auto current = std::make_shared<base::buffer>(m_data->rawSize);
+  uint8_t* p = current->data();
+  if (raw) {
+    const uint8_t* q = raw->data();
+    m_data->forEachRow([&p, &q, image](int x, int y, int size){
+        uint8_t* row = image->getPixelAddress(x, y);
+        std::memcpy(p, row, size);
+        std::memcpy(row, q, size);
+        p += size;
+        q += size;
+      });
+  }
+  else {
+    // Decompress the saved pixels directly in the image rows (the
+    // previous row needed by the reader is kept in the image)
+    base::LzRowsReader reader(compressed->data(), compressed->size());
+    bool ok = true;
+    m_data->forEachRow([&reader, &p, &ok, image](int x, int y, int size){
+        if (ok) {
+          uint8_t* row = image->getPixelAddress(x, y);
+          std::memcpy(p, row, size);
+          ok = reader.readRow(row, size);
+          p += size;
+        }
+      });
+
+    if (!ok) {
+      // Restore the modified rows of the image
+      const uint8_t* q = current->data();
+      m_data->forEachRow([&q, p, image](int x, int y, int size){
+          if (q < p) {
+            std::memcpy(image->getPixelAddress(x, y), q, size);
+            q += size;
+          }
+        });
+      throw base::Exception("Undo data is corrupted");
+    }
+  }
+
+  if (m_data->spilled) {
+    UndoSpillFile::release(m_data->spillEntry);
+    m_data->spilled = false;
+  }
+  base::buffer().swap(m_data->compressed);
+  ++m_data->generation;
+  m_data->compressing = false;
+
+  m_data->raw = current;
+  m_data->reportMemSize(oldSize);
+}
+
+void RowsPayload::compressInBackground()
+{
+  std::shared_ptr<const base::buffer> raw;
+  int generation;
+  {
+    std::lock_guard<std::mutex> lock(m_data->mutex);
+    if (!m_data->raw || m_data->rawSize == 0 || m_data->compressing)
+      return;
+
+    raw = m_data->raw;
+    generation = m_data->generation;
+    m_data->compressing = true;
+  }
+
+  std::shared_ptr<Data> data = m_data;
+  TaskManager::instance().addTask<bool>(
+    [data, raw, generation]() -> bool {
+      base::buffer compressed;
+      {
+        base::LzRowsWriter writer(compressed);
+        const uint8_t* p = raw->data();
+        data->forEachRow([&writer, &p](int x, int y, int size){
+            writer.writeRow(p, size);
+            p += size;
+          });
+      }
+
+      std::lock_guard<std::mutex> lock(data->mutex);
+      if (data->generation == generation) {
+        data->compressing = false;
+
+        // Keep the raw pixels if they cannot be compressed
+        if (compressed.size() < raw->size()) {
+          const size_t oldSize = data->memSize();
+          compressed.shrink_to_fit();
+          data->compressed = std::move(compressed);
+          data->raw.reset();
+          data->reportMemSize(oldSize);
+        }
+      }
+      return true;
+    },
+    [](bool&&){ },
+    []{ });
+}
+
+void RowsPayload::spill()
+{
+  std::lock_guard<std::mutex> lock(m_data->mutex);
+  if (m_data->spilled || m_data->rawSize == 0)
+    return;
+
+  UndoSpillFile* file = UndoSpillFile::instance();
+  if (!file)
+    return;
+
+  // Spill the raw pixels if they are still being compressed (the
+  // result of the compression will be discarded)
+  const bool isCompressed = !m_data->raw;
+  const base::buffer& data = (isCompressed ? m_data->compressed: *m_data->raw);
+  if (!file->write(data.data(), data.size(), m_data->spillEntry))
+    return;
+
+  const size_t oldSize = m_data->memSize();
+  ++m_data->generation;
+  m_data->compressing = false;
+  m_data->spilled = true;
+  m_data->spilledCompressed = isCompressed;
+  m_data->raw.reset();
+  base::buffer().swap(m_data->compressed);
+  m_data->reportMemSize(oldSize);
+}
+
+size_t RowsPayload::memSize() const
+{
+  std::lock_guard<std::mutex> lock(m_data->mutex);
+  return m_data->memSize();
+}
+
+size_t RowsPayload::trackMemSize(const MemSizeCounter& counter)
+{
+  std::lock_guard<std::mutex> lock(m_data->mutex);
+  m_data->sizeCounter = counter;
+  return m_data->memSize();
+}
+
+} // namespace cmd
+} // namespace app
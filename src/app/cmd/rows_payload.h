@@ -0,0 +1,64 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#pragma once
+
+#include "app/cmd.h"
+#include "base/disable_copying.h"
+#include "gfx/point.h"
+#include "gfx/region.h"
+
+#include <cstddef>
+#include <memory>
+
+namespace doc {
+  class Image;
+}
+
+namespace app {
+namespace cmd {
+
+  // Pixels of a region of an image saved by a command to be swapped
+  // with the image pixels on undo/redo. Pixels are copied raw (so
+  // saving them is fast), and then they are compressed in a
+  // background thread.
+  class RowsPayload {
+  public:
+    // Saves the pixels of "region" (in "dst" coordinates) from "src",
+    // where the region is moved by "-srcOffset" to read "src".
+    RowsPayload(const doc::Image* src,
+                const gfx::Region& region,
+                const gfx::Point& srcOffset = gfx::Point(0, 0));
+
+    // Exchanges the saved pixels with the pixels of the region in the
+    // given image. Throws an exception if spilled pixels cannot be
+    // read or the compressed pixels are corrupted (in that case the
+    // image is not modified).
+    void swap(doc::Image* image);
+
+    // Starts compressing the saved pixels in a background thread.
+    void compressInBackground();
+
+    // Moves the saved pixels to the UndoSpillFile. They are read back
+    // in the next swap().
+    void spill();
+
+    size_t memSize() const;
+
+    // Returns memSize() and reports its changes to the given counter
+    // (see Cmd::trackMemSize()).
+    size_t trackMemSize(const MemSizeCounter& counter);
+
+  private:
+    struct Data;
+    std::shared_ptr<Data> m_data;
+
+    DISABLE_COPYING(RowsPayload);
+  };
+
+} // namespace cmd
+} // namespace app
@@ -47,7 +47,7 @@ void SetCelPosition::onFireNotifications()
   DocumentEvent ev(cel->document());
   ev.sprite(cel->sprite());
   ev.cel(cel);
-  cel->document()->notifyObservers<DocumentEvent&>(&DocumentObserver::onCelPositionChanged, ev);
+  cel->document()->notifyCelEvent(&DocumentObserver::onCelPositionChanged, ev);
 }
 
 } // namespace cmd
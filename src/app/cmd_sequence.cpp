@@ -34,16 +34,36 @@ void CmdSequence::onExecute()
     (*it)->execute(context());
 }
 
+// If a command cannot be undone/redone (e.g. its data cannot be read
+// from the UndoSpillFile), the commands that were already undone/redone
+// are restored, so the sequence is never applied partially.
+
 void CmdSequence::onUndo()
 {
-  for (auto it = m_cmds.rbegin(), end=m_cmds.rend(); it!=end; ++it)
-    (*it)->undo();
+  auto it = m_cmds.rbegin(), end = m_cmds.rend();
+  try {
+    for (; it!=end; ++it)
+      (*it)->undo();
+  }
+  catch (...) {
+    for (auto jt = it.base(); jt!=m_cmds.end(); ++jt)
+      (*jt)->redo();
+    throw;
+  }
 }
 
 void CmdSequence::onRedo()
 {
-  for (auto it = m_cmds.begin(), end=m_cmds.end(); it!=end; ++it)
-    (*it)->redo();
+  auto it = m_cmds.begin(), end = m_cmds.end();
+  try {
+    for (; it!=end; ++it)
+      (*it)->redo();
+  }
+  catch (...) {
+    while (it != m_cmds.begin())
+      (*--it)->undo();
+    throw;
+  }
 }
 
 size_t CmdSequence::onMemSize() const
@@ -56,6 +76,22 @@ size_t CmdSequence::onMemSize() const
   return size;
 }
 
+void CmdSequence::onSpill()
+{
+  for (auto it = m_cmds.begin(), end=m_cmds.end(); it!=end; ++it)
+    (*it)->spill();
+}
+
+size_t CmdSequence::onTrackMemSize(const MemSizeCounter& counter)
+{
+  size_t size = 0;
+
+  for (auto it = m_cmds.begin(), end=m_cmds.end(); it!=end; ++it)
+    size += (*it)->trackMemSize(counter);
+
+  return size;
+}
+
 void CmdSequence::executeAndAdd(Cmd* cmd)
 {
   cmd->execute(context());
@@ -25,6 +25,8 @@ namespace app {
     void onUndo() override;
     void onRedo() override;
     size_t onMemSize() const override;
+    void onSpill() override;
+    size_t onTrackMemSize(const MemSizeCounter& counter) override;
 
     // Helper to create a CmdSequence in the same onExecute() member
     // function.
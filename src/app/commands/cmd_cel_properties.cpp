@@ -245,6 +245,11 @@ private:
       updateFromCel();
   }
 
+  void onBatchedChanges(DocumentEvent& ev) override {
+    if (m_cel)
+      updateFromCel();
+  }
+
   void updateFromCel() {
     if (m_selfUpdate)
       return;
@@ -19,15 +19,18 @@
 #include "app/job.h"
 #include "app/modules/editors.h"
 #include "app/modules/gui.h"
+#include "app/pref/preferences.h"
 #include "app/recent_files.h"
 #include "app/ui/status_bar.h"
 #include "app/ui_context.h"
 #include "base/bind.h"
+#include "base/convert_to.h"
 #include "base/path.h"
 #include "base/thread.h"
 #include "doc/sprite.h"
 #include "ui/ui.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <memory>
 
@@ -45,6 +48,7 @@ protected:
 private:
   std::string m_filename;
   std::string m_folder;
+  frame_t m_frame;              // Load just this frame (or -1 to load all frames)
 };
 
 class OpenFileJob : public Job, public IFileOpProgress
@@ -92,6 +96,7 @@ OpenFileCommand::OpenFileCommand()
   : Command("OpenFile",
             "Open Sprite",
             CmdRecordableFlag)
+  , m_frame(-1)
 {
 }
 
@@ -99,6 +104,14 @@ void OpenFileCommand::onLoadParams(const Params& params)
 {
   m_filename = params.get("filename");
   m_folder = params.get("folder"); // Initial folder
+
+  // Frame to load (from 1 to the number of frames), e.g. to extract
+  // one frame of a long animation from a script
+  std::string frame = params.get("frame");
+  if (!frame.empty())
+    m_frame = frame_t(std::max(0, base::convert_to<int>(frame)-1));
+  else
+    m_frame = -1;
 }
 
 void OpenFileCommand::onExecute(Context* context)
@@ -119,11 +132,28 @@ void OpenFileCommand::onExecute(Context* context)
   }
 
   if (!m_filename.empty()) {
+    // Just .ase files can be loaded from a specific frame
+    if (m_frame >= 0 &&
+        !base::has_file_extension(m_filename, "ase,aseprite")) {
+      console.printf("The \"frame\" parameter is supported by .ase files only\n");
+      return;
+    }
+
+    int flags = (m_frame >= 0 ? FILE_LOAD_SEQUENCE_NONE:
+                                FILE_LOAD_SEQUENCE_ASK);
+    if (Preferences::instance().general.linkIdenticalCels())
+      flags |= FILE_LOAD_LINK_IDENTICAL_CELS;
+    if (Preferences::instance().general.lazyCelLoading())
+      flags |= FILE_LOAD_LAZY_CELS;
+
     std::unique_ptr<FileOp> fop(
       FileOp::createLoadDocumentOperation(
-        context, m_filename.c_str(), FILE_LOAD_SEQUENCE_ASK));
+        context, m_filename.c_str(), flags));
     bool unrecent = false;
 
+    if (fop && m_frame >= 0)
+      fop->setOneFrame(m_frame);
+
     if (fop) {
       if (fop->hasError()) {
         console.printf(fop->error().c_str());
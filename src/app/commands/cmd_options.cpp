@@ -120,10 +120,20 @@ public:
     if (m_pref.general.showFullPath())
       showFullPath()->setSelected(true);
 
+    if (m_pref.general.linkIdenticalCels())
+      linkIdenticalCels()->setSelected(true);
+
+    if (m_pref.general.lazyCelLoading())
+      lazyCelLoading()->setSelected(true);
+
     dataRecoveryPeriod()->setSelectedItemIndex(
       dataRecoveryPeriod()->findItemIndexByValue(
         base::convert_to<std::string>(m_pref.general.dataRecoveryPeriod())));
 
+    aseCompressionLevel()->setSelectedItemIndex(
+      aseCompressionLevel()->findItemIndexByValue(
+        base::convert_to<std::string>(m_pref.general.aseCompressionLevel())));
+
     if (m_pref.editor.zoomFromCenterWithWheel())
       zoomFromCenterWithWheel()->setSelected(true);
 
@@ -258,6 +268,10 @@ public:
     m_pref.general.autoshowTimeline(autotimeline()->isSelected());
     m_pref.general.rewindOnStop(rewindOnStop()->isSelected());
     m_pref.general.showFullPath(showFullPath()->isSelected());
+    m_pref.general.linkIdenticalCels(linkIdenticalCels()->isSelected());
+    m_pref.general.lazyCelLoading(lazyCelLoading()->isSelected());
+    if (aseCompressionLevel()->getSelectedItemIndex() >= 0)
+      m_pref.general.aseCompressionLevel(base::convert_to<int>(aseCompressionLevel()->getValue()));
 
     bool expandOnMouseover = expandMenubarOnMouseover()->isSelected();
     m_pref.general.expandMenubarOnMouseover(expandOnMouseover);
@@ -19,6 +19,7 @@
 #include "app/document_undo_observer.h"
 #include "app/modules/gui.h"
 #include "app/modules/palettes.h"
+#include "app/pref/preferences.h"
 #include "base/bind.h"
 #include "base/mem_utils.h"
 #include "doc/context_observer.h"
@@ -154,6 +155,23 @@ private:
     refillList(history);
   }
 
+  void onDeleteUndoState(DocumentUndo* history,
+                         undo::UndoState* state) override {
+    for (auto child : actions()->children()) {
+      Item* item = static_cast<Item*>(child);
+      if (item->state() == state) {
+        delete item;
+        actions()->layout();
+        view()->updateView();
+        break;
+      }
+    }
+  }
+
+  void onTotalUndoSizeChange(DocumentUndo* history) override {
+    updateTotalSize();
+  }
+
   void attachDocument(app::Document* document) {
     detachDocument();
 
@@ -165,6 +183,7 @@ private:
     history->addObserver(this);
 
     refillList(history);
+    updateTotalSize();
   }
 
   void detachDocument() {
@@ -174,6 +193,7 @@ private:
     clearList();
     m_document->undoHistory()->removeObserver(this);
     m_document = nullptr;
+    updateTotalSize();
   }
 
   void clearList() {
@@ -208,6 +228,17 @@ private:
       actions()->selectChild(current);
   }
 
+  void updateTotalSize() {
+    if (m_document) {
+      totalSize()->setTextf(
+        "Memory: %s / %d MB",
+        base::get_pretty_memory_size(m_document->undoHistory()->totalUndoSize()).c_str(),
+        Preferences::instance().undo.sizeLimit());
+    }
+    else
+      totalSize()->setText("");
+  }
+
   void selectState(const undo::UndoState* state) {
     for (auto child : actions()->children()) {
       Item* item = static_cast<Item*>(child);
@@ -12,6 +12,7 @@
 #include "app/crash/backup_observer.h"
 
 #include "app/app.h"
+#include "app/crash/backup_scheduler.h"
 #include "app/crash/session.h"
 #include "app/document.h"
 #include "app/pref/preferences.h"
@@ -28,8 +29,16 @@ BackupObserver::BackupObserver(Session* session, doc::Context* ctx)
   : m_session(session)
   , m_ctx(ctx)
   , m_done(false)
+  , m_maxLossWindow(60.0*Preferences::instance().general.dataRecoveryPeriod())
+  , m_maxBandwidth(1024.0*1024.0*Preferences::instance().general.dataRecoveryBandwidth())
   , m_thread(base::Bind<void>(&BackupObserver::backgroundThread, this))
 {
+  auto& pref = Preferences::instance();
+  m_periodConn = pref.general.dataRecoveryPeriod.AfterChange.connect(
+    base::Bind<void>(&BackupObserver::onDataRecoveryPrefsChange, this));
+  m_bandwidthConn = pref.general.dataRecoveryBandwidth.AfterChange.connect(
+    base::Bind<void>(&BackupObserver::onDataRecoveryPrefsChange, this));
+
   m_ctx->addObserver(this);
   m_ctx->documents().addObserver(this);
 }
@@ -46,6 +55,13 @@ void BackupObserver::stop()
   m_done = true;
 }
 
+void BackupObserver::onDataRecoveryPrefsChange()
+{
+  auto& pref = Preferences::instance();
+  m_maxLossWindow = 60.0*pref.general.dataRecoveryPeriod();
+  m_maxBandwidth = 1024.0*1024.0*pref.general.dataRecoveryBandwidth();
+}
+
 void BackupObserver::onAddDocument(doc::Document* document)
 {
   TRACE("DataRecovery: Observe document %p\n", document);
@@ -56,49 +72,93 @@ void BackupObserver::onAddDocument(doc::Document* document)
 void BackupObserver::onRemoveDocument(doc::Document* document)
 {
   TRACE("DataRecovery:: Remove document %p\n", document);
-  {
-    base::scoped_lock hold(m_mutex);
-    base::remove_from_container(m_documents, static_cast<app::Document*>(document));
-  }
+
+  // We remove the document with the mutex locked so we don't delete
+  // its backup directory while a snapshot is being written.
+  base::scoped_lock hold(m_mutex);
+  base::remove_from_container(m_documents, static_cast<app::Document*>(document));
   m_session->removeDocument(static_cast<app::Document*>(document));
 }
 
 void BackupObserver::backgroundThread()
 {
-  int normalPeriod = 60*Preferences::instance().general.dataRecoveryPeriod();
+  BackupScheduler scheduler(m_maxLossWindow, m_maxBandwidth);
   int lockedPeriod = 10;
+  int estimatePeriod = 5;
 #if 0                           // Just for testing purposes
-  normalPeriod = 5;
   lockedPeriod = 5;
+  estimatePeriod = 1;
 #endif
 
-  int waitUntil = normalPeriod;
-  int seconds = 0;
+  int seconds = 0;              // Seconds since the last backup
+  int nextCheck = estimatePeriod;
 
   while (!m_done) {
     seconds++;
-    if (seconds >= waitUntil) {
-      TRACE("DataRecovery: Start backup process for %d documents\n", m_documents.size());
-
+    if (seconds >= nextCheck) {
       base::scoped_lock hold(m_mutex);
-      base::Chrono chrono;
-      bool somethingLocked = false;
+      nextCheck = seconds + estimatePeriod;
+      scheduler.setLimits(m_maxLossWindow, m_maxBandwidth);
 
+      // Estimate the size of the modified objects
+      std::size_t dirtyBytes = 0;
       for (app::Document* doc : m_documents) {
         try {
           if (doc->needsBackup())
-            m_session->saveDocumentChanges(doc);
+            dirtyBytes += m_session->estimateDocumentChanges(doc);
         }
         catch (const std::exception&) {
-          TRACE("DataRecovery: Document '%d' is locked\n", doc->id());
-          somethingLocked = true;
+          // The document is locked, we'll try again later
         }
       }
 
-      seconds = 0;
-      waitUntil = (somethingLocked ? lockedPeriod: normalPeriod);
+      if (scheduler.shouldBackup(seconds, dirtyBytes)) {
+        TRACE("DataRecovery: Start backup process for %d documents (%d bytes modified in %d seconds)\n",
+              int(m_documents.size()), int(dirtyBytes), seconds);
+
+        base::Chrono chrono;
+        bool somethingLocked = false;
+
+        // Take snapshots of modified documents (each document is locked
+        // only while its modified objects are copied)
+        std::vector<DocumentSnapshotPtr> snapshots;
+        for (app::Document* doc : m_documents) {
+          try {
+            if (doc->needsBackup())
+              snapshots.push_back(m_session->takeDocumentSnapshot(doc));
+          }
+          catch (const std::exception&) {
+            TRACE("DataRecovery: Document '%d' is locked\n", doc->id());
+            somethingLocked = true;
+          }
+        }
+
+        // Compress and write snapshots without locking documents
+        std::size_t writtenBytes = 0;
+        for (const auto& snapshot : snapshots) {
+          try {
+            m_session->writeDocumentSnapshot(snapshot);
+            writtenBytes += snapshot->size();
+          }
+          catch (const std::exception& ex) {
+            TRACE("DataRecovery: Error saving document '%d': %s\n",
+                  snapshot->docId, ex.what());
+          }
+        }
+
+        scheduler.onBackupDone(writtenBytes, chrono.elapsed());
 
-      TRACE("DataRecovery: Backup process done (%.16g)\n", chrono.elapsed());
+        // If a document was locked we keep counting the time since
+        // the last backup and try again soon.
+        if (somethingLocked)
+          nextCheck = seconds + lockedPeriod;
+        else {
+          seconds = 0;
+          nextCheck = estimatePeriod;
+        }
+
+        TRACE("DataRecovery: Backup process done (%.16g)\n", chrono.elapsed());
+      }
     }
     base::this_thread::sleep_for(1.0);
   }
@@ -7,12 +7,14 @@
 
 #pragma once
 
+#include "base/connection.h"
 #include "base/mutex.h"
 #include "base/thread.h"
 #include "doc/context_observer.h"
 #include "doc/document_observer.h"
 #include "doc/documents_observer.h"
 
+#include <atomic>
 #include <vector>
 
 namespace doc {
@@ -38,12 +40,19 @@ namespace crash {
 
   private:
     void backgroundThread();
+    void onDataRecoveryPrefsChange();
 
     Session* m_session;
     base::mutex m_mutex;
     doc::Context* m_ctx;
     std::vector<app::Document*> m_documents;
     bool m_done;
+    // Limits from the preferences (they are read in the UI thread
+    // and used by the background thread).
+    std::atomic<double> m_maxLossWindow; // In seconds
+    std::atomic<double> m_maxBandwidth;  // In bytes per second
+    base::ScopedConnection m_periodConn;
+    base::ScopedConnection m_bandwidthConn;
     base::thread m_thread;
   };
 
@@ -0,0 +1,98 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/crash/backup_scheduler.h"
+
+#include <algorithm>
+
+namespace app {
+namespace crash {
+
+namespace {
+
+// Minimum number of seconds between two backups.
+const double kMinInterval = 5.0;
+
+// With this amount of modified bytes the interval is the half of the
+// max data-loss window (more bytes, shorter interval).
+const double kDirtyReference = 4.0*1024*1024;
+
+// The interval is at least a quarter of the max data-loss window
+// (unless the window is shorter than kMinInterval).
+const double kMinWindowFraction = 0.25;
+
+// A backup cannot take more than 1/kMaxDutyFactor of the time.
+const double kMaxDutyFactor = 10.0;
+
+// Initial throughput until we measure the first backup.
+const double kInitialThroughput = 16.0*1024*1024;
+
+// Weight of the last measured backup in the throughput estimation.
+const double kThroughputAlpha = 0.3;
+
+} // anonymous namespace
+
+BackupScheduler::BackupScheduler(double maxLossWindow, double maxBandwidth)
+  : m_throughput(kInitialThroughput)
+{
+  setLimits(maxLossWindow, maxBandwidth);
+}
+
+void BackupScheduler::setLimits(double maxLossWindow, double maxBandwidth)
+{
+  m_maxLossWindow = std::max(maxLossWindow, kMinInterval);
+  m_maxBandwidth = maxBandwidth;
+}
+
+bool BackupScheduler::shouldBackup(double elapsed, std::size_t dirtyBytes) const
+{
+  if (dirtyBytes == 0)
+    return false;
+
+  return (elapsed >= interval(dirtyBytes));
+}
+
+double BackupScheduler::interval(std::size_t dirtyBytes) const
+{
+  // Back up sooner if a lot of data was modified
+  double fraction = 1.0 / (1.0 + double(dirtyBytes) / kDirtyReference);
+  double result = m_maxLossWindow * std::max(fraction, kMinWindowFraction);
+
+  // If few things were modified, it isn't worth to do an expensive
+  // backup too soon
+  result = std::max(result, kMaxDutyFactor * estimatedCost(dirtyBytes));
+  result = std::min(result, m_maxLossWindow);
+
+  // Bandwidth limit
+  if (m_maxBandwidth > 0.0)
+    result = std::max(result, double(dirtyBytes) / m_maxBandwidth);
+
+  return std::max(result, kMinInterval);
+}
+
+double BackupScheduler::estimatedCost(std::size_t bytes) const
+{
+  return double(bytes) / m_throughput;
+}
+
+void BackupScheduler::onBackupDone(std::size_t bytes, double seconds)
+{
+  // Too small backups don't give a good estimation
+  if (bytes < 64*1024 || seconds <= 0.001)
+    return;
+
+  m_throughput =
+    (1.0-kThroughputAlpha) * m_throughput +
+    kThroughputAlpha * (double(bytes) / seconds);
+}
+
+} // namespace crash
+} // namespace app
@@ -0,0 +1,54 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#pragma once
+
+#include <cstddef>
+
+namespace app {
+namespace crash {
+
+  // Decides when the next backup must be done. The interval between
+  // backups is shorter when there are a lot of modified bytes, and
+  // longer when a backup is expensive (it's estimated measuring the
+  // throughput of previous backups) and few things were modified.
+  //
+  // The interval never exceeds the "max data-loss window", except
+  // when it's needed to keep the average I/O under the given
+  // bandwidth limit.
+  class BackupScheduler {
+  public:
+    BackupScheduler(double maxLossWindow,  // In seconds
+                    double maxBandwidth);  // In bytes per second
+
+    // Changes the limits (e.g. when the user changes the
+    // preferences). The estimated throughput is kept.
+    void setLimits(double maxLossWindow, double maxBandwidth);
+
+    // Returns true if a backup should be done now, "elapsed" are the
+    // seconds since the last backup and "dirtyBytes" the estimated
+    // size of the modified objects.
+    bool shouldBackup(double elapsed, std::size_t dirtyBytes) const;
+
+    // Returns the number of seconds to wait since the last backup
+    // with the given amount of modified bytes.
+    double interval(std::size_t dirtyBytes) const;
+
+    // Estimated seconds needed to write the given bytes.
+    double estimatedCost(std::size_t bytes) const;
+
+    // Updates the throughput estimation with a finished backup.
+    void onBackupDone(std::size_t bytes, double seconds);
+
+  private:
+    double m_maxLossWindow;
+    double m_maxBandwidth;
+    double m_throughput;        // Estimated bytes per second
+  };
+
+} // namespace crash
+} // namespace app
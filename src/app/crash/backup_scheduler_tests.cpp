@@ -0,0 +1,98 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#include "tests/test.h"
+
+#include "app/crash/backup_scheduler.h"
+
+using namespace app::crash;
+
+namespace {
+
+const std::size_t MB = 1024*1024;
+
+} // anonymous namespace
+
+TEST(BackupScheduler, NothingModified)
+{
+  BackupScheduler scheduler(120.0, 8.0*MB);
+  EXPECT_FALSE(scheduler.shouldBackup(0.0, 0));
+  EXPECT_FALSE(scheduler.shouldBackup(1000.0, 0));
+}
+
+TEST(BackupScheduler, IntervalInsideLossWindow)
+{
+  BackupScheduler scheduler(120.0, 0.0);
+
+  // Few bytes: we wait the whole window
+  EXPECT_NEAR(120.0, scheduler.interval(1), 0.01);
+  EXPECT_FALSE(scheduler.shouldBackup(119.0, 1));
+  EXPECT_TRUE(scheduler.shouldBackup(120.0, 1));
+
+  // More modified bytes, shorter intervals (but not less than a
+  // quarter of the window)
+  EXPECT_LT(scheduler.interval(4*MB), scheduler.interval(1*MB));
+  scheduler.setLimits(600.0, 0.0);
+  EXPECT_DOUBLE_EQ(150.0, scheduler.interval(64*MB));
+}
+
+TEST(BackupScheduler, MinInterval)
+{
+  BackupScheduler scheduler(1.0, 0.0);
+  EXPECT_DOUBLE_EQ(5.0, scheduler.interval(1));
+  EXPECT_DOUBLE_EQ(5.0, scheduler.interval(1000*MB));
+}
+
+TEST(BackupScheduler, BandwidthLimit)
+{
+  BackupScheduler scheduler(120.0, 1.0*MB);
+  EXPECT_NEAR(120.0, scheduler.interval(1), 0.01);
+
+  // 600 MB with 1 MB/s cannot be written more than once every 600
+  // seconds, even if it exceeds the max data-loss window
+  EXPECT_DOUBLE_EQ(600.0, scheduler.interval(600*MB));
+}
+
+TEST(BackupScheduler, ExpensiveBackups)
+{
+  BackupScheduler scheduler(600.0, 0.0);
+  EXPECT_DOUBLE_EQ(150.0, scheduler.interval(16*MB));
+
+  // Slow disk (1 MB/s): a backup of 16 MB takes 16 seconds, so we
+  // wait 160 seconds at least
+  for (int i=0; i<50; ++i)
+    scheduler.onBackupDone(16*MB, 16.0);
+  EXPECT_NEAR(16.0, scheduler.estimatedCost(16*MB), 0.01);
+  EXPECT_NEAR(160.0, scheduler.interval(16*MB), 0.1);
+
+  // But the max data-loss window is still the limit
+  EXPECT_DOUBLE_EQ(600.0, scheduler.interval(100*MB));
+}
+
+TEST(BackupScheduler, SmallBackupsDontChangeThroughput)
+{
+  BackupScheduler scheduler(120.0, 0.0);
+  double cost = scheduler.estimatedCost(4*MB);
+  scheduler.onBackupDone(1024, 10.0);
+  scheduler.onBackupDone(4*MB, 0.0);
+  EXPECT_DOUBLE_EQ(cost, scheduler.estimatedCost(4*MB));
+}
+
+TEST(BackupScheduler, SetLimits)
+{
+  BackupScheduler scheduler(120.0, 0.0);
+  for (int i=0; i<50; ++i)
+    scheduler.onBackupDone(4*MB, 4.0);
+  double cost = scheduler.estimatedCost(4*MB);
+
+  scheduler.setLimits(300.0, 1.0*MB);
+  EXPECT_NEAR(300.0, scheduler.interval(1), 0.01);
+  EXPECT_DOUBLE_EQ(600.0, scheduler.interval(600*MB));
+
+  // The measured throughput is kept
+  EXPECT_DOUBLE_EQ(cost, scheduler.estimatedCost(4*MB));
+}
@@ -14,6 +14,7 @@
 #include "app/crash/backup_observer.h"
 #include "app/crash/session.h"
 #include "app/resource_finder.h"
+#include "app/undo_spill_file.h"
 #include "base/fs.h"
 #include "base/path.h"
 #include "base/time.h"
@@ -78,6 +79,9 @@ DataRecovery::DataRecovery(doc::Context* ctx)
   m_inProgress->create(pid);
   TRACE("DataRecovery: Session in progress '%s'\n", newSessionDir.c_str());
 
+  // Old undo data is moved to the session directory
+  UndoSpillFile::setDirectory(newSessionDir);
+
   m_backup = new BackupObserver(m_inProgress.get(), ctx);
 }
 
@@ -86,6 +90,10 @@ DataRecovery::~DataRecovery()
   m_backup->stop();
   delete m_backup;
 
+  // Delete the undo spill file from the session directory (all
+  // documents are already closed)
+  UndoSpillFile::setDirectory(std::string());
+
   if (m_inProgress)
     m_inProgress->removeFromDisk();
 
@@ -0,0 +1,327 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/crash/pack_file.h"
+
+#include "app/crash/internals.h"
+#include "base/exception.h"
+#include "base/fs.h"
+#include "base/fstream_path.h"
+#include "base/path.h"
+#include "base/serialization.h"
+#include "doc/string_io.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace app {
+namespace crash {
+
+using namespace base::serialization;
+using namespace base::serialization::little_endian;
+
+namespace {
+
+const uint32_t RECORD_MAGIC = 0x424F4B50; // 'PKOB' in ASCII
+const uint32_t INDEX_MAGIC = 0x58494B50;  // 'PKIX' in ASCII
+
+// Number of versions kept for each object
+const std::size_t kMaxVersions = 2;
+
+// The pack file is compacted when it's bigger than this size and
+// the double of the latest versions size.
+const uint64_t kMinCompactSize = 4*1024*1024;
+
+// Record = magic + prefix + id + version + size + data + MAGIC_NUMBER
+uint64_t record_size(const PackFile::Entry& entry)
+{
+  return 4 + 2 + entry.prefix.size() + 4 + 4 + 4 + entry.size + 4;
+}
+
+void write64(std::ostream& os, uint64_t value)
+{
+  write32(os, uint32_t(value));
+  write32(os, uint32_t(value >> 32));
+}
+
+uint64_t read64(std::istream& is)
+{
+  uint64_t lo = read32(is);
+  uint64_t hi = read32(is);
+  return lo | (hi << 32);
+}
+
+void write_record(std::ostream& os, const PackFile::Entry& entry,
+                  const char* data)
+{
+  // Create the whole record in memory to write it in one call
+  std::ostringstream s;
+  write32(s, RECORD_MAGIC);
+  doc::write_string(s, entry.prefix);
+  write32(s, entry.id);
+  write32(s, entry.version);
+  write32(s, entry.size);
+  s.write(data, entry.size);
+  write32(s, MAGIC_NUMBER);
+
+  const std::string record = s.str();
+  os.write(record.c_str(), record.size());
+}
+
+// Replaces "dst" with "src" (on POSIX it's an atomic operation)
+void replace_file(const std::string& src, const std::string& dst)
+{
+#ifdef _WIN32
+  if (base::is_file(dst))
+    base::delete_file(dst);
+#endif
+  base::move_file(src, dst);
+}
+
+} // anonymous namespace
+
+PackFile::PackFile(const std::string& dir)
+  : m_packFn(base::join_path(dir, "objects.pack"))
+  , m_indexFn(base::join_path(dir, "objects.idx"))
+  , m_packSize(0)
+  , m_liveSize(0)
+{
+}
+
+// static
+bool PackFile::exists(const std::string& dir)
+{
+  return base::is_file(base::join_path(dir, "objects.pack"));
+}
+
+void PackFile::load()
+{
+  m_objects.clear();
+  m_liveSize = 0;
+  m_packSize = 0;
+
+  // The program was closed in the middle of a compaction (after the
+  // compacted file was completely written)
+  const std::string tmpFn = m_packFn + ".tmp";
+  if (!base::is_file(m_packFn) && base::is_file(tmpFn))
+    replace_file(tmpFn, m_packFn);
+
+  if (!base::is_file(m_packFn))
+    return;
+
+  uint64_t indexedSize = 0;
+  if (!loadIndex(indexedSize)) {
+    m_objects.clear();
+    m_liveSize = 0;
+    indexedSize = 0;
+  }
+  scanRecords(indexedSize);
+}
+
+bool PackFile::read(const Entry& entry, std::string& data) const
+{
+  std::ifstream s(FSTREAM_PATH(m_packFn), std::ifstream::binary);
+  if (!s)
+    return false;
+
+  s.seekg(std::streamoff(entry.offset));
+  data.resize(entry.size);
+  s.read(&data[0], entry.size);
+  return (s && read32(s) == MAGIC_NUMBER);
+}
+
+void PackFile::add(const char* prefix, doc::ObjectId id,
+                   doc::ObjectVersion version, const std::string& data)
+{
+  Entry entry;
+  entry.prefix = prefix;
+  entry.id = id;
+  entry.version = version;
+  entry.size = uint32_t(data.size());
+  entry.offset = m_packSize + record_size(entry) - entry.size - 4;
+
+  // The record is written after the last complete record (and not at
+  // the end of the file), so a partial record of a failed write is
+  // overwritten and the offsets of the next records are right.
+  std::fstream s;
+  if (base::is_file(m_packFn))
+    s.open(FSTREAM_PATH(m_packFn),
+           std::fstream::binary | std::fstream::in | std::fstream::out);
+  else
+    s.open(FSTREAM_PATH(m_packFn),
+           std::fstream::binary | std::fstream::out);
+  s.seekp(std::streamoff(m_packSize));
+  write_record(s, entry, data.c_str());
+  s.flush();
+  if (!s)
+    throw base::Exception("Error writing backup data");
+
+  m_packSize += record_size(entry);
+  addVersion(entry);
+}
+
+void PackFile::flush()
+{
+  if (m_packSize > kMinCompactSize &&
+      m_packSize > 2*m_liveSize)
+    compact();
+
+  saveIndex();
+}
+
+void PackFile::scanRecords(uint64_t from)
+{
+  std::ifstream s(FSTREAM_PATH(m_packFn), std::ifstream::binary);
+  s.seekg(std::streamoff(from));
+  m_packSize = from;
+
+  while (s) {
+    if (read32(s) != RECORD_MAGIC)
+      break;
+
+    Entry entry;
+    entry.prefix = doc::read_string(s);
+    entry.id = read32(s);
+    entry.version = read32(s);
+    entry.size = read32(s);
+    entry.offset = uint64_t(s.tellg());
+
+    s.seekg(std::streamoff(entry.size), std::ios::cur);
+    if (!s || read32(s) != MAGIC_NUMBER)
+      break;                    // Incomplete record
+
+    m_packSize = uint64_t(s.tellg());
+    addVersion(entry);
+  }
+}
+
+void PackFile::addVersion(const Entry& entry)
+{
+  Versions& versions = m_objects[entry.id];
+
+  auto it = versions.begin();
+  while (it != versions.end() && it->version > entry.version)
+    ++it;
+
+  if (it != versions.end() && it->version == entry.version) {
+    m_liveSize -= record_size(*it);
+    *it = entry;
+  }
+  else
+    versions.insert(it, entry);
+  m_liveSize += record_size(entry);
+
+  while (versions.size() > kMaxVersions) {
+    m_liveSize -= record_size(versions.back());
+    versions.pop_back();
+  }
+}
+
+bool PackFile::loadIndex(uint64_t& packSize)
+{
+  std::ifstream s(FSTREAM_PATH(m_indexFn), std::ifstream::binary);
+  if (!s || read32(s) != INDEX_MAGIC)
+    return false;
+
+  packSize = read64(s);
+  if (packSize > base::file_size(m_packFn))
+    return false;
+
+  uint32_t n = read32(s);
+  for (uint32_t i=0; i<n && s; ++i) {
+    Entry entry;
+    entry.prefix = doc::read_string(s);
+    entry.id = read32(s);
+    entry.version = read32(s);
+    entry.offset = read64(s);
+    entry.size = read32(s);
+    if (s)
+      addVersion(entry);
+  }
+  return (s && read32(s) == MAGIC_NUMBER);
+}
+
+void PackFile::saveIndex()
+{
+  std::string tmpFn = m_indexFn + ".tmp";
+  {
+    std::ofstream s(FSTREAM_PATH(tmpFn), std::ofstream::binary);
+    write32(s, INDEX_MAGIC);
+    write64(s, m_packSize);
+
+    uint32_t n = 0;
+    for (const auto& item : m_objects)
+      n += uint32_t(item.second.size());
+    write32(s, n);
+
+    for (const auto& item : m_objects) {
+      for (const Entry& entry : item.second) {
+        doc::write_string(s, entry.prefix);
+        write32(s, entry.id);
+        write32(s, entry.version);
+        write64(s, entry.offset);
+        write32(s, entry.size);
+      }
+    }
+    write32(s, MAGIC_NUMBER);
+    s.flush();
+    if (!s)
+      return;
+  }
+
+  replace_file(tmpFn, m_indexFn);
+}
+
+void PackFile::compact()
+{
+  TRACE("DataRecovery: Compacting '%s' (%d bytes, %d live bytes)\n",
+        m_packFn.c_str(), int(m_packSize), int(m_liveSize));
+
+  std::string tmpFn = m_packFn + ".tmp";
+  Objects objects;
+  uint64_t size = 0;
+  {
+    std::ofstream s(FSTREAM_PATH(tmpFn), std::ofstream::binary);
+    std::string data;
+    for (const auto& item : m_objects) {
+      Versions& versions = objects[item.first];
+      for (const Entry& entry : item.second) {
+        if (!read(entry, data))
+          continue;
+
+        Entry newEntry = entry;
+        newEntry.offset = size + record_size(entry) - entry.size - 4;
+        write_record(s, newEntry, data.c_str());
+        size += record_size(entry);
+        versions.push_back(newEntry);
+      }
+    }
+    s.flush();
+    if (!s) {
+      s.close();
+      base::delete_file(tmpFn);
+      return;
+    }
+  }
+
+  // The index is invalid from here until it's saved again (load()
+  // will scan all the records in that case).
+  if (base::is_file(m_indexFn))
+    base::delete_file(m_indexFn);
+  replace_file(tmpFn, m_packFn);
+
+  m_objects = std::move(objects);
+  m_packSize = size;
+  m_liveSize = size;
+}
+
+} // namespace crash
+} // namespace app
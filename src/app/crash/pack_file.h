@@ -0,0 +1,81 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#pragma once
+
+#include "base/disable_copying.h"
+#include "doc/object.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace app {
+namespace crash {
+
+  // Append-only file ("objects.pack") where all the versions of the
+  // objects of a document backup are saved, and an index
+  // ("objects.idx") with the position of the latest versions of each
+  // object. Only the two latest versions of each object are kept
+  // (older ones are removed when the file is compacted).
+  //
+  // Each record finishes with the MAGIC_NUMBER, so incomplete records
+  // (e.g. if the program crashes in the middle of a write) are
+  // ignored. Records added after the index was saved are found
+  // scanning the end of the pack file.
+  class PackFile {
+  public:
+    struct Entry {
+      std::string prefix;       // Type of object (e.g. "img", "cel", etc.)
+      doc::ObjectId id = 0;
+      doc::ObjectVersion version = 0;
+      uint64_t offset = 0;      // Position of the object data
+      uint32_t size = 0;
+    };
+
+    // Versions of one object, the newer one first.
+    typedef std::vector<Entry> Versions;
+    typedef std::map<doc::ObjectId, Versions> Objects;
+
+    explicit PackFile(const std::string& dir);
+
+    static bool exists(const std::string& dir);
+
+    // Reads the index and the records after it.
+    void load();
+
+    const Objects& objects() const { return m_objects; }
+
+    bool read(const Entry& entry, std::string& data) const;
+
+    // Appends a new version of the given object.
+    void add(const char* prefix, doc::ObjectId id,
+             doc::ObjectVersion version, const std::string& data);
+
+    // Saves the index, compacting the pack file if there is too much
+    // space used by old versions.
+    void flush();
+
+  private:
+    void scanRecords(uint64_t from);
+    void addVersion(const Entry& entry);
+    bool loadIndex(uint64_t& packSize);
+    void saveIndex();
+    void compact();
+
+    std::string m_packFn;
+    std::string m_indexFn;
+    uint64_t m_packSize;
+    uint64_t m_liveSize;        // Size of the latest versions
+    Objects m_objects;
+
+    DISABLE_COPYING(PackFile);
+  };
+
+} // namespace crash
+} // namespace app
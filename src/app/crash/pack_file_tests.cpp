@@ -0,0 +1,202 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#include "tests/test.h"
+
+#include "app/crash/pack_file.h"
+#include "base/fs.h"
+#include "base/path.h"
+
+#include <fstream>
+#include <string>
+
+using namespace app::crash;
+
+namespace {
+
+const char* kDir = "test_pack_file";
+
+void clean_dir()
+{
+  if (base::is_directory(kDir)) {
+    for (const std::string& fn : base::list_files(kDir))
+      base::delete_file(base::join_path(kDir, fn));
+    base::remove_directory(kDir);
+  }
+  base::make_directory(kDir);
+}
+
+std::string make_data(std::size_t size, char value)
+{
+  return std::string(size, value);
+}
+
+// Returns the data of the newer version of the given object.
+std::string read_newer(const PackFile& pack, doc::ObjectId id)
+{
+  auto it = pack.objects().find(id);
+  if (it == pack.objects().end() || it->second.empty())
+    return "<not found>";
+
+  std::string data;
+  if (!pack.read(it->second.front(), data))
+    return "<cannot read>";
+  return data;
+}
+
+} // anonymous namespace
+
+TEST(PackFile, AddAndRead)
+{
+  clean_dir();
+  EXPECT_FALSE(PackFile::exists(kDir));
+  {
+    PackFile pack(kDir);
+    pack.load();
+    EXPECT_TRUE(pack.objects().empty());
+
+    pack.add("img", 1, 1, make_data(100, 'a'));
+    pack.add("cel", 2, 1, make_data(10, 'b'));
+    pack.add("img", 1, 2, make_data(50, 'c'));
+    pack.add("img", 1, 3, make_data(20, 'd'));
+    pack.flush();
+
+    // Only the two latest versions are kept
+    ASSERT_EQ(2u, pack.objects().at(1).size());
+    EXPECT_EQ(3u, pack.objects().at(1)[0].version);
+    EXPECT_EQ(2u, pack.objects().at(1)[1].version);
+    EXPECT_EQ(make_data(20, 'd'), read_newer(pack, 1));
+    EXPECT_EQ(make_data(10, 'b'), read_newer(pack, 2));
+  }
+  EXPECT_TRUE(PackFile::exists(kDir));
+
+  // Load from the index
+  PackFile pack(kDir);
+  pack.load();
+  ASSERT_EQ(2u, pack.objects().size());
+  EXPECT_EQ("img", pack.objects().at(1)[0].prefix);
+  EXPECT_EQ(make_data(20, 'd'), read_newer(pack, 1));
+  EXPECT_EQ(make_data(10, 'b'), read_newer(pack, 2));
+
+  std::string data;
+  ASSERT_TRUE(pack.read(pack.objects().at(1)[1], data));
+  EXPECT_EQ(make_data(50, 'c'), data);
+}
+
+TEST(PackFile, ScanRecordsAfterIndex)
+{
+  clean_dir();
+  {
+    PackFile pack(kDir);
+    pack.load();
+    pack.add("img", 1, 1, make_data(100, 'a'));
+    pack.flush();
+
+    // Records that are not in the index (e.g. the program crashes
+    // before the next flush())
+    pack.add("img", 1, 2, make_data(30, 'b'));
+    pack.add("spr", 3, 1, make_data(5, 'c'));
+  }
+
+  PackFile pack(kDir);
+  pack.load();
+  ASSERT_EQ(2u, pack.objects().size());
+  EXPECT_EQ(2u, pack.objects().at(1).size());
+  EXPECT_EQ(make_data(30, 'b'), read_newer(pack, 1));
+  EXPECT_EQ(make_data(5, 'c'), read_newer(pack, 3));
+
+  // Without index all records are scanned
+  base::delete_file(base::join_path(kDir, "objects.idx"));
+  PackFile pack2(kDir);
+  pack2.load();
+  ASSERT_EQ(2u, pack2.objects().size());
+  EXPECT_EQ(make_data(30, 'b'), read_newer(pack2, 1));
+  EXPECT_EQ(make_data(5, 'c'), read_newer(pack2, 3));
+}
+
+TEST(PackFile, TruncatedTail)
+{
+  clean_dir();
+  const std::string packFn = base::join_path(kDir, "objects.pack");
+  {
+    PackFile pack(kDir);
+    pack.load();
+    pack.add("img", 1, 1, make_data(100, 'a'));
+    pack.add("img", 2, 1, make_data(100, 'b'));
+  }
+
+  // Simulate a partial write of the last record
+  const std::size_t size = base::file_size(packFn);
+  std::string content;
+  {
+    std::ifstream s(packFn, std::ifstream::binary);
+    content.resize(size);
+    s.read(&content[0], size);
+  }
+  {
+    std::ofstream s(packFn, std::ofstream::binary | std::ofstream::trunc);
+    s.write(content.c_str(), size-10);
+  }
+
+  {
+    PackFile pack(kDir);
+    pack.load();
+    ASSERT_EQ(1u, pack.objects().size());
+    EXPECT_EQ(make_data(100, 'a'), read_newer(pack, 1));
+
+    // New records replace the incomplete one
+    pack.add("img", 2, 2, make_data(40, 'c'));
+    pack.add("img", 3, 1, make_data(60, 'd'));
+    EXPECT_EQ(make_data(40, 'c'), read_newer(pack, 2));
+    EXPECT_EQ(make_data(60, 'd'), read_newer(pack, 3));
+  }
+
+  PackFile pack(kDir);
+  pack.load();
+  ASSERT_EQ(3u, pack.objects().size());
+  EXPECT_EQ(make_data(100, 'a'), read_newer(pack, 1));
+  EXPECT_EQ(make_data(40, 'c'), read_newer(pack, 2));
+  EXPECT_EQ(make_data(60, 'd'), read_newer(pack, 3));
+}
+
+TEST(PackFile, Compact)
+{
+  clean_dir();
+  const std::string packFn = base::join_path(kDir, "objects.pack");
+  const std::size_t MB = 1024*1024;
+  {
+    PackFile pack(kDir);
+    pack.load();
+    for (int ver=1; ver<=8; ++ver)
+      pack.add("img", 1, ver, make_data(MB, char('a'+ver)));
+    pack.add("cel", 2, 1, make_data(10, 'z'));
+    EXPECT_LT(8*MB, base::file_size(packFn));
+
+    // Only the two latest versions of each object are kept
+    pack.flush();
+    EXPECT_GT(3*MB, base::file_size(packFn));
+    ASSERT_EQ(2u, pack.objects().at(1).size());
+    EXPECT_EQ(make_data(MB, char('a'+8)), read_newer(pack, 1));
+    EXPECT_EQ(make_data(10, 'z'), read_newer(pack, 2));
+
+    // Records added after the compaction
+    pack.add("img", 1, 9, make_data(10, 'y'));
+    pack.flush();
+  }
+
+  PackFile pack(kDir);
+  pack.load();
+  ASSERT_EQ(2u, pack.objects().at(1).size());
+  EXPECT_EQ(9u, pack.objects().at(1)[0].version);
+  EXPECT_EQ(8u, pack.objects().at(1)[1].version);
+  EXPECT_EQ(make_data(10, 'y'), read_newer(pack, 1));
+  EXPECT_EQ(make_data(10, 'z'), read_newer(pack, 2));
+
+  std::string data;
+  ASSERT_TRUE(pack.read(pack.objects().at(1)[1], data));
+  EXPECT_EQ(make_data(MB, char('a'+8)), data);
+}
@@ -13,6 +13,7 @@
 
 #include "app/console.h"
 #include "app/crash/internals.h"
+#include "app/crash/pack_file.h"
 #include "app/document.h"
 #include "base/convert_to.h"
 #include "base/exception.h"
@@ -36,9 +37,14 @@
 #include "doc/string_io.h"
 #include "doc/subobjects_io.h"
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <map>
 #include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 namespace app {
 namespace crash {
@@ -57,6 +63,25 @@ public:
     , m_docId(0)
     , m_docVersions(nullptr)
     , m_loadInfo(nullptr) {
+    if (PackFile::exists(dir)) {
+      m_pack.reset(new PackFile(dir));
+      m_pack->load();
+      for (const auto& obj : m_pack->objects()) {
+        if (obj.second.empty())
+          continue;
+
+        const std::string& prefix = obj.second.front().prefix;
+        if (prefix == "doc") {
+          ASSERT(!m_docId || m_docId == obj.first);
+          m_docId = obj.first;
+        }
+        else if (prefix == "img")
+          m_imageIds.push_back(obj.first);
+      }
+      return;
+    }
+
+    // Old format: one file for each version of each object
     for (const auto& fn : base::list_files(dir)) {
       auto i = fn.find('-');
       if (i == std::string::npos)
@@ -71,6 +96,10 @@ public:
       if (!id || !ver)
         continue;               // Error converting strings to ID/ver
 
+      if (fn.compare(0, 3, "img") == 0 &&
+          m_objVersions.find(id) == m_objVersions.end())
+        m_imageIds.push_back(id);
+
       ObjVersions& versions = m_objVersions[id];
       versions.add(ver);
 
@@ -95,6 +124,83 @@ public:
     return doc;
   }
 
+  const PackFile* packFile() const {
+    return m_pack.get();
+  }
+
+  const std::vector<ObjectId>& imageIds() const {
+    return m_imageIds;
+  }
+
+  // Decodes the versions of the given image (newer first). If
+  // "allVersions" is false, only the latest valid version is
+  // decoded (earlier versions are used if the latest one cannot be
+  // decoded). It doesn't modify the reader, so it can be called from
+  // several threads.
+  std::vector<ImageRef> decodeImage(ObjectId imageId, bool allVersions) const {
+    std::vector<ImageRef> images;
+    auto readImage = [&images, imageId](std::istream& s, ObjectVersion ver) {
+      try {
+        ImageRef image(read_image(s, false));
+        if (image)
+          images.push_back(image);
+      }
+      catch (const std::exception& ex) {
+        (void)ex;
+        TRACE(" - Error decoding img #%d v%d: %s\n", imageId, ver, ex.what());
+      }
+    };
+
+    if (m_pack) {
+      auto it = m_pack->objects().find(imageId);
+      if (it == m_pack->objects().end())
+        return images;
+
+      for (const auto& entry : it->second) {
+        if (!allVersions && !images.empty())
+          break;
+
+        std::string data;
+        if (entry.prefix != "img" || !m_pack->read(entry, data))
+          continue;
+
+        std::istringstream s(data);
+        readImage(s, entry.version);
+      }
+    }
+    else {
+      auto it = m_objVersions.find(imageId);
+      if (it == m_objVersions.end())
+        return images;
+
+      for (size_t i=0; i<it->second.size(); ++i) {
+        if (!allVersions && !images.empty())
+          break;
+
+        ObjectVersion ver = it->second[i];
+        if (!ver)
+          continue;
+
+        std::ifstream s(FSTREAM_PATH(objectFilename("img", imageId, ver)),
+                        std::ifstream::binary);
+        if (!s || read32(s) != MAGIC_NUMBER)
+          continue;
+
+        readImage(s, ver);
+      }
+    }
+    return images;
+  }
+
+  // Uses images decoded with decodeImage() instead of loading them
+  // again when the document is read.
+  void setDecodedImages(const DecodedImages& images) {
+    for (const auto& item : images) {
+      if (!item.second.empty())
+        m_images[item.first] = item.second.front();
+    }
+  }
+
   bool loadDocumentInfo(DocumentInfo& info) {
     m_loadInfo = &info;
     return
@@ -133,7 +239,10 @@ private:
   }
 
   template<typename T>
-  T loadObject(const char* prefix, ObjectId id, T (Reader::*readMember)(std::ifstream&)) {
+  T loadObject(const char* prefix, ObjectId id, T (Reader::*readMember)(std::istream&)) {
+    if (m_pack)
+      return loadPackedObject(prefix, id, readMember);
+
     const ObjVersions& versions = m_objVersions[id];
 
     for (size_t i=0; i<versions.size(); ++i) {
@@ -143,13 +252,8 @@ private:
 
       TRACE(" - Restoring %s #%d v%d\n", prefix, id, ver);
 
-      std::string fn = prefix;
-      fn.push_back('-');
-      fn += base::convert_to<std::string>(id);
-      fn.push_back('.');
-      fn += base::convert_to<std::string>(ver);
-
-      std::ifstream s(FSTREAM_PATH(base::join_path(m_dir, fn)), std::ifstream::binary);
+      std::ifstream s(FSTREAM_PATH(objectFilename(prefix, id, ver)),
+                      std::ifstream::binary);
       T obj = nullptr;
       if (read32(s) == MAGIC_NUMBER)
         obj = (this->*readMember)(s);
@@ -170,7 +274,49 @@ private:
     return nullptr;
   }
 
-  app::Document* readDocument(std::ifstream& s) {
+  std::string objectFilename(const char* prefix, ObjectId id, ObjectVersion ver) const {
+    std::string fn = prefix;
+    fn.push_back('-');
+    fn += base::convert_to<std::string>(id);
+    fn.push_back('.');
+    fn += base::convert_to<std::string>(ver);
+    return base::join_path(m_dir, fn);
+  }
+
+  template<typename T>
+  T loadPackedObject(const char* prefix, ObjectId id, T (Reader::*readMember)(std::istream&)) {
+    auto it = m_pack->objects().find(id);
+    if (it != m_pack->objects().end()) {
+      for (const auto& entry : it->second) {
+        if (entry.prefix != prefix)
+          continue;
+
+        TRACE(" - Restoring %s #%d v%d\n", prefix, id, entry.version);
+
+        std::string data;
+        T obj = nullptr;
+        if (m_pack->read(entry, data)) {
+          std::istringstream s(data);
+          obj = (this->*readMember)(s);
+        }
+
+        if (obj) {
+          TRACE(" - %s #%d v%d restored successfully\n", prefix, id, entry.version);
+          return obj;
+        }
+        else {
+          TRACE(" - %s #%d v%d was not restored\n", prefix, id, entry.version);
+        }
+      }
+    }
+
+    if (!m_loadInfo)
+      Console().printf("Error loading object %s #%d\n", prefix, id);
+
+    return nullptr;
+  }
+
+  app::Document* readDocument(std::istream& s) {
     ObjectId sprId = read32(s);
     std::string filename = read_string(s);
 
@@ -193,7 +339,7 @@ private:
     }
   }
 
-  Sprite* readSprite(std::ifstream& s) {
+  Sprite* readSprite(std::istream& s) {
     PixelFormat format = (PixelFormat)read8(s);
     int w = read16(s);
     int h = read16(s);
@@ -217,7 +363,7 @@ private:
     if (m_loadInfo) {
       m_loadInfo->format = format;
       m_loadInfo->width = w;
-      m_loadInfo->height = w;
+      m_loadInfo->height = h;
       m_loadInfo->frames = nframes;
       return (Sprite*)1;
     }
@@ -276,7 +422,7 @@ private:
     return spr.release();
   }
 
-  Layer* readLayer(std::ifstream& s) {
+  Layer* readLayer(std::istream& s) {
     LayerFlags flags = (LayerFlags)read32(s);
     ObjectType type = (ObjectType)read16(s);
     ASSERT(type == ObjectType::LayerImage);
@@ -310,23 +456,23 @@ private:
     }
   }
 
-  Cel* readCel(std::ifstream& s) {
+  Cel* readCel(std::istream& s) {
     return read_cel(s, this, false);
   }
 
-  CelData* readCelData(std::ifstream& s) {
+  CelData* readCelData(std::istream& s) {
     return read_celdata(s, this, false);
   }
 
-  Image* readImage(std::ifstream& s) {
+  Image* readImage(std::istream& s) {
     return read_image(s, false);
   }
 
-  std::shared_ptr<Palette> readPalette(std::ifstream& s) {
+  std::shared_ptr<Palette> readPalette(std::istream& s) {
     return read_palette(s);
   }
 
-  FrameTag* readFrameTag(std::ifstream& s) {
+  FrameTag* readFrameTag(std::istream& s) {
     return read_frame_tag(s, false);
   }
 
@@ -359,6 +505,8 @@ private:
   ObjVersionsMap m_objVersions;
   ObjVersions* m_docVersions;
   DocumentInfo* m_loadInfo;
+  std::unique_ptr<PackFile> m_pack;
+  std::vector<ObjectId> m_imageIds;
   std::map<ObjectId, ImageRef> m_images;
   std::map<ObjectId, CelDataRef> m_celdatas;
 };
@@ -373,13 +521,72 @@ bool read_document_info(const std::string& dir, DocumentInfo& info)
   return Reader(dir).loadDocumentInfo(info);
 }
 
-app::Document* read_document(const std::string& dir)
+bool read_document_images(const std::string& dir,
+                          DecodedImages& images,
+                          bool allVersions,
+                          const std::function<bool(double)>& progress)
+{
+  const Reader reader(dir);
+  const std::vector<ObjectId>& ids = reader.imageIds();
+  if (ids.empty())
+    return true;
+
+  std::vector<std::vector<ImageRef>> decoded(ids.size());
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> done(0);
+  std::atomic<bool> stop(false);
+
+  auto worker = [&](bool reportProgress) {
+    size_t i;
+    while (!stop && (i = next++) < ids.size()) {
+      try {
+        decoded[i] = reader.decodeImage(ids[i], allVersions);
+      }
+      catch (const std::exception& ex) {
+        (void)ex;
+        TRACE(" - Error decoding img #%d: %s\n", ids[i], ex.what());
+      }
+      ++done;
+
+      if (reportProgress && progress &&
+          !progress(double(done) / double(ids.size())))
+        stop = true;
+    }
+  };
+
+  // The calling thread works too (and it's the only one that reports
+  // the progress)
+  const int nthreads = std::min<int>(
+    std::max<int>(std::thread::hardware_concurrency(), 1),
+    int(ids.size())) - 1;
+  std::vector<std::thread> threads;
+  for (int i=0; i<nthreads; ++i)
+    threads.emplace_back(worker, false);
+  worker(true);
+  for (auto& thread : threads)
+    thread.join();
+
+  if (stop)
+    return false;
+
+  for (size_t i=0; i<ids.size(); ++i)
+    if (!decoded[i].empty())
+      images[ids[i]] = std::move(decoded[i]);
+  return true;
+}
+
+app::Document* read_document(const std::string& dir,
+                             const DecodedImages* images)
 {
-  return Reader(dir).loadDocument();
+  Reader reader(dir);
+  if (images)
+    reader.setDecodedImages(*images);
+  return reader.loadDocument();
 }
 
 app::Document* read_document_with_raw_images(const std::string& dir,
-                                             RawImagesAs as)
+                                             RawImagesAs as,
+                                             const DecodedImages* images)
 {
   Reader reader(dir);
 
@@ -399,18 +606,7 @@ app::Document* read_document_with_raw_images(const std::string& dir,
   spr->folder()->addLayer(lay);
 
   frame_t frame = 0;
-  for (const auto& fn : base::list_files(dir)) {
-    if (fn.compare(0, 3, "img") != 0)
-      continue;
-
-    std::ifstream s(FSTREAM_PATH(base::join_path(dir, fn)), std::ifstream::binary);
-    if (!s)
-      continue;
-
-    ImageRef img;
-    if (read32(s) == MAGIC_NUMBER)
-      img.reset(read_image(s, false));
-
+  auto addImage = [&](const ImageRef& img) {
     if (img) {
         lay->addCel(std::make_shared<Cel>(frame, img));
     }
@@ -424,6 +620,40 @@ app::Document* read_document_with_raw_images(const std::string& dir,
         spr->folder()->addLayer(lay);
         break;
     }
+  };
+
+  if (images) {
+    for (const auto& item : *images)
+      for (const ImageRef& img : item.second)
+        addImage(img);
+  }
+  else if (const PackFile* pack = reader.packFile()) {
+    for (const auto& obj : pack->objects()) {
+      for (const auto& entry : obj.second) {
+        std::string data;
+        if (entry.prefix != "img" || !pack->read(entry, data))
+          continue;
+
+        std::istringstream s(data);
+        addImage(ImageRef(read_image(s, false)));
+      }
+    }
+  }
+  else {
+    for (const auto& fn : base::list_files(dir)) {
+      if (fn.compare(0, 3, "img") != 0)
+        continue;
+
+      std::ifstream s(FSTREAM_PATH(base::join_path(dir, fn)), std::ifstream::binary);
+      if (!s)
+        continue;
+
+      ImageRef img;
+      if (read32(s) == MAGIC_NUMBER)
+        img.reset(read_image(s, false));
+
+      addImage(img);
+    }
   }
   if (as == RawImagesAs::kFrames) {
     if (frame > 1)
@@ -9,9 +9,14 @@
 
 #include "app/crash/raw_images_as.h"
 #include "doc/frame.h"
+#include "doc/image_ref.h"
+#include "doc/object_id.h"
 #include "doc/pixel_format.h"
 
+#include <functional>
+#include <map>
 #include <string>
+#include <vector>
 
 namespace app {
 class Document;
@@ -32,10 +37,30 @@ namespace crash {
     }
   };
 
+  // Images of a backup decoded in advance, the decoded versions of
+  // each image are sorted from newer to older.
+  typedef std::map<doc::ObjectId, std::vector<doc::ImageRef>> DecodedImages;
+
+  // Reads only the document and sprite headers (no image is
+  // decoded), it's used to list the available backups.
   bool read_document_info(const std::string& dir, DocumentInfo& info);
-  app::Document* read_document(const std::string& dir);
+
+  // Decodes all the images of the backup using several threads, so
+  // then read_document() only has to create the sprite structure.
+  // Only the latest valid version of each image is decoded, unless
+  // "allVersions" is true (used to recover raw images).
+  // The "progress" function is called from the calling thread and
+  // the decoding is stopped if it returns false.
+  bool read_document_images(const std::string& dir,
+                            DecodedImages& images,
+                            bool allVersions,
+                            const std::function<bool(double)>& progress);
+
+  app::Document* read_document(const std::string& dir,
+                               const DecodedImages* images = nullptr);
   app::Document* read_document_with_raw_images(const std::string& dir,
-                                               RawImagesAs as);
+                                               RawImagesAs as,
+                                               const DecodedImages* images = nullptr);
 
 } // namespace crash
 } // namespace app
@@ -18,6 +18,7 @@
 #include "app/document.h"
 #include "app/document_access.h"
 #include "app/file/file.h"
+#include "app/job.h"
 #include "app/ui_context.h"
 #include "base/bind.h"
 #include "base/convert_to.h"
@@ -31,6 +32,46 @@
 namespace app {
 namespace crash {
 
+namespace {
+
+// Decodes the images of a backup in background threads showing the
+// progress, the sprite is created later in the main thread.
+class DecodeImagesJob : public Job {
+public:
+  DecodeImagesJob(const std::string& dir, bool allVersions)
+    : Job("Recovering images")
+    , m_dir(dir)
+    , m_allVersions(allVersions)
+    , m_ok(false) {
+  }
+
+  // Returns false if the user canceled the process.
+  bool decode() {
+    startJob();
+    waitJob();
+    return m_ok && !isCanceled();
+  }
+
+  const DecodedImages& images() const { return m_images; }
+
+private:
+  void onJob() override {
+    m_ok = read_document_images(
+      m_dir, m_images, m_allVersions,
+      [this](double progress) -> bool {
+        jobProgress(progress);
+        return !isCanceled();
+      });
+  }
+
+  std::string m_dir;
+  bool m_allVersions;
+  DecodedImages m_images;
+  bool m_ok;
+};
+
+} // anonymous namespace
+
 Session::Backup::Backup(const std::string& dir)
   : m_dir(dir)
 {
@@ -120,6 +161,14 @@ void Session::removeFromDisk()
     if (base::is_file(verFilename()))
       base::delete_file(verFilename());
 
+    // Undo data left by a crashed session
+    for (auto& item : base::list_files(m_path)) {
+      std::string fn = base::join_path(m_path, item);
+      if (base::string_to_lower(base::get_file_extension(fn)) == "spill" &&
+          base::is_file(fn))
+        base::delete_file(fn);
+    }
+
     base::remove_directory(m_path);
   }
   catch (const std::exception& ex) {
@@ -130,18 +179,36 @@ void Session::removeFromDisk()
 }
 
 void Session::saveDocumentChanges(app::Document* doc)
+{
+  writeDocumentSnapshot(takeDocumentSnapshot(doc));
+}
+
+DocumentSnapshotPtr Session::takeDocumentSnapshot(app::Document* doc)
 {
   DocumentReader reader(doc, 250);
   app::Context ctx;
   std::string dir = base::join_path(m_path,
     base::convert_to<std::string>(doc->id()));
-  TRACE("DataRecovery: Saving document '%s'...\n", dir.c_str());
+  TRACE("DataRecovery: Taking snapshot of document '%s'...\n", dir.c_str());
 
   if (!base::is_directory(dir))
     base::make_directory(dir);
 
+  return take_document_snapshot(dir, doc);
+}
+
+std::size_t Session::estimateDocumentChanges(app::Document* doc)
+{
+  DocumentReader reader(doc, 250);
+  return estimate_document_changes(doc);
+}
+
+void Session::writeDocumentSnapshot(const DocumentSnapshotPtr& snapshot)
+{
+  TRACE("DataRecovery: Saving document '%s'...\n", snapshot->dir.c_str());
+
   // Save document information
-  write_document(dir, doc);
+  write_document_snapshot(*snapshot);
 }
 
 void Session::removeDocument(app::Document* doc)
@@ -164,7 +231,11 @@ void Session::restoreBackup(Backup* backup)
 {
   Console console;
   try {
-    app::Document* doc = read_document(backup->dir());
+    DecodeImagesJob job(backup->dir(), false);
+    if (!job.decode())
+      return;
+
+    app::Document* doc = read_document(backup->dir(), &job.images());
     if (doc) {
       fixFilename(doc);
       UIContext::instance()->documents().add(doc);
@@ -179,7 +250,13 @@ void Session::restoreRawImages(Backup* backup, RawImagesAs as)
 {
   Console console;
   try {
-    app::Document* doc = read_document_with_raw_images(backup->dir(), as);
+    // All the versions of each image are recovered
+    DecodeImagesJob job(backup->dir(), true);
+    if (!job.decode())
+      return;
+
+    app::Document* doc = read_document_with_raw_images(
+      backup->dir(), as, &job.images());
     if (doc) {
       fixFilename(doc);
       UIContext::instance()->documents().add(doc);
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "app/crash/raw_images_as.h"
+#include "app/crash/write_document.h"
 #include "base/disable_copying.h"
 #include "base/process.h"
 #include "base/shared_ptr.h"
@@ -48,6 +49,15 @@ namespace crash {
     void removeFromDisk();
 
     void saveDocumentChanges(app::Document* doc);
+
+    // Saves the document changes in two steps: the snapshot is taken
+    // with the document locked, and it's written (compressing images)
+    // after the lock is released.
+    DocumentSnapshotPtr takeDocumentSnapshot(app::Document* doc);
+    void writeDocumentSnapshot(const DocumentSnapshotPtr& snapshot);
+
+    // Estimated bytes to be saved in the next backup of the document.
+    std::size_t estimateDocumentChanges(app::Document* doc);
     void removeDocument(app::Document* doc);
 
     void restoreBackup(Backup* backup);
@@ -12,6 +12,7 @@
 #include "app/crash/write_document.h"
 
 #include "app/crash/internals.h"
+#include "app/crash/pack_file.h"
 #include "app/document.h"
 #include "base/convert_to.h"
 #include "base/fs.h"
@@ -26,7 +27,9 @@
 #include "doc/frame.h"
 #include "doc/frame_tag.h"
 #include "doc/frame_tag_io.h"
+#include "doc/image.h"
 #include "doc/image_io.h"
+#include "doc/image_ref.h"
 #include "doc/layer.h"
 #include "doc/palette.h"
 #include "doc/palette_io.h"
@@ -35,6 +38,7 @@
 
 #include <fstream>
 #include <map>
+#include <sstream>
 
 namespace app {
 namespace crash {
@@ -46,16 +50,76 @@ using namespace doc;
 namespace {
 
 static std::map<ObjectId, ObjVersionsMap> g_docVersions;
+static std::map<ObjectId, std::unique_ptr<PackFile>> g_docPacks;
+
+// Compression used for images in backups (speed is more important
+// than size here)
+const base::CompressionOptions kImageCompression(base::Compression::Fast);
+
+// Approximate size of a serialized object that is not an image, used
+// to estimate the size of the next backup.
+const std::size_t kSmallObjectSize = 256;
+
+} // anonymous namespace
+
+// A modified object to be written in the backup directory.
+struct DocumentSnapshot::Object {
+  const char* prefix;
+  ObjectId id;
+  ObjectVersion version;
+  std::string data;             // Serialized object
+  ImageRef image;               // Copy of the image (for images)
+};
+
+namespace {
 
 class Writer {
 public:
-  Writer(const std::string& dir, app::Document* doc)
-    : m_dir(dir)
-    , m_doc(doc)
+  // The snapshot can be nullptr to call estimateChanges() only.
+  Writer(app::Document* doc, DocumentSnapshot* snapshot)
+    : m_doc(doc)
+    , m_snapshot(snapshot)
     , m_objVersions(g_docVersions[doc->id()]) {
   }
 
-  void saveDocument() {
+  // Returns the approximate size of the objects that takeSnapshot()
+  // would save, without copying/serializing anything.
+  std::size_t estimateChanges() {
+    Sprite* spr = m_doc->sprite();
+    std::size_t size = 0;
+
+    for (auto pal : spr->getPalettes())
+      size += estimateObject(pal.get());
+
+    for (FrameTag* frtag : spr->frameTags())
+      size += estimateObject(frtag);
+
+    for (auto cel : spr->uniqueCels()) {
+      // Pending images are not saved (see takeSnapshot())
+      if (cel->data()->hasPendingImage())
+        continue;
+
+      if (isModified(cel->image()))
+        size += cel->image()->getMemSize();
+      size += estimateObject(cel->data());
+    }
+
+    for (auto cel : spr->cels())
+      size += estimateObject(cel.get());
+
+    std::vector<Layer*> layers;
+    spr->getLayersList(layers);
+    for (Layer* lay : layers)
+      size += estimateObject(lay);
+
+    size += estimateObject(spr);
+    size += estimateObject(m_doc);
+    return size;
+  }
+
+  // Serializes the modified objects (and copies the modified
+  // images). It's fast enough to be called with the document locked.
+  void takeSnapshot() {
     Sprite* spr = m_doc->sprite();
 
     // Save from objects without children (e.g. images), to aggregated
@@ -68,7 +132,13 @@ public:
       saveObject("frtag", frtag, &Writer::writeFrameTag);
 
     for (auto cel : spr->uniqueCels()) {
-      saveObject("img", cel->image(), &Writer::writeImage);
+      // A pending image (not loaded yet from the original file) is
+      // not modified and it would be loaded with the document locked,
+      // so its cel data is saved when the image is loaded.
+      if (cel->data()->hasPendingImage())
+        continue;
+
+      saveImage(cel->image());
       saveObject("celdata", cel->data(), &Writer::writeCelData);
     }
 
@@ -86,12 +156,12 @@ public:
 
 private:
 
-  void writeDocumentFile(std::ofstream& s, app::Document* doc) {
+  void writeDocumentFile(std::ostream& s, app::Document* doc) {
     write32(s, doc->sprite()->id());
     write_string(s, doc->filename());
   }
 
-  void writeSprite(std::ofstream& s, Sprite* spr) {
+  void writeSprite(std::ostream& s, Sprite* spr) {
     write8(s, spr->pixelFormat());
     write16(s, spr->width());
     write16(s, spr->height());
@@ -120,7 +190,7 @@ private:
       write32(s, frtag->id());
   }
 
-  void writeLayerStructure(std::ofstream& s, Layer* lay) {
+  void writeLayerStructure(std::ostream& s, Layer* lay) {
     write32(s, static_cast<int>(lay->flags())); // Flags
     write16(s, static_cast<int>(lay->type()));  // Type
     write_string(s, lay->name());
@@ -137,84 +207,156 @@ private:
     }
   }
 
-  void writeCel(std::ofstream& s, Cel* cel) {
+  void writeCel(std::ostream& s, Cel* cel) {
     write_cel(s, cel);
   }
 
-  void writeCelData(std::ofstream& s, CelData* celdata) {
+  void writeCelData(std::ostream& s, CelData* celdata) {
     write_celdata(s, celdata);
   }
 
-  void writeImage(std::ofstream& s, Image* img) {
-    write_image(s, img);
-  }
-
-  void writePalette(std::ofstream& s, Palette* pal) {
+  void writePalette(std::ostream& s, Palette* pal) {
     write_palette(s, *pal);
   }
 
-  void writeFrameTag(std::ofstream& s, FrameTag* frameTag) {
+  void writeFrameTag(std::ostream& s, FrameTag* frameTag) {
     write_frame_tag(s, frameTag);
   }
 
+  bool isModified(const doc::Object* obj) const {
+    if (!obj->version())
+      return true;
+
+    auto it = m_objVersions.find(obj->id());
+    return (it == m_objVersions.end() ||
+            it->second[0] != obj->version());
+  }
+
+  std::size_t estimateObject(const doc::Object* obj) const {
+    return (isModified(obj) ? kSmallObjectSize: 0);
+  }
+
   template<typename T>
-  void saveObject(const char* prefix, T* obj, void (Writer::*writeMember)(std::ofstream&, T*)) {
+  DocumentSnapshot::Object* addObject(const char* prefix, T* obj) {
     if (!obj->version())
       obj->incrementVersion();
 
     ObjVersions& versions = m_objVersions[obj->id()];
     if (versions.newer() == obj->version())
-      return;
-
-    std::string fn = prefix;
-    fn.push_back('-');
-    fn += base::convert_to<std::string>(obj->id());
-
-    std::string fullfn = base::join_path(m_dir, fn);
-    std::string oldfn = fullfn + "." + base::convert_to<std::string>(versions.older());
-    fullfn += "." + base::convert_to<std::string>(obj->version());
-
-    std::ofstream s(FSTREAM_PATH(fullfn), std::ofstream::binary);
-    write32(s, 0);                // Leave a room for the magic number
-    (this->*writeMember)(s, obj); // Write the object
-
-    // Flush all data. In this way we ensure that the magic number is
-    // the last thing being written in the file.
-    s.flush();
-
-    // Write the magic number
-    s.seekp(0);
-    write32(s, MAGIC_NUMBER);
+      return nullptr;
+
+    m_snapshot->objects.push_back(DocumentSnapshot::Object());
+    DocumentSnapshot::Object* item = &m_snapshot->objects.back();
+    item->prefix = prefix;
+    item->id = obj->id();
+    item->version = obj->version();
+    return item;
+  }
 
-    // Remove the older version
-    try {
-      if (versions.older() && base::is_file(oldfn))
-        base::delete_file(oldfn);
-    }
-    catch (const std::exception&) {
-      TRACE(" - Cannot delete %s #%d v%d\n", prefix, obj->id(), versions.older());
+  template<typename T>
+  void saveObject(const char* prefix, T* obj, void (Writer::*writeMember)(std::ostream&, T*)) {
+    if (DocumentSnapshot::Object* item = addObject(prefix, obj)) {
+      std::ostringstream s;
+      (this->*writeMember)(s, obj);
+      item->data = s.str();
     }
+  }
 
-    // Rotate versions and add the latest one
-    versions.rotateRevisions(obj->version());
-
-    TRACE(" - Saved %s #%d v%d\n", prefix, obj->id(), obj->version());
+  // Images are copied to compress them later without the document
+  // lock. Sharing the ImageRef isn't safe: tools and commands modify
+  // pixels in place (with the document locked), and not all of them
+  // increment the image version, so a version check after compressing
+  // cannot detect a torn copy. A copy is a memcpy of each row, much
+  // faster than compressing, and only modified images are copied.
+  void saveImage(Image* img) {
+    if (DocumentSnapshot::Object* item = addObject("img", img))
+      item->image.reset(Image::createCopy(img));
   }
 
-  std::string m_dir;
   app::Document* m_doc;
+  DocumentSnapshot* m_snapshot;
   ObjVersionsMap& m_objVersions;
 };
 
+PackFile& get_pack_file(const DocumentSnapshot& snapshot)
+{
+  std::unique_ptr<PackFile>& pack = g_docPacks[snapshot.docId];
+  if (!pack) {
+    pack.reset(new PackFile(snapshot.dir));
+    pack->load();
+  }
+  return *pack;
+}
+
+void write_object(PackFile& pack,
+                  ObjVersionsMap& objVersions,
+                  const DocumentSnapshot::Object& item)
+{
+  std::string data;
+  if (item.image) {
+    std::ostringstream s;
+    write_image(s, item.image.get(), item.id, kImageCompression);
+    data = s.str();
+  }
+
+  pack.add(item.prefix, item.id, item.version,
+           (item.image ? data: item.data));
+
+  // Rotate versions and add the latest one
+  objVersions[item.id].rotateRevisions(item.version);
+
+  TRACE(" - Saved %s #%d v%d\n", item.prefix, item.id, item.version);
+}
+
 } // anonymous namespace
 
 //////////////////////////////////////////////////////////////////////
 // Public API
 
+DocumentSnapshot::DocumentSnapshot(const std::string& dir, ObjectId docId)
+  : dir(dir)
+  , docId(docId)
+{
+}
+
+DocumentSnapshot::~DocumentSnapshot()
+{
+}
+
+std::size_t DocumentSnapshot::size() const
+{
+  std::size_t size = 0;
+  for (const auto& item : objects)
+    size += (item.image ? item.image->getMemSize(): item.data.size());
+  return size;
+}
+
+DocumentSnapshotPtr take_document_snapshot(const std::string& dir, app::Document* doc)
+{
+  DocumentSnapshotPtr snapshot(new DocumentSnapshot(dir, doc->id()));
+  Writer writer(doc, snapshot.get());
+  writer.takeSnapshot();
+  return snapshot;
+}
+
+std::size_t estimate_document_changes(app::Document* doc)
+{
+  return Writer(doc, nullptr).estimateChanges();
+}
+
+void write_document_snapshot(const DocumentSnapshot& snapshot)
+{
+  PackFile& pack = get_pack_file(snapshot);
+  ObjVersionsMap& objVersions = g_docVersions[snapshot.docId];
+  for (const auto& item : snapshot.objects)
+    write_object(pack, objVersions, item);
+
+  pack.flush();
+}
+
 void write_document(const std::string& dir, app::Document* doc)
 {
-  Writer writer(dir, doc);
-  writer.saveDocument();
+  write_document_snapshot(*take_document_snapshot(dir, doc));
 }
 
 void delete_document_internals(app::Document* doc)
@@ -226,6 +368,8 @@ void delete_document_internals(app::Document* doc)
   // never saved by the backup process.
   if (it != g_docVersions.end())
     g_docVersions.erase(it);
+
+  g_docPacks.erase(doc->id());
 }
 
 } // namespace crash
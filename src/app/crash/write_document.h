@@ -7,12 +7,51 @@
 
 #pragma once
 
+#include "base/disable_copying.h"
+#include "doc/object_id.h"
+
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace app {
 class Document;
 namespace crash {
 
+  // Modified objects of a document to be saved in its backup
+  // directory. Images are copied, so the snapshot can be written
+  // without locking the document.
+  struct DocumentSnapshot {
+    struct Object;
+
+    DocumentSnapshot(const std::string& dir, doc::ObjectId docId);
+    ~DocumentSnapshot();
+
+    // Size of the copied/serialized objects (in bytes).
+    std::size_t size() const;
+
+    std::string dir;
+    doc::ObjectId docId;
+    std::vector<Object> objects;
+
+    DISABLE_COPYING(DocumentSnapshot);
+  };
+
+  typedef std::shared_ptr<DocumentSnapshot> DocumentSnapshotPtr;
+
+  // Must be called with the document locked (at least for reading).
+  DocumentSnapshotPtr take_document_snapshot(const std::string& dir, app::Document* doc);
+
+  // Returns an estimation of the bytes that the next snapshot will
+  // copy (the objects modified since the last backup). It must be
+  // called with the document locked (at least for reading).
+  std::size_t estimate_document_changes(app::Document* doc);
+
+  // Compresses and writes the snapshot objects in the backup
+  // directory, it doesn't need the document.
+  void write_document_snapshot(const DocumentSnapshot& snapshot);
+
   void write_document(const std::string& dir, app::Document* doc);
   void delete_document_internals(app::Document* doc);
 
@@ -42,7 +42,7 @@ using namespace base;
 using namespace doc;
 
 Document::Document(Sprite* sprite)
-  : m_undo(new DocumentUndo)
+  : m_undo(new DocumentUndo(this))
   , m_associated_to_file(false)
   , m_write_lock(false)
   , m_read_locks(0)
@@ -17,16 +17,22 @@
 #include "app/document_undo_observer.h"
 #include "app/pref/preferences.h"
 #include "doc/context.h"
+#include "doc/document.h"
 #include "undo/undo_history.h"
 #include "undo/undo_state.h"
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
 namespace app {
 
-DocumentUndo::DocumentUndo()
-  : m_ctx(NULL)
+DocumentUndo::DocumentUndo(doc::Document* doc)
+  : m_undoHistory(this)
+  , m_doc(doc)
+  , m_ctx(NULL)
+  , m_totalUndoSize(std::make_shared<std::atomic<size_t>>(0))
+  , m_undoRedoStateSize(0)
   , m_savedCounter(0)
   , m_savedStateIsLost(false)
 {
@@ -48,7 +54,13 @@ void DocumentUndo::add(CmdTransaction* cmd)
   }
 
   m_undoHistory.add(cmd);
+  m_statesInMemory.push_back(m_undoHistory.currentState());
+  *m_totalUndoSize += cmd->memSize() + cmd->trackMemSize(m_totalUndoSize);
   notifyObservers(&DocumentUndoObserver::onAddUndoState, this);
+
+  checkSizeLimit();
+  spillFarStates();
+  notifyObservers(&DocumentUndoObserver::onTotalUndoSizeChange, this);
 }
 
 bool DocumentUndo::canUndo() const
@@ -63,13 +75,21 @@ bool DocumentUndo::canRedo() const
 
 void DocumentUndo::undo()
 {
-  m_undoHistory.undo();
+  {
+    doc::DocumentNotificationBatch batch(m_doc);
+    m_undoHistory.undo();
+  }
+  spillFarStates();
   notifyObservers(&DocumentUndoObserver::onAfterUndo, this);
 }
 
 void DocumentUndo::redo()
 {
-  m_undoHistory.redo();
+  {
+    doc::DocumentNotificationBatch batch(m_doc);
+    m_undoHistory.redo();
+  }
+  spillFarStates();
   notifyObservers(&DocumentUndoObserver::onAfterRedo, this);
 }
 
@@ -77,6 +97,7 @@ void DocumentUndo::clearRedo()
 {
   m_undoHistory.clearRedo();
   notifyObservers(&DocumentUndoObserver::onClearRedo, this);
+  notifyObservers(&DocumentUndoObserver::onTotalUndoSizeChange, this);
 }
 
 bool DocumentUndo::isSavedState() const
@@ -144,7 +165,94 @@ Cmd* DocumentUndo::lastExecutedCmd() const
 
 void DocumentUndo::moveToState(const undo::UndoState* state)
 {
-  m_undoHistory.moveTo(state);
+  {
+    doc::DocumentNotificationBatch batch(m_doc);
+    m_undoHistory.moveTo(state);
+  }
+  spillFarStates();
+}
+
+void DocumentUndo::checkSizeLimit()
+{
+  if (!App::instance())
+    return;
+
+  const size_t sizeLimit =
+    size_t(App::instance()->preferences().undo.sizeLimit()) * 1024 * 1024;
+
+  while (*m_totalUndoSize > sizeLimit) {
+    const undo::UndoState* first = m_undoHistory.firstState();
+    const undo::UndoState* second = (first ? first->next(): nullptr);
+
+    if (!m_undoHistory.deleteFirstState())
+      break;
+
+    // In a nonlinear history other branches can be deleted too, and
+    // the saved state could be one of them.
+    if (m_undoHistory.firstState() != second && !isSavedState())
+      impossibleToBackToSavedState();
+  }
+}
+
+void DocumentUndo::spillFarStates()
+{
+  // States that we can reach with a few undoes (following the
+  // parents, as the history can be nonlinear) or redoes.
+  const undo::UndoState* nearStates[2*kStatesInMemory+1];
+  int nearCount = 0;
+  auto state = m_undoHistory.currentState();
+  for (int i=0; state && i<kStatesInMemory+1; ++i, state=state->parent())
+    nearStates[nearCount++] = state;
+  state = nextRedo();
+  for (int i=0; state && i<kStatesInMemory; ++i, state=state->next())
+    nearStates[nearCount++] = state;
+
+  const undo::UndoState** nearEnd = nearStates+nearCount;
+  auto isNear = [&](const undo::UndoState* s) {
+    return (std::find(nearStates, nearEnd, s) != nearEnd);
+  };
+
+  // Only states in m_statesInMemory can have data in memory, the
+  // rest were already spilled.
+  auto it = m_statesInMemory.begin();
+  while (it != m_statesInMemory.end()) {
+    if (isNear(*it)) {
+      ++it;
+    }
+    else {
+      static_cast<Cmd*>((*it)->cmd())->spill();
+      it = m_statesInMemory.erase(it);
+    }
+  }
+}
+
+void DocumentUndo::onDeleteUndoState(undo::UndoState* state)
+{
+  Cmd* cmd = static_cast<Cmd*>(state->cmd());
+  *m_totalUndoSize -= cmd->memSize() + cmd->trackMemSize(nullptr);
+
+  auto it = std::find(m_statesInMemory.begin(), m_statesInMemory.end(), state);
+  if (it != m_statesInMemory.end())
+    m_statesInMemory.erase(it);
+
+  notifyObservers(&DocumentUndoObserver::onDeleteUndoState, this, state);
+}
+
+void DocumentUndo::onBeforeUndoRedoState(const undo::UndoState* state)
+{
+  m_undoRedoStateSize = static_cast<const Cmd*>(state->cmd())->memSize();
+}
+
+void DocumentUndo::onAfterUndoRedoState(const undo::UndoState* state)
+{
+  // Commands can save/restore data when they are undone/redone
+  *m_totalUndoSize += static_cast<const Cmd*>(state->cmd())->memSize();
+  *m_totalUndoSize -= m_undoRedoStateSize;
+
+  // Spilled data is read back to undo/redo the state
+  if (std::find(m_statesInMemory.begin(), m_statesInMemory.end(), state) ==
+      m_statesInMemory.end())
+    m_statesInMemory.push_back(state);
 }
 
 const undo::UndoState* DocumentUndo::nextUndo() const
@@ -7,15 +7,18 @@
 
 #pragma once
 
+#include "app/cmd.h"
 #include "base/disable_copying.h"
 #include "base/observable.h"
 #include "doc/sprite_position.h"
 #include "undo/undo_history.h"
 
 #include <string>
+#include <vector>
 
 namespace doc {
   class Context;
+  class Document;
 }
 
 namespace app {
@@ -25,9 +28,10 @@ namespace app {
   class CmdTransaction;
   class DocumentUndoObserver;
 
-  class DocumentUndo : public base::Observable<DocumentUndoObserver> {
+  class DocumentUndo : public base::Observable<DocumentUndoObserver>,
+                       public undo::UndoHistoryDelegate {
   public:
-    DocumentUndo();
+    explicit DocumentUndo(doc::Document* doc = nullptr);
 
     void setContext(doc::Context* ctx);
 
@@ -59,12 +63,42 @@ namespace app {
 
     void moveToState(const undo::UndoState* state);
 
+    // Memory used by all the commands in the undo history (the sum of
+    // Cmd::memSize() and the memory reported by Cmd::trackMemSize()
+    // of each state).
+    size_t totalUndoSize() const { return *m_totalUndoSize; }
+
   private:
+    // Number of states around the current one that are never spilled
+    // to disk.
+    static const int kStatesInMemory = 32;
+
     const undo::UndoState* nextUndo() const;
     const undo::UndoState* nextRedo() const;
 
+    // Deletes the oldest states until the total size of the history
+    // is below the "undo.size_limit" preference.
+    void checkSizeLimit();
+
+    // Moves to disk the data of the states in m_statesInMemory that
+    // are now far from the current one.
+    void spillFarStates();
+
+    // undo::UndoHistoryDelegate impl
+    void onDeleteUndoState(undo::UndoState* state) override;
+    void onBeforeUndoRedoState(const undo::UndoState* state) override;
+    void onAfterUndoRedoState(const undo::UndoState* state) override;
+
     undo::UndoHistory m_undoHistory;
+    doc::Document* m_doc;
     doc::Context* m_ctx;
+    MemSizeCounter m_totalUndoSize;
+    // Cmd::memSize() of the state being undone/redone
+    size_t m_undoRedoStateSize;
+
+    // States that can have their data in memory: new states, and
+    // states that were undone/redone (spilled data is read back).
+    std::vector<const undo::UndoState*> m_statesInMemory;
 
     // This counter is equal to 0 if we are in the "saved state", i.e.
     // the document on memory is equal to the document on disk. This
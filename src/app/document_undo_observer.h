@@ -22,6 +22,10 @@ class DocumentUndo;
     virtual void onAfterUndo(DocumentUndo* history) = 0;
     virtual void onAfterRedo(DocumentUndo* history) = 0;
     virtual void onClearRedo(DocumentUndo* history) = 0;
+    // Called before the given state is deleted (it cannot be used
+    // after this notification).
+    virtual void onDeleteUndoState(DocumentUndo* history, undo::UndoState* state) = 0;
+    virtual void onTotalUndoSizeChange(DocumentUndo* history) = 0;
   };
 
 } // namespace app
@@ -0,0 +1,127 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#include "tests/test.h"
+
+#include "app/cmd.h"
+#include "app/cmd_transaction.h"
+#include "app/document_undo.h"
+#include "undo/undo_state.h"
+
+#include <vector>
+
+using namespace app;
+
+namespace {
+
+// Command that keeps its data in memory until it's spilled, and reads
+// it back when it's undone/redone (like RowsPayload).
+class SpillCmd : public Cmd {
+public:
+  bool spilled() const { return m_spilled; }
+
+protected:
+  void onUndo() override { m_spilled = false; }
+  void onRedo() override { m_spilled = false; }
+  void onSpill() override { m_spilled = true; }
+  size_t onMemSize() const override { return sizeof(*this); }
+
+private:
+  bool m_spilled = false;
+};
+
+const int kStates = 100;
+// Same as DocumentUndo::kStatesInMemory
+const int kNear = 32;
+
+void add_states(DocumentUndo& undo, std::vector<SpillCmd*>& cmds, int n)
+{
+  for (int i=0; i<n; ++i) {
+    auto cmd = new SpillCmd;
+    auto trans = new CmdTransaction("", false, nullptr);
+    trans->add(cmd);
+    undo.add(trans);
+    cmds.push_back(cmd);
+  }
+}
+
+// Index of the current state in "cmds" (-1 if there is no state).
+int current_index(const DocumentUndo& undo)
+{
+  int i = -1;
+  for (auto state=undo.currentState(); state; state=state->parent())
+    ++i;
+  return i;
+}
+
+// States near the current one can be spilled too (if they weren't
+// undone/redone since they were spilled).
+void expect_far_states_spilled(const DocumentUndo& undo,
+                               const std::vector<SpillCmd*>& cmds)
+{
+  const int cur = current_index(undo);
+  for (int i=0; i<int(cmds.size()); ++i) {
+    if (i < cur-kNear || i > cur+kNear)
+      EXPECT_TRUE(cmds[i]->spilled()) << "state " << i << " current " << cur;
+  }
+}
+
+} // anonymous namespace
+
+TEST(DocumentUndo, SpillFarStatesAfterAdd)
+{
+  DocumentUndo undo;
+  std::vector<SpillCmd*> cmds;
+  add_states(undo, cmds, kStates);
+  expect_far_states_spilled(undo, cmds);
+
+  for (int i=kStates-kNear-1; i<kStates; ++i)
+    EXPECT_FALSE(cmds[i]->spilled());
+}
+
+TEST(DocumentUndo, SpillFarStatesAfterUndoRedo)
+{
+  DocumentUndo undo;
+  std::vector<SpillCmd*> cmds;
+  add_states(undo, cmds, kStates);
+
+  // Undo to the beginning, all the states are read back once
+  for (int i=kStates-1; i>=0; --i) {
+    undo.undo();
+    EXPECT_FALSE(cmds[i]->spilled());
+    expect_far_states_spilled(undo, cmds);
+  }
+  EXPECT_FALSE(undo.canUndo());
+
+  // Redo to the end
+  for (int i=0; i<kStates; ++i) {
+    undo.redo();
+    EXPECT_FALSE(cmds[i]->spilled());
+    expect_far_states_spilled(undo, cmds);
+  }
+  EXPECT_FALSE(undo.canRedo());
+}
+
+TEST(DocumentUndo, SpillFarStatesAfterMoveToState)
+{
+  DocumentUndo undo;
+  std::vector<SpillCmd*> cmds;
+  add_states(undo, cmds, kStates);
+
+  // Jump to the first state (all the other states are undone)
+  undo.moveToState(undo.firstState());
+  EXPECT_EQ(0, current_index(undo));
+  expect_far_states_spilled(undo, cmds);
+
+  // Jump back to the last state
+  const undo::UndoState* last = undo.firstState();
+  while (last->next())
+    last = last->next();
+  undo.moveToState(last);
+  EXPECT_EQ(kStates-1, current_index(undo));
+  expect_far_states_spilled(undo, cmds);
+}
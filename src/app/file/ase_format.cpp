@@ -14,16 +14,38 @@
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
+#include "app/pref/preferences.h"
+#include "base/buffer.h"
 #include "base/cfile.h"
+#include "base/convert_to.h"
 #include "base/exception.h"
 #include "base/file_handle.h"
+#include "base/file_mapping.h"
+#include "base/fs.h"
+#include "base/log.h"
+#include "base/mutex.h"
 #include "base/path.h"
+#include "base/process.h"
+#include "base/scoped_lock.h"
+#include "base/time.h"
 #include "doc/doc.h"
+#include "doc/image_loader.h"
 #include "ui/alert.h"
 #include "zlib.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <exception>
+#include <map>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+  #include <sys/stat.h>
+#endif
 
 #define ASE_FILE_MAGIC                      0xA5E0
 #define ASE_FILE_FRAME_MAGIC                0xF1FA
@@ -96,42 +118,228 @@ struct ASE_Chunk {
   int start;
 };
 
-static bool ase_file_read_header(FILE* f, ASE_Header* header);
+// Pixels of compressed cels are inflated after all chunks are read,
+// in parallel, so AseFormat::onLoad() only keeps the compressed data
+// of each cel here.
+struct ASE_CompressedCel {
+  ImageRef image;
+  const uint8_t* data;          // Points to the file mapping or to "buffer"
+  std::size_t size;
+  base::buffer buffer;          // Used when the file is not mapped
+};
+
+// File mapping used by the lazy cels of a sprite (see AseCelLoader).
+// AseFormat::onSave() replaces the file with a new one, so the mapping
+// keeps the old content. If the file must be overwritten in place,
+// its data is copied in memory before (detach()), so pending cels
+// don't read the new file (or crash reading a truncated mapping).
+class AseMappedFile {
+public:
+  AseMappedFile(const std::shared_ptr<base::FileMapping>& mapping,
+                const std::string& filename, ObjectId spriteId)
+    : m_mapping(mapping)
+    , m_data(mapping->data())
+    , m_filename(filename)
+    , m_normalizedFilename(base::normalize_path(filename))
+    , m_spriteId(spriteId)
+    , m_failed(false) {
+  }
+
+  const std::string& filename() const { return m_filename; }
+  const std::string& normalizedFilename() const { return m_normalizedFilename; }
+  ObjectId spriteId() const { return m_spriteId; }
+  bool failed() const { return m_failed; }
+  void setFailed() { m_failed = true; }
+
+  // Offset of the given pointer to the mapped data (it can be used
+  // only while the file is being loaded).
+  std::size_t offset(const uint8_t* data) const {
+    return std::size_t(data - m_data);
+  }
+
+  // Calls func(data) with the data in the given offset. Returns false
+  // if the data cannot be trusted (the file was modified by other
+  // program).
+  template<typename Func>
+  bool read(std::size_t offset, Func func) {
+    base::scoped_lock lock(m_mutex);
+    if (m_mapping && m_mapping->isModified())
+      dropMapping();
+    if (!m_data) {
+      m_failed = true;
+      return false;
+    }
+    func(m_data + offset);
+    return true;
+  }
+
+  void detach() {
+    base::scoped_lock lock(m_mutex);
+    if (!m_mapping)
+      return;
+
+    if (!m_mapping->isModified()) {
+      m_copy.assign(m_mapping->data(), m_mapping->data() + m_mapping->size());
+      m_data = m_copy.data();
+      m_mapping.reset();
+    }
+    else
+      dropMapping();
+  }
+
+private:
+  void dropMapping() {
+    m_mapping.reset();
+    m_data = nullptr;
+  }
+
+  base::mutex m_mutex;
+  std::shared_ptr<base::FileMapping> m_mapping;
+  base::buffer m_copy;
+  const uint8_t* m_data;        // Data of the mapping or of "m_copy"
+  std::string m_filename;
+  std::string m_normalizedFilename;
+  ObjectId m_spriteId;
+  std::atomic<bool> m_failed;
+};
+
+struct ASE_PendingCels {
+  std::vector<ASE_CompressedCel> compressed;
+
+  // Copies of linked cels (with a different position/opacity) that
+  // must be done after the pixels of the original image are inflated,
+  // as pairs of destination/source images.
+  std::vector<std::pair<ImageRef, ImageRef>> copies;
+
+  // With FILE_LOAD_LAZY_CELS compressed cels are not added in
+  // "compressed", they are inflated on demand from this mapping (see
+  // AseCelLoader).
+  std::shared_ptr<AseMappedFile> mappedFile;
+};
+
+// Location of a chunk in the file, with the fields of cel chunks
+// needed to follow links.
+struct ASE_ChunkInfo {
+  long pos;                     // Position of the chunk size
+  long size;
+  int type;
+  LayerIndex layer;
+  int x, y;
+  int opacity;
+  int cel_type;
+  frame_t link_frame;
+};
+
+struct ASE_FrameInfo {
+  uint16_t duration;
+  std::vector<ASE_ChunkInfo> chunks;
+};
+
+// Index of all chunks of a file, so AseFormat::onLoad() can read
+// just one frame (FILE_LOAD_ONE_FRAME) without reading the previous
+// ones. The index of the last files is kept in memory (see
+// ase_file_get_frame_index()).
+struct ASE_FrameIndex {
+  std::string filename;
+  base::Time mtime;
+  std::size_t size;
+  std::vector<ASE_FrameInfo> frames;
+
+  // Returns the cel chunk with the pixels of the given cel chunk
+  // (following links), or nullptr if the linked cel doesn't exist.
+  const ASE_ChunkInfo* findOriginalCel(const ASE_ChunkInfo* chunk) const {
+    for (std::size_t i=0; i<frames.size() && chunk; ++i) {
+      if (chunk->cel_type != ASE_FILE_LINK_CEL)
+        return chunk;
+
+      const ASE_ChunkInfo* link = nullptr;
+      if (chunk->link_frame >= 0 &&
+          chunk->link_frame < frame_t(frames.size())) {
+        for (const ASE_ChunkInfo& other : frames[chunk->link_frame].chunks) {
+          if (other.type == ASE_FILE_CHUNK_CEL &&
+              other.layer == chunk->layer) {
+            link = &other;
+            break;
+          }
+        }
+      }
+      chunk = link;
+    }
+    // A cycle of links
+    return nullptr;
+  }
+};
+
+// Compressed pixels of each cel image, they are prepared in parallel
+// by AseFormat::onSave() before writing the file.
+typedef std::map<const Image*, base::buffer> ASE_CompressedImages;
+
+// New file written by AseFormat::onSave() to replace the saved file
+// when it's complete. It's deleted if it's not used.
+struct ASE_TempFile {
+  std::string filename;
+  std::string dstFilename;      // File to be replaced
+
+  ~ASE_TempFile() {
+    if (!filename.empty()) {
+      try {
+        base::delete_file(filename);
+      }
+      catch (const std::exception&) {
+        // Ignore
+      }
+    }
+  }
+};
+
+class AseReader;
+
+static bool ase_file_read_header(AseReader* f, ASE_Header* header);
+static float ase_file_read_progress(AseReader* f, ASE_Header* header);
 static void ase_file_prepare_header(FILE* f, ASE_Header* header, const Sprite* sprite);
 static void ase_file_write_header(FILE* f, ASE_Header* header);
 static void ase_file_write_header_filesize(FILE* f, ASE_Header* header);
 
-static void ase_file_read_frame_header(FILE* f, ASE_FrameHeader* frame_header);
+static void ase_file_read_frame_header(AseReader* f, ASE_FrameHeader* frame_header);
+static std::shared_ptr<const ASE_FrameIndex> ase_file_get_frame_index(AseReader* f, const std::string& filename, ASE_Header* header);
+static std::shared_ptr<AseMappedFile> ase_file_add_mapped_file(const std::shared_ptr<base::FileMapping>& mapping, const std::string& filename, ObjectId spriteId);
+static bool ase_file_has_mapped_files(const std::string& filename);
+static FileHandle ase_file_create_temp_file(const std::string& filename, ASE_TempFile* tmpFile);
+static void ase_file_detach_mapped_files(const std::string& filename);
+static std::string ase_file_get_failed_mapped_file(ObjectId spriteId);
 static void ase_file_prepare_frame_header(FILE* f, ASE_FrameHeader* frame_header);
 static void ase_file_write_frame_header(FILE* f, ASE_FrameHeader* frame_header);
 
 static void ase_file_write_layers(FILE* f, ASE_FrameHeader* frame_header, const Layer* layer);
-static void ase_file_write_cels(FILE* f, ASE_FrameHeader* frame_header, const Sprite* sprite, const Layer* layer, frame_t frame);
+static void ase_file_write_cels(FILE* f, ASE_FrameHeader* frame_header, const Sprite* sprite, const Layer* layer, frame_t frame, const ASE_CompressedImages* images);
 
-static void ase_file_read_padding(FILE* f, int bytes);
+static void ase_file_read_padding(AseReader* f, int bytes);
 static void ase_file_write_padding(FILE* f, int bytes);
-static std::string ase_file_read_string(FILE* f);
+static std::string ase_file_read_string(AseReader* f);
 static void ase_file_write_string(FILE* f, const std::string& string);
 
 static void ase_file_write_start_chunk(FILE* f, ASE_FrameHeader* frame_header, int type, ASE_Chunk* chunk);
 static void ase_file_write_close_chunk(FILE* f, ASE_Chunk* chunk);
 
-static std::shared_ptr<Palette> ase_file_read_color_chunk(FILE* f, const Palette& prevPal, frame_t frame);
-static std::shared_ptr<Palette> ase_file_read_color2_chunk(FILE* f, const Palette& prevPal, frame_t frame);
-static std::shared_ptr<Palette> ase_file_read_palette_chunk(FILE* f, const Palette& prevPal, frame_t frame);
+static std::shared_ptr<Palette> ase_file_read_color_chunk(AseReader* f, const Palette& prevPal, frame_t frame);
+static std::shared_ptr<Palette> ase_file_read_color2_chunk(AseReader* f, const Palette& prevPal, frame_t frame);
+static std::shared_ptr<Palette> ase_file_read_palette_chunk(AseReader* f, const Palette& prevPal, frame_t frame);
 static void ase_file_write_color2_chunk(FILE* f, ASE_FrameHeader* frame_header, const Palette* pal);
 static void ase_file_write_palette_chunk(FILE* f, ASE_FrameHeader* frame_header, const Palette* pal, int from, int to);
-static Layer* ase_file_read_layer_chunk(FILE* f, ASE_Header* header, Sprite* sprite, Layer** previous_layer, int* current_level);
+static Layer* ase_file_read_layer_chunk(AseReader* f, ASE_Header* header, Sprite* sprite, Layer** previous_layer, int* current_level);
 static void ase_file_write_layer_chunk(FILE* f, ASE_FrameHeader* frame_header, const Layer* layer);
-static Cel* ase_file_read_cel_chunk(FILE* f, Sprite* sprite, frame_t frame, PixelFormat pixelFormat, FileOp* fop, ASE_Header* header, size_t chunk_end);
-static void ase_file_write_cel_chunk(FILE* f, ASE_FrameHeader* frame_header, const Cel* cel, const LayerImage* layer, const Sprite* sprite);
-static Mask* ase_file_read_mask_chunk(FILE* f);
+static Cel* ase_file_read_cel_chunk(AseReader* f, Sprite* sprite, frame_t frame, PixelFormat pixelFormat, FileOp* fop, ASE_Header* header, size_t chunk_end, ASE_PendingCels* pending);
+static void ase_file_inflate_cels(FileOp* fop, ASE_PendingCels* pending);
+static void ase_file_keep_one_frame(Sprite* sprite, frame_t frame);
+static bool ase_file_compress_cels(FileOp* fop, const Sprite* sprite, int level, ASE_CompressedImages* images);
+static void ase_file_write_cel_chunk(FILE* f, ASE_FrameHeader* frame_header, const Cel* cel, const LayerImage* layer, const Sprite* sprite, const ASE_CompressedImages* images);
+static Mask* ase_file_read_mask_chunk(AseReader* f);
 #if 0
 static void ase_file_write_mask_chunk(FILE* f, ASE_FrameHeader* frame_header, Mask* mask);
 #endif
-static void ase_file_read_frame_tags_chunk(FILE* f, FrameTags* frameTags);
+static void ase_file_read_frame_tags_chunk(AseReader* f, FrameTags* frameTags);
 static void ase_file_write_frame_tags_chunk(FILE* f, ASE_FrameHeader* frame_header, const FrameTags* frameTags);
-static void ase_file_read_user_data_chunk(FILE* f, UserData* userData);
+static void ase_file_read_user_data_chunk(AseReader* f, UserData* userData);
 static void ase_file_write_user_data_chunk(FILE* f, ASE_FrameHeader* frame_header, const UserData* userData);
 static bool ase_has_groups(LayerFolder* layer);
 static void ase_ungroup_all(LayerFolder* layer);
@@ -151,6 +359,135 @@ private:
   ASE_Chunk m_chunk;
 };
 
+// Reads .ase files directly from a memory-mapped file, or from a
+// FILE* when the file cannot be mapped (e.g. pipes). Values are
+// returned like base::fgetw()/fgetl() do (EOF at the end of the file).
+class AseReader {
+public:
+  AseReader(const std::string& filename)
+    : m_mapping(std::make_shared<base::FileMapping>())
+    , m_data(nullptr)
+    , m_size(0)
+    , m_pos(0) {
+    if (m_mapping->open(filename)) {
+      m_data = m_mapping->data();
+      m_size = m_mapping->size();
+    }
+    else {
+      m_mapping.reset();
+      m_file = open_file_with_exception(filename, "rb");
+    }
+  }
+
+  bool isMapped() const { return m_data != nullptr; }
+
+  int read8() {
+    if (m_data) {
+      if (m_pos < m_size)
+        return m_data[m_pos++];
+      return EOF;
+    }
+    int c = fgetc(m_file.get());
+    if (c != EOF)
+      ++m_pos;
+    return c;
+  }
+
+  int read16() {
+    int b1 = read8();
+    if (b1 == EOF)
+      return EOF;
+    int b2 = read8();
+    if (b2 == EOF)
+      return EOF;
+    return ((b2 << 8) | b1);
+  }
+
+  long read32() {
+    int b1 = read16();
+    if (b1 == EOF)
+      return EOF;
+    int b2 = read16();
+    if (b2 == EOF)
+      return EOF;
+    return long(uint32_t(b2) << 16 | uint32_t(b1));
+  }
+
+  std::size_t read(void* data, std::size_t size) {
+    if (m_data) {
+      size = std::min(size, m_size - m_pos);
+      std::copy(m_data+m_pos, m_data+m_pos+size, (uint8_t*)data);
+    }
+    else
+      size = fread(data, 1, size, m_file.get());
+    m_pos += size;
+    return size;
+  }
+
+  // Returns the next "size" bytes of the file and skips them (the
+  // returned size can be smaller at the end of the file). If the
+  // file is mapped, the data is not copied at all (it's valid while
+  // the mapping() exists), in other case it's read in "tmp".
+  const uint8_t* readBlock(std::size_t& size, base::buffer& tmp) {
+    if (m_data) {
+      const uint8_t* ptr = m_data+m_pos;
+      size = std::min(size, m_size - m_pos);
+      m_pos += size;
+      return ptr;
+    }
+    // Read the block in pieces so a corrupted size doesn't allocate
+    // too much memory
+    tmp.clear();
+    while (tmp.size() < size) {
+      std::size_t used = tmp.size();
+      std::size_t n = std::min<std::size_t>(size - used, 1024*1024);
+      tmp.resize(used + n);
+      n = read(&tmp[used], n);
+      tmp.resize(used + n);
+      if (n == 0)
+        break;
+    }
+    size = tmp.size();
+    return tmp.data();
+  }
+
+  long tell() const {
+    return long(m_pos);
+  }
+
+  void seek(long pos) {
+    if (pos < 0)
+      pos = 0;
+
+    if (m_data) {
+      m_pos = std::min(std::size_t(pos), m_size);
+    }
+    else if (fseek(m_file.get(), pos, SEEK_SET) == 0) {
+      m_pos = pos;
+    }
+    // Pipes cannot go back, but we can skip data
+    else {
+      while (m_pos < std::size_t(pos) && read8() != EOF)
+        ;
+    }
+  }
+
+  bool error() const {
+    return (m_file && ferror(m_file.get()));
+  }
+
+  const std::shared_ptr<base::FileMapping>& mapping() const {
+    return m_mapping;
+  }
+
+private:
+  std::shared_ptr<base::FileMapping> m_mapping;
+  FileHandle m_file;
+  const uint8_t* m_data;        // Data of the mapping
+  std::size_t m_size;
+  std::size_t m_pos;
+};
+
 class AseFormat : public FileFormat {
   const char* onGetName() const override { return "ase"; }
   const char* onGetExtensions() const override { return "ase,aseprite"; }
@@ -181,8 +518,8 @@ static FileFormat::Regular<AseFormat> ff{"ase"};
 
 bool AseFormat::onLoad(FileOp* fop)
 {
-  FileHandle handle(open_file_with_exception(fop->filename(), "rb"));
-  FILE* f = handle.get();
+  AseReader reader(fop->filename());
+  AseReader* f = &reader;
   bool ignore_old_color_chunks = false;
 
   ASE_Header header;
@@ -208,134 +545,211 @@ bool AseFormat::onLoad(FileOp* fop)
   WithUserData* last_object_with_user_data = nullptr;
   int current_level = -1;
 
-  // Read frame by frame to end-of-file
-  for (frame_t frame(0); frame<sprite->totalFrames(); ++frame) {
-    // Start frame position
-    int frame_pos = ftell(f);
-    fop->setProgress((float)frame_pos / (float)header.size);
-
-    // Read frame header
-    ASE_FrameHeader frame_header;
-    ase_file_read_frame_header(f, &frame_header);
-
-    // Correct frame type
-    if (frame_header.magic == ASE_FILE_FRAME_MAGIC) {
-      // Use frame-duration field?
-      if (frame_header.duration > 0)
-        sprite->setFrameDuration(frame, frame_header.duration);
+  // Cels that will be inflated when all chunks are read
+  ASE_PendingCels pending;
+  if (fop->isLazyCels() && !fop->isOneFrame() && reader.mapping()) {
+    pending.mappedFile = ase_file_add_mapped_file(
+      reader.mapping(), fop->filename(), sprite->id());
+  }
 
-      // Read chunks
-      for (int c=0; c<frame_header.chunks; c++) {
-        /* start chunk position */
-        int chunk_pos = ftell(f);
-        fop->setProgress((float)chunk_pos / (float)header.size);
-
-        // Read chunk information
-        int chunk_size = fgetl(f);
-        int chunk_type = fgetw(f);
-
-        switch (chunk_type) {
-
-          case ASE_FILE_CHUNK_FLI_COLOR:
-          case ASE_FILE_CHUNK_FLI_COLOR2:
-            if (!ignore_old_color_chunks) {
-              Palette* prevPal = sprite->palette(frame);
-              auto pal = chunk_type == ASE_FILE_CHUNK_FLI_COLOR
-                ? ase_file_read_color_chunk(f, *prevPal, frame)
-                : ase_file_read_color2_chunk(f, *prevPal, frame);
-              if (prevPal->countDiff(*pal, NULL, NULL) > 0)
-                sprite->setPalette(*pal, true);
-            }
-            break;
+  // Reads the chunk of the given frame that starts in "chunk_pos"
+  // (the chunk size and type were already read)
+  auto read_chunk =
+    [&](frame_t frame, long chunk_pos, long chunk_size, int chunk_type) {
+      switch (chunk_type) {
 
-          case ASE_FILE_CHUNK_PALETTE: {
+        case ASE_FILE_CHUNK_FLI_COLOR:
+        case ASE_FILE_CHUNK_FLI_COLOR2:
+          if (!ignore_old_color_chunks) {
             Palette* prevPal = sprite->palette(frame);
-            auto pal = ase_file_read_palette_chunk(f, *prevPal, frame);
-
+            auto pal = chunk_type == ASE_FILE_CHUNK_FLI_COLOR
+              ? ase_file_read_color_chunk(f, *prevPal, frame)
+              : ase_file_read_color2_chunk(f, *prevPal, frame);
             if (prevPal->countDiff(*pal, NULL, NULL) > 0)
               sprite->setPalette(*pal, true);
-
-            ignore_old_color_chunks = true;
-            break;
           }
+          break;
 
-          case ASE_FILE_CHUNK_LAYER: {
-            last_object_with_user_data =
-              ase_file_read_layer_chunk(f, &header, sprite.get(),
-                                        &last_layer,
-                                        &current_level);
-            break;
-          }
+        case ASE_FILE_CHUNK_PALETTE: {
+          Palette* prevPal = sprite->palette(frame);
+          auto pal = ase_file_read_palette_chunk(f, *prevPal, frame);
 
-          case ASE_FILE_CHUNK_CEL: {
-            Cel* cel =
-              ase_file_read_cel_chunk(f, sprite.get(), frame,
-                                      sprite->pixelFormat(), fop, &header,
-                                      chunk_pos+chunk_size);
-            if (cel) {
-              last_object_with_user_data = cel->data();
-            }
-            break;
-          }
+          if (prevPal->countDiff(*pal, NULL, NULL) > 0)
+            sprite->setPalette(*pal, true);
 
-          case ASE_FILE_CHUNK_MASK: {
-            Mask* mask = ase_file_read_mask_chunk(f);
-            if (mask)
-              delete mask;      // TODO add the mask in some place?
-            else
-              fop->setError("Warning: error loading a mask chunk\n");
-            break;
+          ignore_old_color_chunks = true;
+          break;
+        }
+
+        case ASE_FILE_CHUNK_LAYER: {
+          last_object_with_user_data =
+            ase_file_read_layer_chunk(f, &header, sprite.get(),
+                                      &last_layer,
+                                      &current_level);
+          break;
+        }
+
+        case ASE_FILE_CHUNK_CEL: {
+          Cel* cel =
+            ase_file_read_cel_chunk(f, sprite.get(), frame,
+                                    sprite->pixelFormat(), fop, &header,
+                                    chunk_pos+chunk_size, &pending);
+          if (cel) {
+            last_object_with_user_data = cel->data();
           }
+          break;
+        }
 
-          case ASE_FILE_CHUNK_PATH:
-            // Ignore
-            break;
+        case ASE_FILE_CHUNK_MASK: {
+          Mask* mask = ase_file_read_mask_chunk(f);
+          if (mask)
+            delete mask;      // TODO add the mask in some place?
+          else
+            fop->setError("Warning: error loading a mask chunk\n");
+          break;
+        }
 
-          case ASE_FILE_CHUNK_TAGS:
-            ase_file_read_frame_tags_chunk(f, &sprite->frameTags());
-            break;
+        case ASE_FILE_CHUNK_PATH:
+          // Ignore
+          break;
 
-          case ASE_FILE_CHUNK_USER_DATA: {
-            UserData userData;
-            ase_file_read_user_data_chunk(f, &userData);
-            if (last_object_with_user_data)
-              last_object_with_user_data->setUserData(userData);
-            break;
-          }
+        case ASE_FILE_CHUNK_TAGS:
+          ase_file_read_frame_tags_chunk(f, &sprite->frameTags());
+          break;
 
-          case ASE_FILE_CHUNK_COLOR_PROFILE: {
-            (void) fgetw(f); //  type
-            (void) fgetw(f); //  flags
-            (void) fgetl(f); //  gamma
-            ase_file_read_padding(f, 8);
-            break;
-          }
+        case ASE_FILE_CHUNK_USER_DATA: {
+          UserData userData;
+          ase_file_read_user_data_chunk(f, &userData);
+          if (last_object_with_user_data)
+            last_object_with_user_data->setUserData(userData);
+          break;
+        }
 
-          default:
-            fop->setError("Warning: Unsupported chunk type %d (skipping)\n", chunk_type);
-            break;
+        case ASE_FILE_CHUNK_COLOR_PROFILE: {
+          (void) f->read16(); //  type
+          (void) f->read16(); //  flags
+          (void) f->read32(); //  gamma
+          ase_file_read_padding(f, 8);
+          break;
         }
 
-        // Skip chunk size
-        fseek(f, chunk_pos+chunk_size, SEEK_SET);
+        default:
+          fop->setError("Warning: Unsupported chunk type %d (skipping)\n", chunk_type);
+          break;
       }
+
+      // Skip chunk size
+      f->seek(chunk_pos+chunk_size);
+    };
+
+  if (fop->isOneFrame() && fop->oneFrame() >= sprite->totalFrames()) {
+    fop->setError("Frame %d doesn't exist\n", (int)fop->oneFrame()+1);
+    return false;
+  }
+
+  // To load just one frame (other than the first one) we use the
+  // index of chunks to go directly to the chunks that we need.
+  std::shared_ptr<const ASE_FrameIndex> index;
+  if (fop->isOneFrame() && fop->oneFrame() > 0 && reader.isMapped())
+    index = ase_file_get_frame_index(f, fop->filename(), &header);
+
+  if (index) {
+    frame_t oneFrame = fop->oneFrame();
+    for (frame_t frame(0); frame<frame_t(index->frames.size()); ++frame) {
+      const ASE_FrameInfo& frameInfo = index->frames[frame];
+      if (frameInfo.duration > 0)
+        sprite->setFrameDuration(frame, frameInfo.duration);
+
+      if (frame > oneFrame)
+        continue;
+
+      for (const ASE_ChunkInfo& chunk : frameInfo.chunks) {
+        if (chunk.type != ASE_FILE_CHUNK_CEL) {
+          f->seek(chunk.pos+6);
+          read_chunk(frame, chunk.pos, chunk.size, chunk.type);
+          continue;
+        }
+
+        // Skip cels of other frames (and their user data)
+        last_object_with_user_data = nullptr;
+        if (frame != oneFrame)
+          continue;
+
+        // Read the cel with the pixels of linked cels, as a new cel of
+        // this frame
+        const ASE_ChunkInfo* original = index->findOriginalCel(&chunk);
+        if (!original) {
+          fop->setError("Linked cel not found in frame %d\n", (int)frame+1);
+          continue;
+        }
+
+        f->seek(original->pos+6);
+        Cel* cel =
+          ase_file_read_cel_chunk(f, sprite.get(), frame,
+                                  sprite->pixelFormat(), fop, &header,
+                                  original->pos+original->size, &pending);
+        if (cel) {
+          cel->setPosition(chunk.x, chunk.y);
+          cel->setOpacity(chunk.opacity);
+          last_object_with_user_data = cel->data();
+        }
+      }
+      fop->setProgress(0.5 * (frame+1) / (oneFrame+1));
     }
+  }
+  else {
+    // Read frame by frame to end-of-file
+    for (frame_t frame(0); frame<sprite->totalFrames(); ++frame) {
+      // Start frame position
+      int frame_pos = f->tell();
+      fop->setProgress(ase_file_read_progress(f, &header));
+
+      // Read frame header
+      ASE_FrameHeader frame_header;
+      ase_file_read_frame_header(f, &frame_header);
+
+      // Correct frame type
+      if (frame_header.magic == ASE_FILE_FRAME_MAGIC) {
+        // Use frame-duration field?
+        if (frame_header.duration > 0)
+          sprite->setFrameDuration(frame, frame_header.duration);
+
+        // Read chunks
+        for (int c=0; c<frame_header.chunks; c++) {
+          /* start chunk position */
+          int chunk_pos = f->tell();
+          fop->setProgress(ase_file_read_progress(f, &header));
+
+          // Read chunk information
+          int chunk_size = f->read32();
+          int chunk_type = f->read16();
+
+          read_chunk(frame, chunk_pos, chunk_size, chunk_type);
+        }
+      }
 
-    // Skip frame size
-    fseek(f, frame_pos+frame_header.size, SEEK_SET);
+      // Skip frame size
+      f->seek(frame_pos+frame_header.size);
 
-    // Just one frame?
-    if (fop->isOneFrame())
-      break;
+      // Just one frame? (when the file is not mapped, the previous
+      // frames are loaded too)
+      if (fop->isOneFrame() && frame >= fop->oneFrame())
+        break;
 
-    if (fop->isStop())
-      break;
+      if (fop->isStop())
+        break;
+    }
   }
 
+  ase_file_inflate_cels(fop, &pending);
+
+  if (fop->isOneFrame())
+    ase_file_keep_one_frame(sprite.get(), fop->oneFrame());
+
   fop->createDocument(sprite.get());
   sprite.release();
 
-  if (ferror(f)) {
+  if (f->error()) {
     fop->setError("Error reading file.\n");
     return false;
   }
@@ -375,7 +789,28 @@ bool AseFormat::onPostLoad(FileOp* fop)
 bool AseFormat::onSave(FileOp* fop)
 {
   const Sprite* sprite = fop->document()->sprite();
-  FileHandle handle(open_file_with_exception(fop->filename(), "wb"));
+
+  // Compress all images before opening the file, so if the user
+  // cancels the operation the file isn't modified.
+  ASE_CompressedImages images;
+  int level = MID(-1, Preferences::instance().general.aseCompressionLevel(), 9);
+  // If the user cancels, the file isn't touched and it's not an
+  // error (the caller checks fop->isStop()).
+  if (!ase_file_compress_cels(fop, sprite, level, &images))
+    return true;
+
+  // Other documents could have lazy cels in this same file. If it's
+  // possible we write a new file to replace the old one (their
+  // mappings keep the old content), in other case their data is
+  // copied in memory before overwriting the file.
+  ASE_TempFile tmpFile;
+  FileHandle handle;
+  if (ase_file_has_mapped_files(fop->filename()))
+    handle = ase_file_create_temp_file(fop->filename(), &tmpFile);
+  if (!handle) {
+    ase_file_detach_mapped_files(fop->filename());
+    handle = open_file_with_exception(fop->filename(), "wb");
+  }
   FILE* f = handle.get();
 
   // Write the header
@@ -430,14 +865,14 @@ bool AseFormat::onSave(FileOp* fop)
     }
 
     // Write cel chunks
-    ase_file_write_cels(f, &frame_header, sprite, sprite->folder(), frame);
+    ase_file_write_cels(f, &frame_header, sprite, sprite->folder(), frame, &images);
 
     // Write the frame header
     ase_file_write_frame_header(f, &frame_header);
 
     // Progress
     if (sprite->totalFrames() > 1)
-      fop->setProgress(float(frame+1) / float(sprite->totalFrames()));
+      fop->setProgress(0.5f + 0.5f * float(frame+1) / float(sprite->totalFrames()));
 
     if (fop->isStop())
       break;
@@ -446,44 +881,77 @@ bool AseFormat::onSave(FileOp* fop)
   // Write the missing field (filesize) of the header.
   ase_file_write_header_filesize(f, &header);
 
+  if (!tmpFile.filename.empty())
+    fflush(f);
+
   if (ferror(f)) {
     fop->setError("Error writing file.\n");
     return false;
   }
-  else {
-    return true;
+
+  if (!tmpFile.filename.empty()) {
+    // If the user cancels, the old file is kept
+    if (fop->isStop())
+      return true;
+
+    handle.reset();
+    try {
+      base::move_file(tmpFile.filename, tmpFile.dstFilename);
+    }
+    catch (const std::exception& ex) {
+      fop->setError("Error replacing file: %s\n", ex.what());
+      return false;
+    }
+    tmpFile.filename.clear();
+  }
+
+  // The pixels of lazy cels that couldn't be loaded were saved as
+  // empty images, the error keeps the document as modified.
+  std::string failedFile = ase_file_get_failed_mapped_file(sprite->id());
+  if (!failedFile.empty()) {
+    fop->setError("Some cels were saved empty because \"%s\" was modified\n"
+                  "by other program before their pixels were loaded.\n",
+                  failedFile.c_str());
   }
+  return true;
 }
 
-static bool ase_file_read_header(FILE* f, ASE_Header* header)
+static bool ase_file_read_header(AseReader* f, ASE_Header* header)
 {
-  header->pos = ftell(f);
+  header->pos = f->tell();
 
-  header->size  = fgetl(f);
-  header->magic = fgetw(f);
+  header->size  = f->read32();
+  header->magic = f->read16();
   if (header->magic != ASE_FILE_MAGIC)
     return false;
 
-  header->frames     = fgetw(f);
-  header->width      = fgetw(f);
-  header->height     = fgetw(f);
-  header->depth      = fgetw(f);
-  header->flags      = fgetl(f);
-  header->speed      = fgetw(f);
-  header->next       = fgetl(f);
-  header->frit       = fgetl(f);
-  header->transparent_index = fgetc(f);
-  header->ignore[0]  = fgetc(f);
-  header->ignore[1]  = fgetc(f);
-  header->ignore[2]  = fgetc(f);
-  header->ncolors    = fgetw(f);
+  header->frames     = f->read16();
+  header->width      = f->read16();
+  header->height     = f->read16();
+  header->depth      = f->read16();
+  header->flags      = f->read32();
+  header->speed      = f->read16();
+  header->next       = f->read32();
+  header->frit       = f->read32();
+  header->transparent_index = f->read8();
+  header->ignore[0]  = f->read8();
+  header->ignore[1]  = f->read8();
+  header->ignore[2]  = f->read8();
+  header->ncolors    = f->read16();
   if (header->ncolors == 0)     // 0 means 256 (old .ase files)
     header->ncolors = 256;
 
-  fseek(f, header->pos+128, SEEK_SET);
+  f->seek(header->pos+128);
   return true;
 }
 
+// Progress of the first pass of AseFormat::onLoad() (reading chunks),
+// the second half of the progress is used to inflate cels.
+static float ase_file_read_progress(AseReader* f, ASE_Header* header)
+{
+  return 0.5f * (float)f->tell() / (float)header->size;
+}
+
 static void ase_file_prepare_header(FILE* f, ASE_Header* header, const Sprite* sprite)
 {
   header->pos = ftell(f);
@@ -540,15 +1008,191 @@ static void ase_file_write_header_filesize(FILE* f, ASE_Header* header)
   fseek(f, header->pos+header->size, SEEK_SET);
 }
 
-static void ase_file_read_frame_header(FILE* f, ASE_FrameHeader* frame_header)
+static void ase_file_read_frame_header(AseReader* f, ASE_FrameHeader* frame_header)
 {
-  frame_header->size = fgetl(f);
-  frame_header->magic = fgetw(f);
-  frame_header->chunks = fgetw(f);
-  frame_header->duration = fgetw(f);
+  frame_header->size = f->read32();
+  frame_header->magic = f->read16();
+  frame_header->chunks = f->read16();
+  frame_header->duration = f->read16();
   ase_file_read_padding(f, 6);
 }
 
+// Mapped files with lazy cels of the opened sprites
+static base::mutex mapped_files_mutex;
+static std::vector<std::weak_ptr<AseMappedFile>> mapped_files;
+
+static std::shared_ptr<AseMappedFile> ase_file_add_mapped_file(const std::shared_ptr<base::FileMapping>& mapping, const std::string& filename, ObjectId spriteId)
+{
+  auto mappedFile = std::make_shared<AseMappedFile>(mapping, filename, spriteId);
+
+  base::scoped_lock lock(mapped_files_mutex);
+  mapped_files.erase(
+    std::remove_if(mapped_files.begin(), mapped_files.end(),
+                   [](const std::weak_ptr<AseMappedFile>& ptr){
+                     return ptr.expired();
+                   }),
+    mapped_files.end());
+  mapped_files.push_back(mappedFile);
+  return mappedFile;
+}
+
+static bool ase_file_has_mapped_files(const std::string& filename)
+{
+  std::string fn = base::normalize_path(filename);
+
+  base::scoped_lock lock(mapped_files_mutex);
+  for (auto& ptr : mapped_files) {
+    auto mappedFile = ptr.lock();
+    if (mappedFile && mappedFile->normalizedFilename() == fn)
+      return true;
+  }
+  return false;
+}
+
+static void ase_file_detach_mapped_files(const std::string& filename)
+{
+  std::string fn = base::normalize_path(filename);
+
+  base::scoped_lock lock(mapped_files_mutex);
+  for (auto& ptr : mapped_files) {
+    auto mappedFile = ptr.lock();
+    if (mappedFile && mappedFile->normalizedFilename() == fn)
+      mappedFile->detach();
+  }
+}
+
+// Creates a new file in the same directory of the given file (or of
+// the file it links to) to replace it. Returns nullptr if the file
+// cannot be replaced keeping the mappings of the old one valid.
+static FileHandle ase_file_create_temp_file(const std::string& filename, ASE_TempFile* tmpFile)
+{
+#ifdef _WIN32
+  // Mapped files cannot be replaced
+  (void)filename;
+  (void)tmpFile;
+  return FileHandle();
+#else
+  std::string dstFilename = base::get_canonical_path(filename);
+
+  // Other hard links would keep the old file
+  struct stat sts;
+  if (::stat(dstFilename.c_str(), &sts) != 0 ||
+      !S_ISREG(sts.st_mode) ||
+      sts.st_nlink != 1)
+    return FileHandle();
+
+  std::string tmpFilename =
+    dstFilename + "." +
+    base::convert_to<std::string>(int(base::get_current_process_id())) +
+    ".tmp";
+  FileHandle handle = open_file(tmpFilename, "wb");
+  if (!handle)
+    return handle;
+
+  // The new file keeps the permissions of the old one
+  fchmod(fileno(handle.get()), sts.st_mode & 07777);
+
+  tmpFile->filename = tmpFilename;
+  tmpFile->dstFilename = dstFilename;
+  return handle;
+#endif
+}
+
+// Returns the name of the file from where some lazy cels of the
+// given sprite couldn't be loaded (or an empty string).
+static std::string ase_file_get_failed_mapped_file(ObjectId spriteId)
+{
+  base::scoped_lock lock(mapped_files_mutex);
+  for (auto& ptr : mapped_files) {
+    auto mappedFile = ptr.lock();
+    if (mappedFile &&
+        mappedFile->spriteId() == spriteId &&
+        mappedFile->failed())
+      return mappedFile->filename();
+  }
+  return std::string();
+}
+
+static std::shared_ptr<const ASE_FrameIndex> ase_file_get_frame_index(AseReader* f, const std::string& filename, ASE_Header* header)
+{
+  // Indexes of the last files, e.g. to extract several frames from
+  // the same file or to generate thumbnails again.
+  static base::mutex cache_mutex;
+  static std::vector<std::shared_ptr<const ASE_FrameIndex>> cache;
+  const std::size_t cache_size = 8;
+
+  base::Time mtime = base::get_modification_time(filename);
+  std::size_t size = base::file_size(filename);
+  {
+    base::scoped_lock lock(cache_mutex);
+    for (auto it=cache.begin(); it!=cache.end(); ++it) {
+      if ((*it)->filename == filename) {
+        auto index = *it;
+        cache.erase(it);
+        if (mtime == index->mtime && size == index->size) {
+          cache.push_back(index);
+          return index;
+        }
+        break;
+      }
+    }
+  }
+
+  auto index = std::make_shared<ASE_FrameIndex>();
+  index->filename = filename;
+  index->mtime = mtime;
+  index->size = size;
+
+  long pos = f->tell();
+  long frame_pos = header->pos+128;
+  for (int frame=0; frame<header->frames; ++frame) {
+    f->seek(frame_pos);
+
+    ASE_FrameHeader frame_header;
+    ase_file_read_frame_header(f, &frame_header);
+
+    ASE_FrameInfo frameInfo;
+    frameInfo.duration = 0;
+
+    if (frame_header.magic == ASE_FILE_FRAME_MAGIC) {
+      frameInfo.duration = frame_header.duration;
+
+      for (int c=0; c<frame_header.chunks; c++) {
+        ASE_ChunkInfo chunk = ASE_ChunkInfo();
+        chunk.pos = f->tell();
+        chunk.size = f->read32();
+        chunk.type = f->read16();
+        if (chunk.size < 6)
+          break;
+
+        if (chunk.type == ASE_FILE_CHUNK_CEL) {
+          chunk.layer = LayerIndex(f->read16());
+          chunk.x = ((short)f->read16());
+          chunk.y = ((short)f->read16());
+          chunk.opacity = f->read8();
+          chunk.cel_type = f->read16();
+          ase_file_read_padding(f, 7);
+          chunk.link_frame = (chunk.cel_type == ASE_FILE_LINK_CEL ?
+                              frame_t(f->read16()): frame_t(0));
+        }
+        frameInfo.chunks.push_back(chunk);
+
+        f->seek(chunk.pos+chunk.size);
+      }
+    }
+    index->frames.push_back(std::move(frameInfo));
+
+    frame_pos += frame_header.size;
+  }
+  f->seek(pos);
+
+  base::scoped_lock lock(cache_mutex);
+  if (cache.size() == cache_size)
+    cache.erase(cache.begin());
+  cache.push_back(index);
+  return index;
+}
+
 static void ase_file_prepare_frame_header(FILE* f, ASE_FrameHeader* frame_header)
 {
   int pos = ftell(f);
@@ -594,14 +1238,14 @@ static void ase_file_write_layers(FILE* f, ASE_FrameHeader* frame_header, const
   }
 }
 
-static void ase_file_write_cels(FILE* f, ASE_FrameHeader* frame_header, const Sprite* sprite, const Layer* layer, frame_t frame)
+static void ase_file_write_cels(FILE* f, ASE_FrameHeader* frame_header, const Sprite* sprite, const Layer* layer, frame_t frame, const ASE_CompressedImages* images)
 {
   if (layer->isImage()) {
     if (auto cel = layer->cel(frame)) {
 /*       fop->setError("New cel in frame %d, in layer %d\n", */
 /*                   frame, sprite_layer2index(sprite, layer)); */
 
-      ase_file_write_cel_chunk(f, frame_header, cel.get(), static_cast<const LayerImage*>(layer), sprite);
+      ase_file_write_cel_chunk(f, frame_header, cel.get(), static_cast<const LayerImage*>(layer), sprite, images);
 
       if (!cel->link() &&
           !cel->data()->userData().isEmpty()) {
@@ -616,14 +1260,14 @@ static void ase_file_write_cels(FILE* f, ASE_FrameHeader* frame_header, const Sp
          end = static_cast<const LayerFolder*>(layer)->getLayerEnd();
 
     for (; it != end; ++it)
-      ase_file_write_cels(f, frame_header, sprite, *it, frame);
+      ase_file_write_cels(f, frame_header, sprite, *it, frame, images);
   }
 }
 
-static void ase_file_read_padding(FILE* f, int bytes)
+static void ase_file_read_padding(AseReader* f, int bytes)
 {
   for (int c=0; c<bytes; c++)
-    fgetc(f);
+    f->read8();
 }
 
 static void ase_file_write_padding(FILE* f, int bytes)
@@ -632,9 +1276,9 @@ static void ase_file_write_padding(FILE* f, int bytes)
     fputc(0, f);
 }
 
-static std::string ase_file_read_string(FILE* f)
+static std::string ase_file_read_string(AseReader* f)
 {
-  int length = fgetw(f);
+  int length = f->read16();
   if (length == EOF)
     return "";
 
@@ -642,7 +1286,7 @@ static std::string ase_file_read_string(FILE* f)
   string.reserve(length+1);
 
   for (int c=0; c<length; c++)
-    string.push_back(fgetc(f));
+    string.push_back(f->read8());
 
   return string;
 }
@@ -676,25 +1320,25 @@ static void ase_file_write_close_chunk(FILE* f, ASE_Chunk* chunk)
   fseek(f, chunk_end, SEEK_SET);
 }
 
-static std::shared_ptr<Palette> ase_file_read_color_chunk(FILE* f, const Palette& prevPal, frame_t frame)
+static std::shared_ptr<Palette> ase_file_read_color_chunk(AseReader* f, const Palette& prevPal, frame_t frame)
 {
   int i, c, r, g, b, packets, skip, size;
   auto pal = prevPal.clone();
   pal->setFrame(frame);
 
-  packets = fgetw(f);   // Number of packets
+  packets = f->read16();   // Number of packets
   skip = 0;
 
   // Read all packets
   for (i=0; i<packets; i++) {
-    skip += fgetc(f);
-    size = fgetc(f);
+    skip += f->read8();
+    size = f->read8();
     if (!size) size = 256;
 
     for (c=skip; c<skip+size; c++) {
-      r = fgetc(f);
-      g = fgetc(f);
-      b = fgetc(f);
+      r = f->read8();
+      g = f->read8();
+      b = f->read8();
       pal->setEntry(c, rgba(scale_6bits_to_8bits(r),
                             scale_6bits_to_8bits(g),
                             scale_6bits_to_8bits(b), 255));
@@ -704,25 +1348,25 @@ static std::shared_ptr<Palette> ase_file_read_color_chunk(FILE* f, const Palette
   return pal;
 }
 
-static std::shared_ptr<Palette> ase_file_read_color2_chunk(FILE* f, const Palette& prevPal, frame_t frame)
+static std::shared_ptr<Palette> ase_file_read_color2_chunk(AseReader* f, const Palette& prevPal, frame_t frame)
 {
   int i, c, r, g, b, packets, skip, size;
   auto pal = prevPal.clone();
   pal->setFrame(frame);
 
-  packets = fgetw(f);   // Number of packets
+  packets = f->read16();   // Number of packets
   skip = 0;
 
   // Read all packets
   for (i=0; i<packets; i++) {
-    skip += fgetc(f);
-    size = fgetc(f);
+    skip += f->read8();
+    size = f->read8();
     if (!size) size = 256;
 
     for (c=skip; c<skip+size; c++) {
-      r = fgetc(f);
-      g = fgetc(f);
-      b = fgetc(f);
+      r = f->read8();
+      g = f->read8();
+      b = f->read8();
       pal->setEntry(c, rgba(r, g, b, 255));
     }
   }
@@ -730,25 +1374,25 @@ static std::shared_ptr<Palette> ase_file_read_color2_chunk(FILE* f, const Palett
   return pal;
 }
 
-static std::shared_ptr<Palette> ase_file_read_palette_chunk(FILE* f, const Palette& prevPal, frame_t frame)
+static std::shared_ptr<Palette> ase_file_read_palette_chunk(AseReader* f, const Palette& prevPal, frame_t frame)
 {
   auto pal = prevPal.clone();
   pal->setFrame(frame);
 
-  int newSize = fgetl(f);
-  int from = fgetl(f);
-  int to = fgetl(f);
+  int newSize = f->read32();
+  int from = f->read32();
+  int to = f->read32();
   ase_file_read_padding(f, 8);
 
   if (newSize > 0)
     pal->resize(newSize);
 
   for (int c=from; c<=to; ++c) {
-    int flags = fgetw(f);
-    int r = fgetc(f);
-    int g = fgetc(f);
-    int b = fgetc(f);
-    int a = fgetc(f);
+    int flags = f->read16();
+    int r = f->read8();
+    int g = f->read8();
+    int b = f->read8();
+    int a = f->read8();
     pal->setEntry(c, rgba(r, g, b, a));
 
     // Skip name
@@ -798,7 +1442,7 @@ static void ase_file_write_palette_chunk(FILE* f, ASE_FrameHeader* frame_header,
   }
 }
 
-static Layer* ase_file_read_layer_chunk(FILE* f, ASE_Header* header, Sprite* sprite, Layer** previous_layer, int* current_level)
+static Layer* ase_file_read_layer_chunk(AseReader* f, ASE_Header* header, Sprite* sprite, Layer** previous_layer, int* current_level)
 {
   std::string name;
   Layer* layer = NULL;
@@ -807,13 +1451,13 @@ static Layer* ase_file_read_layer_chunk(FILE* f, ASE_Header* header, Sprite* spr
   int layer_type;
   int child_level;
 
-  flags = fgetw(f);
-  layer_type = fgetw(f);
-  child_level = fgetw(f);
-  fgetw(f);                     // default width
-  fgetw(f);                     // default height
-  int blendmode = fgetw(f);     // blend mode
-  int opacity = fgetc(f);       // opacity
+  flags = f->read16();
+  layer_type = f->read16();
+  child_level = f->read16();
+  f->read16();                     // default width
+  f->read16();                     // default height
+  int blendmode = f->read16();     // blend mode
+  int opacity = f->read8();       // opacity
 
   ase_file_read_padding(f, 3);
   name = ase_file_read_string(f);
@@ -897,7 +1541,7 @@ static void ase_file_write_layer_chunk(FILE* f, ASE_FrameHeader* frame_header, c
 template<typename ImageTraits>
 class PixelIO {
 public:
-  typename ImageTraits::pixel_t read_pixel(FILE* f);
+  typename ImageTraits::pixel_t read_pixel(AseReader* f);
   void write_pixel(FILE* f, typename ImageTraits::pixel_t c);
   void read_scanline(typename ImageTraits::address_t address, int w, uint8_t* buffer);
   void write_scanline(typename ImageTraits::address_t address, int w, uint8_t* buffer);
@@ -907,11 +1551,11 @@ template<>
 class PixelIO<RgbTraits> {
   int r, g, b, a;
 public:
-  RgbTraits::pixel_t read_pixel(FILE* f) {
-    r = fgetc(f);
-    g = fgetc(f);
-    b = fgetc(f);
-    a = fgetc(f);
+  RgbTraits::pixel_t read_pixel(AseReader* f) {
+    r = f->read8();
+    g = f->read8();
+    b = f->read8();
+    a = f->read8();
     return rgba(r, g, b, a);
   }
   void write_pixel(FILE* f, RgbTraits::pixel_t c) {
@@ -946,9 +1590,9 @@ template<>
 class PixelIO<GrayscaleTraits> {
   int k, a;
 public:
-  GrayscaleTraits::pixel_t read_pixel(FILE* f) {
-    k = fgetc(f);
-    a = fgetc(f);
+  GrayscaleTraits::pixel_t read_pixel(AseReader* f) {
+    k = f->read8();
+    a = f->read8();
     return graya(k, a);
   }
   void write_pixel(FILE* f, GrayscaleTraits::pixel_t c) {
@@ -976,8 +1620,8 @@ public:
 template<>
 class PixelIO<IndexedTraits> {
 public:
-  IndexedTraits::pixel_t read_pixel(FILE* f) {
-    return fgetc(f);
+  IndexedTraits::pixel_t read_pixel(AseReader* f) {
+    return f->read8();
   }
   void write_pixel(FILE* f, IndexedTraits::pixel_t c) {
     fputc(c, f);
@@ -997,7 +1641,7 @@ public:
 //////////////////////////////////////////////////////////////////////
 
 template<typename ImageTraits>
-static void read_raw_image(FILE* f, Image* image, FileOp* fop, ASE_Header* header)
+static void read_raw_image(AseReader* f, Image* image, FileOp* fop, ASE_Header* header)
 {
   PixelIO<ImageTraits> pixel_io;
   int x, y;
@@ -1006,7 +1650,7 @@ static void read_raw_image(FILE* f, Image* image, FileOp* fop, ASE_Header* heade
     for (x=0; x<image->width(); x++)
       put_pixel_fast<ImageTraits>(image, x, y, pixel_io.read_pixel(f));
 
-    fop->setProgress((float)ftell(f) / (float)header->size);
+    fop->setProgress(ase_file_read_progress(f, header));
   }
 }
 
@@ -1025,145 +1669,231 @@ static void write_raw_image(FILE* f, const Image* image)
 // Compressed Image
 //////////////////////////////////////////////////////////////////////
 
+// Inflates the pixels of a compressed cel directly in the rows of the
+// image. The whole zlib stream is given to zlib at once (it's in
+// memory or in the file mapping). It doesn't use the
+// FileOp, so several images can be inflated at the same time from
+// different threads.
 template<typename ImageTraits>
-static void read_compressed_image(FILE* f, Image* image, size_t chunk_end, FileOp* fop, ASE_Header* header)
+static void inflate_compressed_image(const uint8_t* data, std::size_t size, Image* image)
 {
-  PixelIO<ImageTraits> pixel_io;
   z_stream zstream;
   int y, err;
 
   zstream.zalloc = (alloc_func)0;
   zstream.zfree  = (free_func)0;
   zstream.opaque = (voidpf)0;
+  zstream.next_in = (Bytef*)data;
+  zstream.avail_in = size;
 
   err = inflateInit(&zstream);
   if (err != Z_OK)
     throw base::Exception("ZLib error %d in inflateInit().", err);
 
-  std::vector<uint8_t> scanline(ImageTraits::getRowStrideBytes(image->width()));
-  std::vector<uint8_t> uncompressed(static_cast<long>(image->height()) * ImageTraits::getRowStrideBytes(image->width()));
-  std::vector<uint8_t> compressed(4096);
-  int uncompressed_offset = 0;
-
-  while (true) {
-    size_t input_bytes;
+  const int rowBytes = ImageTraits::getRowStrideBytes(image->width());
+  bool end = false;
+  err = Z_OK;
 
-    if (ftell(f)+compressed.size() > chunk_end) {
-      input_bytes = chunk_end - ftell(f); // Remaining bytes
-      ASSERT(input_bytes < compressed.size());
-
-      if (input_bytes == 0)
-        break;                  // Done, we consumed all chunk
-    }
-    else
-      input_bytes = compressed.size();
-
-    size_t bytes_read = fread(&compressed[0], 1, input_bytes, f);
-    zstream.next_in = (Bytef*)&compressed[0];
-    zstream.avail_in = bytes_read;
+  for (y=0; y<image->height(); y++) {
+    uint8_t* address = image->getPixelAddress(0, y);
 
-    do {
-      zstream.next_out = (Bytef*)&scanline[0];
-      zstream.avail_out = scanline.size();
+    zstream.next_out = (Bytef*)address;
+    zstream.avail_out = rowBytes;
 
+    while (!end && zstream.avail_out > 0) {
       err = inflate(&zstream, Z_NO_FLUSH);
-      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
-        throw base::Exception("ZLib error %d in inflate().", err);
-
-      size_t uncompressed_bytes = scanline.size() - zstream.avail_out;
-      if (uncompressed_bytes > 0) {
-        if (uncompressed_offset+uncompressed_bytes > uncompressed.size())
-          throw base::Exception("Bad compressed image.");
-
-        std::copy(scanline.begin(), scanline.begin()+uncompressed_bytes,
-                  uncompressed.begin()+uncompressed_offset);
+      if (err == Z_STREAM_END)
+        end = true;
+      else if (err == Z_BUF_ERROR)
+        end = true;             // Truncated data, the rest is cleared
+      else if (err != Z_OK)
+        break;
+    }
+    if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+      break;
 
-        uncompressed_offset += uncompressed_bytes;
-      }
-    } while (zstream.avail_out == 0);
+    // Missing pixels are cleared (like old versions did)
+    if (zstream.avail_out > 0)
+      std::fill(address + rowBytes - zstream.avail_out, address + rowBytes, 0);
 
-    fop->setProgress((float)ftell(f) / (float)header->size);
+#ifdef ASEPRITE_BIG_ENDIAN
+    // In memory pixels aren't in the same byte order than in the file
+    PixelIO<ImageTraits>().read_scanline(
+      (typename ImageTraits::address_t)address, image->width(), address);
+#endif
   }
 
-  uncompressed_offset = 0;
-  for (y=0; y<image->height(); y++) {
-    typename ImageTraits::address_t address =
-      (typename ImageTraits::address_t)image->getPixelAddress(0, y);
+  // Check that there are no more pixels than what the image can hold
+  if (err == Z_OK && !end) {
+    uint8_t extra;
+    zstream.next_out = (Bytef*)&extra;
+    zstream.avail_out = 1;
+    inflate(&zstream, Z_NO_FLUSH);
+    if (zstream.avail_out == 0)
+      err = Z_DATA_ERROR;
+  }
 
-    pixel_io.read_scanline(address, image->width(), &uncompressed[uncompressed_offset]);
+  inflateEnd(&zstream);
 
-    uncompressed_offset += ImageTraits::getRowStrideBytes(image->width());
+  if (y < image->height()) {
+    for (; y<image->height(); y++) {
+      uint8_t* address = image->getPixelAddress(0, y);
+      std::fill(address, address + rowBytes, 0);
+    }
+    throw base::Exception("ZLib error %d in inflate().", err);
   }
-
-  err = inflateEnd(&zstream);
-  if (err != Z_OK)
-    throw base::Exception("ZLib error %d in inflateEnd().", err);
+  if (err == Z_DATA_ERROR)
+    throw base::Exception("Bad compressed image.");
 }
 
+// Compresses the pixels of the image in memory (the data of a
+// ASE_FILE_COMPRESSED_CEL). It doesn't use the file, so several
+// images can be compressed at the same time from different threads.
+// The image is compressed in "scratch" (reused between images) and
+// then copied to "output" with the exact size, as the outputs of all
+// images are kept in memory until they are written.
 template<typename ImageTraits>
-static void write_compressed_image(FILE* f, const Image* image)
+static void deflate_compressed_image(const Image* image, int level,
+                                     base::buffer& scratch, base::buffer& output)
 {
-  PixelIO<ImageTraits> pixel_io;
   z_stream zstream;
   int y, err;
 
   zstream.zalloc = (alloc_func)0;
   zstream.zfree  = (free_func)0;
   zstream.opaque = (voidpf)0;
-  err = deflateInit(&zstream, Z_DEFAULT_COMPRESSION);
+  err = deflateInit(&zstream, level);
   if (err != Z_OK)
     throw base::Exception("ZLib error %d in deflateInit().", err);
 
-  std::vector<uint8_t> scanline(ImageTraits::getRowStrideBytes(image->width()));
-  std::vector<uint8_t> compressed(4096);
-
-  for (y=0; y<image->height(); y++) {
-    typename ImageTraits::address_t address =
-      (typename ImageTraits::address_t)image->getPixelAddress(0, y);
+  const int rowBytes = ImageTraits::getRowStrideBytes(image->width());
+#ifdef ASEPRITE_BIG_ENDIAN
+  PixelIO<ImageTraits> pixel_io;
+  std::vector<uint8_t> scanline(rowBytes);
+#endif
 
-    pixel_io.write_scanline(address, image->width(), &scanline[0]);
+  // Usually the whole image fits in this size
+  const std::size_t bound = deflateBound(&zstream, uLong(rowBytes) * image->height());
+  if (scratch.size() < bound)
+    scratch.resize(bound);
+  zstream.next_out = (Bytef*)&scratch[0];
+  zstream.avail_out = scratch.size();
 
+  for (y=0; y<image->height(); y++) {
+#ifdef ASEPRITE_BIG_ENDIAN
+    pixel_io.write_scanline(
+      (typename ImageTraits::address_t)image->getPixelAddress(0, y),
+      image->width(), &scanline[0]);
     zstream.next_in = (Bytef*)&scanline[0];
-    zstream.avail_in = scanline.size();
+#else
+    // Pixels in memory have the same byte order as in the file
+    zstream.next_in = (Bytef*)image->getPixelAddress(0, y);
+#endif
+    zstream.avail_in = rowBytes;
     int flush = (y == image->height()-1 ? Z_FINISH: Z_NO_FLUSH);
 
     do {
-      zstream.next_out = (Bytef*)&compressed[0];
-      zstream.avail_out = compressed.size();
+      if (zstream.avail_out == 0) {
+        scratch.resize(scratch.size() + 4096);
+        zstream.next_out = (Bytef*)&scratch[zstream.total_out];
+        zstream.avail_out = scratch.size() - zstream.total_out;
+      }
 
       // Compress
       err = deflate(&zstream, flush);
       if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
-        throw base::Exception("ZLib error %d in deflate().", err);
-
-      int output_bytes = compressed.size() - zstream.avail_out;
-      if (output_bytes > 0) {
-        if ((fwrite(&compressed[0], 1, output_bytes, f) != (size_t)output_bytes)
-            || ferror(f))
-          throw base::Exception("Error writing compressed image pixels.\n");
-      }
+        break;
     } while (zstream.avail_out == 0);
+
+    if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+      break;
   }
 
-  err = deflateEnd(&zstream);
-  if (err != Z_OK)
-    throw base::Exception("ZLib error %d in deflateEnd().", err);
+  output.assign(scratch.begin(), scratch.begin() + zstream.total_out);
+  deflateEnd(&zstream);
+
+  if (y < image->height())
+    throw base::Exception("ZLib error %d in deflate().", err);
 }
 
+// Inflates the pixels of a compressed cel from the mapped file the
+// first time they are needed (FILE_LOAD_LAZY_CELS).
+class AseCelLoader : public ImageLoader {
+public:
+  AseCelLoader(const ASE_PendingCels* pending,
+               PixelFormat pixelFormat, int w, int h, color_t maskColor,
+               std::size_t offset, std::size_t size)
+    : m_mappedFile(pending->mappedFile)
+    , m_pixelFormat(pixelFormat)
+    , m_width(w)
+    , m_height(h)
+    , m_maskColor(maskColor)
+    , m_offset(offset)
+    , m_size(size) {
+  }
+
+  ImageRef loadImage() override {
+    ImageRef image(Image::create(m_pixelFormat, m_width, m_height));
+    image->setMaskColor(m_maskColor);
+
+    try {
+      bool ok = m_mappedFile->read(m_offset, [this, &image](const uint8_t* data){
+        switch (m_pixelFormat) {
+
+          case IMAGE_RGB:
+            inflate_compressed_image<RgbTraits>(data, m_size, image.get());
+            break;
+
+          case IMAGE_GRAYSCALE:
+            inflate_compressed_image<GrayscaleTraits>(data, m_size, image.get());
+            break;
+
+          case IMAGE_INDEXED:
+            inflate_compressed_image<IndexedTraits>(data, m_size, image.get());
+            break;
+        }
+      });
+
+      // We cannot trust the mapped data if the file was modified
+      if (!ok) {
+        LOG("ASE: File \"%s\" was modified, cel pixels cannot be loaded\n",
+            m_mappedFile->filename().c_str());
+        image->clear(0);
+      }
+    }
+    catch (const std::exception& e) {
+      LOG("ASE: Error loading cel pixels from \"%s\": %s\n",
+          m_mappedFile->filename().c_str(), e.what());
+      m_mappedFile->setFailed();
+    }
+    return image;
+  }
+
+private:
+  std::shared_ptr<AseMappedFile> m_mappedFile;
+  PixelFormat m_pixelFormat;
+  int m_width;
+  int m_height;
+  color_t m_maskColor;
+  std::size_t m_offset;
+  std::size_t m_size;
+};
+
 //////////////////////////////////////////////////////////////////////
 // Cel Chunk
 //////////////////////////////////////////////////////////////////////
 
-static Cel* ase_file_read_cel_chunk(FILE* f, Sprite* sprite, frame_t frame,
+static Cel* ase_file_read_cel_chunk(AseReader* f, Sprite* sprite, frame_t frame,
                                     PixelFormat pixelFormat,
-                                    FileOp* fop, ASE_Header* header, size_t chunk_end)
+                                    FileOp* fop, ASE_Header* header, size_t chunk_end,
+                                    ASE_PendingCels* pending)
 {
   /* read chunk data */
-  LayerIndex layer_index = LayerIndex(fgetw(f));
-  int x = ((short)fgetw(f));
-  int y = ((short)fgetw(f));
-  int opacity = fgetc(f);
-  int cel_type = fgetw(f);
+  LayerIndex layer_index = LayerIndex(f->read16());
+  int x = ((short)f->read16());
+  int y = ((short)f->read16());
+  int opacity = f->read8();
+  int cel_type = f->read16();
   Layer* layer;
 
   ase_file_read_padding(f, 7);
@@ -1187,8 +1917,8 @@ static Cel* ase_file_read_cel_chunk(FILE* f, Sprite* sprite, frame_t frame,
 
     case ASE_FILE_RAW_CEL: {
       // Read width and height
-      int w = fgetw(f);
-      int h = fgetw(f);
+      int w = f->read16();
+      int h = f->read16();
 
       if (w > 0 && h > 0) {
         ImageRef image(Image::create(pixelFormat, w, h));
@@ -1218,7 +1948,7 @@ static Cel* ase_file_read_cel_chunk(FILE* f, Sprite* sprite, frame_t frame,
 
     case ASE_FILE_LINK_CEL: {
       // Read link position
-      frame_t link_frame = frame_t(fgetw(f));
+      frame_t link_frame = frame_t(f->read16());
       if (auto link = layer->cel(link_frame)) {
         // There were a beta version that allow to the user specify
         // different X, Y, or opacity per link, in that case we must
@@ -1232,6 +1962,9 @@ static Cel* ase_file_read_cel_chunk(FILE* f, Sprite* sprite, frame_t frame,
           cel->setFrame(frame);
           cel->setPosition(x, y);
           cel->setOpacity(opacity);
+
+          // The original image could be still compressed
+          pending->copies.push_back(std::make_pair(cel->imageRef(), link->imageRef()));
         }
       } else {
         // Linked cel not found
@@ -1242,52 +1975,256 @@ static Cel* ase_file_read_cel_chunk(FILE* f, Sprite* sprite, frame_t frame,
 
     case ASE_FILE_COMPRESSED_CEL: {
       // Read width and height
-      int w = fgetw(f);
-      int h = fgetw(f);
-
-      if (w > 0 && h > 0) {
+      int w = f->read16();
+      int h = f->read16();
+
+      if (w > 0 && h > 0 && pending->mappedFile) {
+        // Lazy loading, we just remember where the pixels are
+        long pos = f->tell();
+        std::size_t size = 0;
+        if (pos >= 0 && size_t(pos) < chunk_end)
+          size = chunk_end - pos;
+        base::buffer unused;
+        const uint8_t* data = f->readBlock(size, unused);
+
+        CelDataRef celData(new CelData(ImageRef()));
+        celData->setPendingImage(
+          gfx::Size(w, h),
+          std::make_shared<AseCelLoader>(
+            pending, pixelFormat, w, h, sprite->transparentColor(),
+            pending->mappedFile->offset(data), size));
+
+        cel = std::make_shared<Cel>(frame, celData);
+        cel->setPosition(x, y);
+        cel->setOpacity(opacity);
+      }
+      else if (w > 0 && h > 0) {
         ImageRef image(Image::create(pixelFormat, w, h));
 
-        // Try to read pixel data
+        // Keep the compressed pixels, they are inflated when all
+        // chunks are read (see ase_file_inflate_cels())
+        ASE_CompressedCel compressed;
+        compressed.image = image;
+        compressed.size = 0;
+        long pos = f->tell();
+        if (pos >= 0 && size_t(pos) < chunk_end)
+          compressed.size = chunk_end - pos;
+        compressed.data = f->readBlock(compressed.size, compressed.buffer);
+        pending->compressed.push_back(std::move(compressed));
+
+        cel = std::make_shared<Cel>(frame, image);
+        cel->setPosition(x, y);
+        cel->setOpacity(opacity);
+      }
+      break;
+    }
+
+  }
+
+  if (cel)
+    static_cast<LayerImage*>(layer)->addCel(cel);
+
+  return cel.get();
+}
+
+// Leaves just the given frame in the sprite (as the first frame, with
+// its cels, duration, and palette), so the result of
+// FILE_LOAD_ONE_FRAME doesn't depend on how the frame was read (with
+// the index of chunks or reading the previous frames too).
+static void ase_file_keep_one_frame(Sprite* sprite, frame_t frame)
+{
+  std::vector<std::shared_ptr<Cel>> cels;
+  for (auto cel : sprite->cels())
+    cels.push_back(cel);
+
+  for (auto& cel : cels) {
+    if (cel->frame() != frame)
+      cel->layer()->removeCel(cel);
+  }
+  for (auto& cel : cels) {
+    if (cel->frame() == frame)
+      cel->layer()->moveCel(cel, frame_t(0));
+  }
+
+  std::shared_ptr<Palette> palette = sprite->palette(frame)->clone();
+  palette->setFrame(frame_t(0));
+  sprite->resetPalettes();
+  sprite->setPalette(*palette, true);
+
+  int duration = sprite->frameDuration(frame);
+  sprite->setTotalFrames(frame_t(1));
+  sprite->setFrameDuration(frame_t(0), duration);
+
+  // Tags of other frames are removed
+  std::vector<FrameTag*> tags(sprite->frameTags().begin(),
+                              sprite->frameTags().end());
+  for (FrameTag* tag : tags) {
+    if (tag->fromFrame() <= frame && frame <= tag->toFrame())
+      tag->setFrameRange(frame_t(0), frame_t(0));
+    else {
+      sprite->frameTags().remove(tag);
+      delete tag;
+    }
+  }
+}
+
+static void ase_file_inflate_cels(FileOp* fop, ASE_PendingCels* pending)
+{
+  std::vector<ASE_CompressedCel>& cels = pending->compressed;
+  if (!cels.empty()) {
+    std::vector<std::string> errors(cels.size());
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> done(0);
+    std::atomic<bool> stop(false);
+
+    auto worker = [&](bool mainThread) {
+      size_t i;
+      while ((i = next++) < cels.size()) {
+        ASE_CompressedCel& cel = cels[i];
+        Image* image = cel.image.get();
+
+        // When the user cancels the operation, the rest of the images
+        // are just cleared.
+        if (stop) {
+          image->clear(0);
+          continue;
+        }
+
         try {
           switch (image->pixelFormat()) {
 
             case IMAGE_RGB:
-              read_compressed_image<RgbTraits>(f, image.get(), chunk_end, fop, header);
+              inflate_compressed_image<RgbTraits>(cel.data, cel.size, image);
               break;
 
             case IMAGE_GRAYSCALE:
-              read_compressed_image<GrayscaleTraits>(f, image.get(), chunk_end, fop, header);
+              inflate_compressed_image<GrayscaleTraits>(cel.data, cel.size, image);
               break;
 
             case IMAGE_INDEXED:
-              read_compressed_image<IndexedTraits>(f, image.get(), chunk_end, fop, header);
+              inflate_compressed_image<IndexedTraits>(cel.data, cel.size, image);
               break;
           }
         }
         // OK, in case of error we can show the problem, but continue
         // loading more cels.
         catch (const std::exception& e) {
-          fop->setError(e.what());
+          errors[i] = e.what();
+        }
+        base::buffer().swap(cel.buffer);
+        ++done;
+
+        // FileOp is used from the calling thread only
+        if (mainThread) {
+          fop->setProgress(0.5 + 0.5 * double(done) / double(cels.size()));
+          if (fop->isStop())
+            stop = true;
         }
-
-        cel = std::make_shared<Cel>(frame, image);
-        cel->setPosition(x, y);
-        cel->setOpacity(opacity);
       }
-      break;
-    }
+    };
+
+    const int nthreads = std::min<int>(
+      std::max<int>(std::thread::hardware_concurrency(), 1),
+      int(cels.size())) - 1;
+    std::vector<std::thread> threads;
+    for (int i=0; i<nthreads; ++i)
+      threads.emplace_back(worker, false);
+    worker(true);
+    for (auto& thread : threads)
+      thread.join();
+
+    for (const std::string& error : errors)
+      if (!error.empty())
+        fop->setError(error.c_str());
+  }
+
+  for (auto& copy : pending->copies)
+    copy_image(copy.first.get(), copy.second.get());
+}
 
+static bool ase_file_compress_cels(FileOp* fop, const Sprite* sprite, int level, ASE_CompressedImages* images)
+{
+  // Images saved as ASE_FILE_COMPRESSED_CEL (linked cels reference
+  // the image of the first cel)
+  std::vector<const Image*> list;
+  for (const auto& cel : sprite->cels()) {
+    const Image* image = cel->image();
+    if (image && !cel->link() && images->find(image) == images->end()) {
+      (*images)[image];
+      list.push_back(image);
+    }
   }
+  if (list.empty())
+    return true;
 
-  if (cel)
-    static_cast<LayerImage*>(layer)->addCel(cel);
+  std::vector<base::buffer*> outputs;
+  for (const Image* image : list)
+    outputs.push_back(&(*images)[image]);
+
+  std::exception_ptr error;
+  base::mutex errorMutex;
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> done(0);
+  std::atomic<bool> stop(false);
+
+  auto worker = [&](bool mainThread) {
+    base::buffer scratch;
+    size_t i;
+    while (!stop && (i = next++) < list.size()) {
+      const Image* image = list[i];
+      try {
+        switch (image->pixelFormat()) {
 
-  return cel.get();
+          case IMAGE_RGB:
+            deflate_compressed_image<RgbTraits>(image, level, scratch, *outputs[i]);
+            break;
+
+          case IMAGE_GRAYSCALE:
+            deflate_compressed_image<GrayscaleTraits>(image, level, scratch, *outputs[i]);
+            break;
+
+          case IMAGE_INDEXED:
+            deflate_compressed_image<IndexedTraits>(image, level, scratch, *outputs[i]);
+            break;
+        }
+      }
+      catch (...) {
+        scoped_lock lock(errorMutex);
+        if (!error)
+          error = std::current_exception();
+        stop = true;
+      }
+      ++done;
+
+      // FileOp is used from the calling thread only
+      if (mainThread) {
+        fop->setProgress(0.5 * double(done) / double(list.size()));
+        if (fop->isStop())
+          stop = true;
+      }
+    }
+  };
+
+  const int nthreads = std::min<int>(
+    std::max<int>(std::thread::hardware_concurrency(), 1),
+    int(list.size())) - 1;
+  std::vector<std::thread> threads;
+  for (int i=0; i<nthreads; ++i)
+    threads.emplace_back(worker, false);
+  worker(true);
+  for (auto& thread : threads)
+    thread.join();
+
+  // Errors are reported as if we were writing the file
+  if (error)
+    std::rethrow_exception(error);
+
+  return !stop;
 }
 
 static void ase_file_write_cel_chunk(FILE* f, ASE_FrameHeader* frame_header,
-                                     const Cel* cel, const LayerImage* layer, const Sprite* sprite)
+                                     const Cel* cel, const LayerImage* layer, const Sprite* sprite,
+                                     const ASE_CompressedImages* images)
 {
   ChunkWriter chunk(f, frame_header, ASE_FILE_CHUNK_CEL);
 
@@ -1349,20 +2286,14 @@ static void ase_file_write_cel_chunk(FILE* f, ASE_FrameHeader* frame_header,
         fputw(image->width(), f);
         fputw(image->height(), f);
 
-        // Pixel data
-        switch (image->pixelFormat()) {
-
-          case IMAGE_RGB:
-            write_compressed_image<RgbTraits>(f, image);
-            break;
-
-          case IMAGE_GRAYSCALE:
-            write_compressed_image<GrayscaleTraits>(f, image);
-            break;
-
-          case IMAGE_INDEXED:
-            write_compressed_image<IndexedTraits>(f, image);
-            break;
+        // Pixel data (already compressed by ase_file_compress_cels())
+        auto it = images->find(image);
+        ASSERT(it != images->end());
+        if (it != images->end() && !it->second.empty()) {
+          const base::buffer& data = it->second;
+          if ((fwrite(&data[0], 1, data.size(), f) != data.size())
+              || ferror(f))
+            throw base::Exception("Error writing compressed image pixels.\n");
         }
       }
       else {
@@ -1375,15 +2306,15 @@ static void ase_file_write_cel_chunk(FILE* f, ASE_FrameHeader* frame_header,
   }
 }
 
-static Mask* ase_file_read_mask_chunk(FILE* f)
+static Mask* ase_file_read_mask_chunk(AseReader* f)
 {
   int c, u, v, byte;
   Mask* mask;
   // Read chunk data
-  int x = fgetw(f);
-  int y = fgetw(f);
-  int w = fgetw(f);
-  int h = fgetw(f);
+  int x = f->read16();
+  int y = f->read16();
+  int w = f->read16();
+  int h = f->read16();
 
   ase_file_read_padding(f, 8);
   std::string name = ase_file_read_string(f);
@@ -1395,7 +2326,7 @@ static Mask* ase_file_read_mask_chunk(FILE* f)
   // Read image data
   for (v=0; v<h; v++)
     for (u=0; u<(w+7)/8; u++) {
-      byte = fgetc(f);
+      byte = f->read8();
       for (c=0; c<8; c++)
         put_pixel(mask->bitmap(), u*8+c, v, byte & (1<<(7-c)));
     }
@@ -1432,30 +2363,30 @@ static void ase_file_write_mask_chunk(FILE* f, ASE_FrameHeader* frame_header, Ma
 }
 #endif
 
-static void ase_file_read_frame_tags_chunk(FILE* f, FrameTags* frameTags)
+static void ase_file_read_frame_tags_chunk(AseReader* f, FrameTags* frameTags)
 {
-  size_t tags = fgetw(f);
+  size_t tags = f->read16();
 
-  fgetl(f);                     // 8 reserved bytes
-  fgetl(f);
+  f->read32();                     // 8 reserved bytes
+  f->read32();
 
   for (size_t c=0; c<tags; ++c) {
-    frame_t from = fgetw(f);
-    frame_t to = fgetw(f);
-    int aniDir = fgetc(f);
+    frame_t from = f->read16();
+    frame_t to = f->read16();
+    int aniDir = f->read8();
     if (aniDir != int(AniDir::FORWARD) &&
         aniDir != int(AniDir::REVERSE) &&
         aniDir != int(AniDir::PING_PONG)) {
       aniDir = int(AniDir::FORWARD);
     }
 
-    fgetl(f);                     // 8 reserved bytes
-    fgetl(f);
+    f->read32();                     // 8 reserved bytes
+    f->read32();
 
-    int r = fgetc(f);
-    int g = fgetc(f);
-    int b = fgetc(f);
-    fgetc(f);                     // Skip
+    int r = f->read8();
+    int g = f->read8();
+    int b = f->read8();
+    f->read8();                     // Skip
 
     std::string name = ase_file_read_string(f);
 
@@ -1493,9 +2424,9 @@ static void ase_file_write_frame_tags_chunk(FILE* f, ASE_FrameHeader* frame_head
   }
 }
 
-static void ase_file_read_user_data_chunk(FILE* f, UserData* userData)
+static void ase_file_read_user_data_chunk(AseReader* f, UserData* userData)
 {
-  size_t flags = fgetl(f);
+  size_t flags = f->read32();
 
   if (flags & ASE_USER_DATA_FLAG_HAS_TEXT) {
     std::string text = ase_file_read_string(f);
@@ -1503,10 +2434,10 @@ static void ase_file_read_user_data_chunk(FILE* f, UserData* userData)
   }
 
   if (flags & ASE_USER_DATA_FLAG_HAS_COLOR) {
-    int r = fgetc(f);
-    int g = fgetc(f);
-    int b = fgetc(f);
-    int a = fgetc(f);
+    int r = f->read8();
+    int g = f->read8();
+    int b = f->read8();
+    int a = f->read8();
     userData->setColor(doc::rgba(r, g, b, a));
   }
 }
@@ -53,7 +53,9 @@ class BmpFormat : public FileFormat {
       FILE_SUPPORT_RGB |
       FILE_SUPPORT_GRAY |
       FILE_SUPPORT_INDEXED |
-      FILE_SUPPORT_SEQUENCES;
+      FILE_SUPPORT_SEQUENCES |
+      FILE_SUPPORT_REENTRANT_SAVE |
+      FILE_SUPPORT_REENTRANT_LOAD;
   }
 
   bool onLoad(FileOp* fop) override;
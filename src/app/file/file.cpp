@@ -28,14 +28,22 @@
 #include "base/scoped_lock.h"
 #include "base/shared_ptr.h"
 #include "base/string.h"
+#include "doc/algorithm/link_identical_cels.h"
 #include "doc/doc.h"
 #include "render/quantization.h"
 #include "render/render.h"
 #include "ui/alert.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
 #include <cstdarg>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <string_view>
+#include <thread>
 
 namespace app {
 
@@ -73,6 +81,10 @@ std::string get_writable_extensions()
 Document* load_document(Context* context, const char* filename)
 {
   /* TODO add a option to configure what to do with the sequence */
+  // Identical cels are not linked here (FILE_LOAD_LINK_IDENTICAL_CELS)
+  // because this is used for internal documents (e.g. sprite sheets
+  // of other formats). User documents, including the ones opened
+  // from the CLI, are loaded with the OpenFile command.
   std::unique_ptr<FileOp> fop(FileOp::createLoadDocumentOperation(context, filename, FILE_LOAD_SEQUENCE_NONE));
   if (!fop)
     return nullptr;
@@ -119,6 +131,239 @@ int save_document(Context* context, doc::Document* document)
   return (!fop->hasError() ? 0: -1);
 }
 
+// Returns the format used to create the file name of each frame
+// when a sprite is saved as a sequence of files (the {frame} is
+// included if it isn't in the given format). If it's the default
+// format, the number at the end of "fn" is removed and it's returned
+// in "start_from" as the number of the first frame.
+static std::string get_sequence_filename_format(std::string& fn,
+                                                std::string fn_format,
+                                                bool default_format,
+                                                int& start_from)
+{
+  int width = 0;
+  start_from = 0;
+
+  if (default_format) {
+    std::string left, right;
+    start_from = split_filename(fn.c_str(), left, right, width);
+    if (start_from < 0) {
+      start_from = 1;
+      width = 1;
+    }
+    else {
+      fn = left;
+      fn += right;
+    }
+  }
+
+  std::vector<char> buf(32);
+  std::snprintf(buf.data(), buf.size(), "{frame%0*d}", width, 0);
+  if (default_format)
+    return set_frame_format(fn_format, &buf[0]);
+  else
+    return add_frame_format(fn_format, &buf[0]);
+}
+
+namespace {
+
+// Saves each frame received from a FileOp in its own file, with the
+// same file names that a FileOp to save the whole sprite would use.
+class FrameSequenceWriter : public IFileOpFrameConsumer {
+public:
+  FrameSequenceWriter(Context* context,
+                      const std::string& filename,
+                      const std::string& fn_format)
+    : m_context(context)
+    , m_filename(filename)
+    , m_fnFormat(fn_format)
+    , m_startFrom(0)
+    , m_frames(0)
+    , m_ok(true) {
+  }
+
+  void consumeFileOpFrame(const Sprite* sprite, frame_t frame, const Image* image) override {
+    std::unique_ptr<Document> doc(createFrameDocument(sprite, frame, image));
+
+    // The first frame is saved when we know that the file has more
+    // frames (an image with one frame isn't saved as a sequence).
+    if (m_frames == 0) {
+      m_firstFrame = std::move(doc);
+    }
+    else {
+      if (m_frames == 1) {
+        bool default_format = m_fnFormat.empty();
+        m_seqFilename = m_filename;
+        m_seqFnFormat = get_sequence_filename_format(
+          m_seqFilename,
+          default_format ? "{path}/{title}{frame}.{extension}": m_fnFormat,
+          default_format, m_startFrom);
+
+        saveFrame(m_firstFrame.get(), 0);
+        m_firstFrame.reset();
+      }
+      saveFrame(doc.get(), m_frames);
+    }
+    ++m_frames;
+  }
+
+  // Saves the frame that wasn't saved yet (if the file has just one
+  // frame). Returns false if some frame couldn't be saved.
+  bool finish() {
+    if (m_firstFrame) {
+      std::string fn = m_filename;
+      if (!m_fnFormat.empty()) {
+        FilenameInfo fnInfo;
+        fnInfo.filename(fn);
+        fn = filename_formatter(m_fnFormat, fnInfo);
+      }
+      saveDocument(m_firstFrame.get(), fn);
+      m_firstFrame.reset();
+    }
+    return m_ok;
+  }
+
+private:
+  Document* createFrameDocument(const Sprite* src, frame_t frame, const Image* image) {
+    auto palette = src->palette(frame)->clone();
+
+    // Include the transparent color in the palette (as the GIF
+    // decoder does with the first palette when it loads the whole
+    // sprite)
+    if (palette->frame() == 0 &&
+        src->transparentColor() >= palette->size())
+      palette->resize(src->transparentColor()+1);
+    palette->setFrame(0);
+
+    Sprite* spr = new Sprite(src->pixelFormat(), src->width(), src->height(),
+                             palette->size());
+    spr->setPalette(*palette, true);
+    spr->setTransparentColor(src->transparentColor());
+    spr->setFrameDuration(0, src->frameDuration(frame));
+
+    LayerImage* layer = new LayerImage(spr);
+    spr->folder()->addLayer(layer);
+    layer->addCel(std::make_shared<Cel>(frame_t(0), ImageRef(Image::createCopy(image))));
+    if (src->backgroundLayer())
+      layer->configureAsBackground();
+
+    return new Document(spr);
+  }
+
+  void saveFrame(Document* doc, frame_t frame) {
+    FilenameInfo fnInfo;
+    fnInfo
+      .filename(m_seqFilename)
+      .frame(m_startFrom+frame)
+      .tagFrame(m_startFrom+frame);
+
+    saveDocument(doc, filename_formatter(m_seqFnFormat, fnInfo));
+  }
+
+  void saveDocument(Document* doc, const std::string& fn) {
+    std::unique_ptr<FileOp> fop(
+      FileOp::createSaveDocumentOperation(m_context, doc, fn.c_str(), ""));
+    if (!fop) {
+      m_ok = false;
+      return;
+    }
+
+    fop->operate();
+    fop->done();
+
+    if (fop->hasError()) {
+      Console console(m_context);
+      console.printf(fop->error().c_str());
+      m_ok = false;
+    }
+  }
+
+  Context* m_context;
+  std::string m_filename;
+  std::string m_fnFormat;
+  std::string m_seqFilename;
+  std::string m_seqFnFormat;
+  int m_startFrom;
+  frame_t m_frames;
+  std::unique_ptr<Document> m_firstFrame;
+  bool m_ok;
+};
+
+} // anonymous namespace
+
+bool convert_document_frames(Context* context,
+                             const char* filename,
+                             const char* dstFilename,
+                             const char* dstFilenameFormat)
+{
+  // Formats that support animations need all frames to save the file
+  std::string extension = base::string_to_lower(base::get_file_extension(dstFilename));
+  FileFormat* dstFormat = FileFormatsManager::instance()
+    ->getFileFormatByExtension(extension.c_str());
+  bool sequence = (dstFormat &&
+                   dstFormat->support(FILE_SUPPORT_SEQUENCES) &&
+                   !dstFormat->support(FILE_SUPPORT_FRAMES));
+
+  std::unique_ptr<FileOp> fop(FileOp::createLoadDocumentOperation(context, filename, FILE_LOAD_SEQUENCE_NONE));
+  if (!fop)
+    return false;
+
+  FrameSequenceWriter writer(context, dstFilename, dstFilenameFormat);
+  if (sequence)
+    fop->setFrameConsumer(&writer);
+
+  fop->operate();
+  fop->done();
+
+  // The file cannot be converted frame by frame with the same result
+  // of a normal load (e.g. a GIF with local colormaps), so we load
+  // the whole document (frames already saved are replaced as the
+  // file names are the same).
+  if (fop->isFrameConsumerCanceled()) {
+    fop.reset(FileOp::createLoadDocumentOperation(context, filename, FILE_LOAD_SEQUENCE_NONE));
+    if (!fop)
+      return false;
+
+    fop->operate();
+    fop->done();
+  }
+
+  fop->postLoad();
+
+  if (fop->hasError()) {
+    Console console(context);
+    console.printf(fop->error().c_str());
+  }
+
+  std::unique_ptr<Document> doc(fop->releaseDocument());
+
+  // The format doesn't support loading frame by frame, so we save
+  // the whole loaded document.
+  if (doc) {
+    doc->setContext(context);
+
+    std::unique_ptr<FileOp> saveFop(
+      FileOp::createSaveDocumentOperation(context, doc.get(),
+                                          dstFilename, dstFilenameFormat));
+    if (!saveFop)
+      return false;
+
+    saveFop->operate();
+    saveFop->done();
+
+    if (saveFop->hasError()) {
+      Console console(context);
+      console.printf(saveFop->error().c_str());
+      return false;
+    }
+    return true;
+  }
+  else if (sequence && !fop->hasError())
+    return writer.finish();
+  else
+    return false;
+}
+
 // static
 FileOp* FileOp::createLoadDocumentOperation(Context* context, const char* filename, int flags)
 {
@@ -369,30 +614,11 @@ FileOp* FileOp::createSaveDocumentOperation(const Context* context,
     }
     // Save multiple frames
     else {
-      int width = 0;
       int start_from = 0;
-
-      if (default_format) {
-        std::string left, right;
-        start_from = split_filename(fn.c_str(), left, right, width);
-        if (start_from < 0) {
-          start_from = 1;
-          width = 1;
-        }
-        else {
-          fn = left;
-          fn += right;
-        }
-      }
+      fn_format = get_sequence_filename_format(fn, fn_format, default_format,
+                                               start_from);
 
       Sprite* spr = fop->m_document->sprite();
-      std::vector<char> buf(32);
-      std::snprintf(buf.data(), buf.size(), "{frame%0*d}", width, 0);
-      if (default_format)
-        fn_format = set_frame_format(fn_format, &buf[0]);
-      else if (spr->totalFrames() > 1)
-        fn_format = add_frame_format(fn_format, &buf[0]);
-
       for (frame_t frame(0); frame<spr->totalFrames(); ++frame) {
         FrameTag* innerTag = spr->frameTags().innerTag(frame);
         FrameTag* outerTag = spr->frameTags().outerTag(frame);
@@ -456,85 +682,93 @@ bool FileOp::operateLoadTryFormat(IFileOpProgress* progress)
   // Load the sequence
   frame_t frames(m_seq.filename_list.size());
   frame_t frame(0);
-  Image* old_image = nullptr;
 
-  // TODO set_palette for each frame???
-  auto add_image = [&]() {
-    m_seq.last_cel->data()->setImage(m_seq.image);
-    m_seq.layer->addCel(m_seq.last_cel);
+  // Decode several files at the same time (each one in its own
+  // FileOp) and add them to the sprite in frame order.
+  if (m_format->support(FILE_SUPPORT_REENTRANT_LOAD) && frames > 1) {
+    frame = operateLoadSequenceInParallel();
+  }
+  else {
+    Image* old_image = nullptr;
 
-    if (m_document->sprite()->palette(frame)
-        ->countDiff(*m_seq.palette, NULL, NULL) > 0) {
-      m_seq.palette->setFrame(frame);
-      m_document->sprite()->setPalette(*m_seq.palette, true);
-    }
+    // TODO set_palette for each frame???
+    auto add_image = [&]() {
+      m_seq.last_cel->data()->setImage(m_seq.image);
+      m_seq.layer->addCel(m_seq.last_cel);
 
-    old_image = m_seq.image.get();
-    m_seq.image.reset();
-    m_seq.last_cel = NULL;
-  };
-
-  m_seq.has_alpha = false;
-  m_seq.progress_offset = 0.0f;
-  m_seq.progress_fraction = 1.0f / (double)frames;
-
-  auto it = m_seq.filename_list.begin(),
-    end = m_seq.filename_list.end();
-  for (; it != end; ++it) {
-    m_filename = it->c_str();
-
-    // Call the "load" procedure to read the first bitmap.
-    bool loadres = m_format->load(this);
-    if (!loadres) {
-      setError("Error loading frame %d from file \"%s\"\n", frame+1, m_filename.c_str());
-    }
-
-    // For the first frame...
-    if (!old_image) {
-      // Error reading the first frame
-      if (!loadres || !m_document || !m_seq.last_cel) {
-        m_seq.image.reset();
-        delete m_document;
-        m_document = nullptr;
-        break;
-      }
-      // Read ok
-      else {
-        // Add the keyframe
-        add_image();
+      if (m_document->sprite()->palette(frame)
+          ->countDiff(*m_seq.palette, NULL, NULL) > 0) {
+        m_seq.palette->setFrame(frame);
+        m_document->sprite()->setPalette(*m_seq.palette, true);
       }
-    }
-    // For other frames
-    else {
-      // All done (or maybe not enough memory)
-      if (!loadres || !m_seq.last_cel) {
-        m_seq.image.reset();
-        break;
+
+      old_image = m_seq.image.get();
+      m_seq.image.reset();
+      m_seq.last_cel = NULL;
+    };
+
+    m_seq.has_alpha = false;
+    m_seq.progress_offset = 0.0f;
+    m_seq.progress_fraction = 1.0f / (double)frames;
+
+    auto it = m_seq.filename_list.begin(),
+      end = m_seq.filename_list.end();
+    for (; it != end; ++it) {
+      m_filename = it->c_str();
+
+      // Call the "load" procedure to read the first bitmap.
+      bool loadres = m_format->load(this);
+      if (!loadres) {
+        setError("Error loading frame %d from file \"%s\"\n", frame+1, m_filename.c_str());
       }
 
-      // Compare the old frame with the new one
-#if USE_LINK // TODO this should be configurable through a check-box
-      if (count_diff_between_images(old_image, m_seq.image)) {
-        add_image();
+      // For the first frame...
+      if (!old_image) {
+        // Error reading the first frame
+        if (!loadres || !m_document || !m_seq.last_cel) {
+          m_seq.image.reset();
+          delete m_document;
+          m_document = nullptr;
+          break;
+        }
+        // Read ok
+        else {
+          // Add the keyframe
+          add_image();
+        }
       }
-      // We don't need this image
+      // For other frames
       else {
-        delete m_seq.image;
+        // All done (or maybe not enough memory)
+        if (!loadres || !m_seq.last_cel) {
+          m_seq.image.reset();
+          break;
+        }
 
-        // But add a link frame
-        m_seq.last_cel->image = image_index;
-        layer_add_frame(m_seq.layer, m_seq.last_cel);
+        // Compare the old frame with the new one
+#if USE_LINK // TODO this should be configurable through a check-box
+        if (count_diff_between_images(old_image, m_seq.image)) {
+          add_image();
+        }
+        // We don't need this image
+        else {
+          delete m_seq.image;
 
-        m_seq.last_image = NULL;
-        m_seq.last_cel = NULL;
-      }
+          // But add a link frame
+          m_seq.last_cel->image = image_index;
+          layer_add_frame(m_seq.layer, m_seq.last_cel);
+
+          m_seq.last_image = NULL;
+          m_seq.last_cel = NULL;
+        }
 #else
-      add_image();
+        add_image();
 #endif
-    }
+      }
 
-    ++frame;
-    m_seq.progress_offset += m_seq.progress_fraction;
+      ++frame;
+      m_seq.progress_offset += m_seq.progress_fraction;
+    }
   }
   m_filename = *m_seq.filename_list.begin();
 
@@ -630,7 +864,15 @@ void FileOp::operate(IFileOpProgress* progress)
            m_format != NULL &&
            m_format->support(FILE_SUPPORT_SAVE)) {
     // Save a sequence
-    if (isSequence()) {
+    if (isSequence() &&
+        m_format->support(FILE_SUPPORT_REENTRANT_SAVE) &&
+        m_seq.filename_list.size() > 1) {
+      operateSaveSequenceInParallel();
+
+      m_filename = *m_seq.filename_list.begin();
+      m_document->setFilename(m_filename);
+    }
+    else if (isSequence()) {
       ASSERT(m_format->support(FILE_SUPPORT_SEQUENCES));
 
       Sprite* sprite = m_document->sprite();
@@ -684,6 +926,285 @@ void FileOp::operate(IFileOpProgress* progress)
   setProgress(1.0f);
 }
 
+// Renders and saves the frames of a sequence in several threads. Each
+// thread uses its own FileOp to save the frames (the format accesses
+// the image and palette of the frame through the FileOp), and errors
+// are reported for each file.
+void FileOp::operateSaveSequenceInParallel()
+{
+  const Sprite* sprite = m_document->sprite();
+  const int frames = int(m_seq.filename_list.size());
+  ASSERT(frames == sprite->totalFrames());
+
+  std::vector<std::string> errors(frames);
+  std::atomic<int> next(0);
+  std::atomic<int> done(0);
+  std::atomic<bool> stop(false);
+
+  m_seq.progress_offset = 0.0;
+  m_seq.progress_fraction = 1.0;
+
+  auto worker = [&](bool mainThread) {
+    FileOp fop(FileOpSave, m_context);
+    fop.m_format = m_format;
+    fop.m_document = m_document;
+    fop.prepareForSequence();
+    fop.m_seq.format_options = m_seq.format_options;
+    fop.m_seq.image.reset(Image::create(sprite->pixelFormat(),
+                                        sprite->width(),
+                                        sprite->height()));
+
+    render::Render render;
+    int i;
+    while ((i = next++) < frames && !stop) {
+      frame_t frame(i);
+      fop.m_filename = m_seq.filename_list[i];
+      fop.m_error.clear();
+
+      // Exceptions (e.g. the file cannot be created) cannot leave
+      // this thread, they are reported as errors of this frame.
+      try {
+        render.renderSprite(fop.m_seq.image.get(), sprite, frame);
+        sprite->palette(frame)->copyColorsTo(*fop.m_seq.palette);
+
+        if (!m_format->save(&fop)) {
+          fop.setError("Error saving frame %d in the file \"%s\"\n",
+                       i+1, fop.m_filename.c_str());
+          errors[i] = fop.m_error;
+        }
+      }
+      catch (const std::exception& e) {
+        fop.setError("Error saving frame %d in the file \"%s\":\n%s\n",
+                     i+1, fop.m_filename.c_str(), e.what());
+        errors[i] = fop.m_error;
+        stop = true;
+      }
+      catch (...) {
+        fop.setError("Error saving frame %d in the file \"%s\"\n",
+                     i+1, fop.m_filename.c_str());
+        errors[i] = fop.m_error;
+        stop = true;
+      }
+      ++done;
+
+      // This FileOp is used from the calling thread only
+      if (mainThread) {
+        setProgress(double(done) / double(frames));
+        if (isStop())
+          stop = true;
+      }
+    }
+  };
+
+  const int nthreads = std::min<int>(
+    std::max<int>(std::thread::hardware_concurrency(), 1),
+    frames) - 1;
+  std::vector<std::thread> threads;
+  for (int i=0; i<nthreads; ++i)
+    threads.emplace_back(worker, false);
+
+  // The threads are joined before reporting the errors or rethrowing
+  // an exception from the progress of this thread
+  std::exception_ptr exception;
+  try {
+    worker(true);
+  }
+  catch (...) {
+    exception = std::current_exception();
+    stop = true;
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  if (exception)
+    std::rethrow_exception(exception);
+
+  for (const std::string& error : errors)
+    if (!error.empty())
+      setError("%s", error.c_str());
+}
+
+// Loads each file of the sequence in its own FileOp from worker
+// threads. Just a few files are decoded ahead of the last added frame
+// (so memory usage is bounded), and the cels are added in frame order
+// from this thread. Returns the number of loaded frames.
+frame_t FileOp::operateLoadSequenceInParallel()
+{
+  struct Result {
+    std::unique_ptr<FileOp> fop;
+    bool loadres = false;
+    std::exception_ptr exception;
+    bool ready = false;
+  };
+
+  const int frames = int(m_seq.filename_list.size());
+  const int nthreads = std::min<int>(
+    std::max<int>(std::thread::hardware_concurrency(), 1),
+    frames);
+  const int window = 2*nthreads;
+
+  std::vector<Result> results(frames);
+  std::mutex mutex;
+  std::condition_variable cv;
+  int next = 0;                 // Next file to decode
+  int added = 0;                // Frames added to the sprite
+  bool stop = false;
+
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [&]{
+        return stop || next >= frames || next < added+window;
+      });
+      if (stop || next >= frames)
+        break;
+
+      const int i = next++;
+      lock.unlock();
+
+      std::unique_ptr<FileOp> fop(new FileOp(FileOpLoad, m_context));
+      fop->m_loadFlags = m_loadFlags;
+      fop->m_format = m_format;
+      fop->m_filename = m_seq.filename_list[i];
+      fop->prepareForSequence();
+      fop->m_seq.palette->makeBlack();
+      fop->m_seq.has_alpha = false;
+
+      bool loadres = false;
+      std::exception_ptr exception;
+      try {
+        loadres = m_format->load(fop.get());
+      }
+      catch (...) {
+        exception = std::current_exception();
+      }
+
+      lock.lock();
+      results[i].fop = std::move(fop);
+      results[i].loadres = loadres;
+      results[i].exception = exception;
+      results[i].ready = true;
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i=0; i<nthreads; ++i)
+    threads.emplace_back(worker);
+
+  auto stopWorkers = [&]() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cv.notify_all();
+    for (auto& thread : threads)
+      thread.join();
+    threads.clear();
+
+    // Documents of files that weren't added to the sprite
+    for (Result& result : results)
+      if (result.fop)
+        delete result.fop->releaseDocument();
+  };
+
+  const bool linkCels = (m_loadFlags & FILE_LOAD_LINK_IDENTICAL_CELS) != 0;
+  Cel* prevCel = nullptr;
+  frame_t frame(0);
+
+  m_seq.has_alpha = false;
+  m_seq.progress_offset = 0.0;
+  m_seq.progress_fraction = 1.0;
+
+  try {
+    for (; frame<frames; ++frame) {
+      std::unique_ptr<FileOp> fop;
+      bool loadres;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]{ return results[frame].ready; });
+        fop = std::move(results[frame].fop);
+        loadres = results[frame].loadres;
+        if (results[frame].exception)
+          std::rethrow_exception(results[frame].exception);
+      }
+
+      m_filename = fop->m_filename;
+      if (!fop->m_error.empty())
+        setError("%s", fop->m_error.c_str());
+
+      // The first frame gives us the sprite
+      if (frame == 0) {
+        if (loadres && fop->m_document && fop->m_seq.last_cel) {
+          m_document = fop->releaseDocument();
+          m_seq.layer = fop->m_seq.layer;
+        }
+        else
+          loadres = false;
+      }
+      // Other frames must have the same pixel format
+      else if (!fop->m_seq.last_cel ||
+               fop->m_document->sprite()->pixelFormat() !=
+               m_document->sprite()->pixelFormat()) {
+        loadres = false;
+      }
+
+      if (!loadres) {
+        delete fop->releaseDocument();
+        setError("Error loading frame %d from file \"%s\"\n", frame+1, m_filename.c_str());
+        break;
+      }
+
+      Sprite* sprite = m_document->sprite();
+      std::shared_ptr<Cel> cel;
+      if (linkCels && prevCel &&
+          is_same_image(prevCel->image(), fop->m_seq.image.get()))
+        cel = std::make_shared<Cel>(frame, prevCel->dataRef());
+      else
+        cel = std::make_shared<Cel>(frame, fop->m_seq.image);
+      m_seq.layer->addCel(cel);
+      prevCel = cel.get();
+
+      if (sprite->palette(frame)->countDiff(*fop->m_seq.palette, NULL, NULL) > 0) {
+        fop->m_seq.palette->setFrame(frame);
+        sprite->setPalette(*fop->m_seq.palette, true);
+      }
+
+      if (fop->m_seq.has_alpha)
+        m_seq.has_alpha = true;
+      if (fop->m_seq.format_options)
+        m_seq.format_options = fop->m_seq.format_options;
+
+      delete fop->releaseDocument();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++added;
+      }
+      cv.notify_all();
+
+      setProgress(double(frame+1) / double(frames));
+      if (isStop()) {
+        ++frame;
+        break;
+      }
+    }
+  }
+  catch (...) {
+    stopWorkers();
+    delete m_document;
+    m_document = nullptr;
+    throw;
+  }
+  stopWorkers();
+
+  // Error reading the first frame
+  if (frame == 0 && m_document) {
+    delete m_document;
+    m_document = nullptr;
+  }
+  return frame;
+}
+
 // After mark the 'fop' as 'done' you must to free it calling fop_free().
 void FileOp::done()
 {
@@ -744,9 +1265,29 @@ void FileOp::postLoad()
       sprite->resetPalettes();
       sprite->setPalette(*palette, false);
     }
+
+    // Convert repeated cels (e.g. frames of an idle loop loaded from
+    // a GIF file or a sequence) into linked cels.
+    // (It's not done with lazy cels because it needs all pixels.)
+    if ((m_loadFlags & FILE_LOAD_LINK_IDENTICAL_CELS) && !isLazyCels()) {
+      std::size_t released = doc::algorithm::link_identical_cels(sprite);
+      if (released > 0) {
+        LOG("Linked identical cels in \"%s\" (%.2f MB released)\n",
+            fn.c_str(), double(released) / (1024.0*1024.0));
+
+        if (m_context && m_context->isUIAvailable() && StatusBar::instance())
+          StatusBar::instance()->setStatusText(
+            3000, "Linked identical cels (%.2f MB released)",
+            double(released) / (1024.0*1024.0));
+      }
+    }
   }
 
-  m_document->markAsSaved();
+  // A document with just one frame of the file (e.g. "OpenFile" with
+  // the "frame" param) is not associated to the file, so saving it
+  // asks for a file name instead of replacing the whole animation.
+  if (!isOneFrame())
+    m_document->markAsSaved();
 }
 
 base::SharedPtr<FormatOptions> FileOp::sequenceGetFormatOptions() const
@@ -924,6 +1465,9 @@ FileOp::FileOp(FileOpType type, Context* context)
   , m_done(false)
   , m_stop(false)
   , m_oneframe(false)
+  , m_oneframe_index(0)
+  , m_frameConsumer(nullptr)
+  , m_frameConsumerCanceled(false)
 {
   m_seq.palette = nullptr;
   m_seq.image.reset();
@@ -934,6 +1478,12 @@ FileOp::FileOp(FileOpType type, Context* context)
   m_seq.last_cel = nullptr;
 }
 
+void FileOp::setOneFrame(frame_t frame)
+{
+  m_oneframe = true;
+  m_oneframe_index = frame;
+}
+
 void FileOp::prepareForSequence()
 {
   m_seq.palette = Palette::create(256);
@@ -21,6 +21,8 @@
 #define FILE_LOAD_SEQUENCE_ASK          0x00000002
 #define FILE_LOAD_SEQUENCE_YES          0x00000004
 #define FILE_LOAD_ONE_FRAME             0x00000008
+#define FILE_LOAD_LINK_IDENTICAL_CELS   0x00000010
+#define FILE_LOAD_LAZY_CELS             0x00000020
 
 namespace doc {
   class Document;
@@ -56,6 +58,19 @@ namespace app {
     virtual void ackFileOpProgress(double progress) = 0;
   };
 
+  // Receives the frames of a file that is loaded frame by frame (see
+  // FileOp::setFrameConsumer()).
+  class IFileOpFrameConsumer
+  {
+  public:
+    virtual ~IFileOpFrameConsumer() { }
+    // The sprite contains the properties of the file (size, pixel
+    // format, palette, frame durations, background layer) but not
+    // the cels. The image is the whole composited frame and it's
+    // valid only during this call.
+    virtual void consumeFileOpFrame(const Sprite* sprite, frame_t frame, const Image* image) = 0;
+  };
+
   // Structure to load & save files.
   class FileOp {
   public:
@@ -66,6 +81,25 @@ namespace app {
 
     bool isSequence() const { return !m_seq.filename_list.empty(); }
     bool isOneFrame() const { return m_oneframe; }
+    // Frame loaded with FILE_LOAD_ONE_FRAME (the first one by default)
+    frame_t oneFrame() const { return m_oneframe_index; }
+    void setOneFrame(frame_t frame);
+    // Cels can be created with pending images (loaded on demand, see
+    // doc::CelData::setPendingImage())
+    bool isLazyCels() const { return (m_loadFlags & FILE_LOAD_LAZY_CELS) != 0; }
+    // Formats that can decode frames one by one (GIF) give each frame
+    // to this consumer instead of creating the document, so memory
+    // usage doesn't depend on the number of frames.
+    IFileOpFrameConsumer* frameConsumer() const { return m_frameConsumer; }
+    void setFrameConsumer(IFileOpFrameConsumer* consumer) { m_frameConsumer = consumer; }
+    // Called by the format when the file cannot be given frame by
+    // frame with the same result as loading the whole document (the
+    // load stops and it must be done again without a consumer).
+    void cancelFrameConsumer() {
+      m_frameConsumer = nullptr;
+      m_frameConsumerCanceled = true;
+    }
+    bool isFrameConsumerCanceled() const { return m_frameConsumerCanceled; }
 
     const std::string& filename() const { return m_filename; }
     Context* context() const { return m_context; }
@@ -136,6 +170,9 @@ namespace app {
     bool m_oneframe;            // Load just one frame (in formats
                                 // that support animation like
                                 // GIF/FLI/ASE).
+    frame_t m_oneframe_index;   // Frame to load when m_oneframe is true.
+    IFileOpFrameConsumer* m_frameConsumer;
+    bool m_frameConsumerCanceled;
 
     // Data for sequences.
     struct {
@@ -154,6 +191,8 @@ namespace app {
     } m_seq;
 
     void prepareForSequence();
+    void operateSaveSequenceInParallel();
+    frame_t operateLoadSequenceInParallel();
     void operateLoad(IFileOpProgress* progress);
     bool operateLoadTryFormat(IFileOpProgress* progress);
   };
@@ -168,4 +207,15 @@ namespace app {
   app::Document* load_document(Context* context, const char* filename);
   int save_document(Context* context, doc::Document* document);
 
+  // Saves the given file as "dstFilename" like the "Save Copy As"
+  // command. When the destination is a sequence of files and the
+  // source format can be decoded frame by frame, each frame is saved
+  // as soon as it's loaded (so we don't keep the whole sprite in
+  // memory). The result is always the same as loading and saving the
+  // whole document.
+  bool convert_document_frames(Context* context,
+                               const char* filename,
+                               const char* dstFilename,
+                               const char* dstFilenameFormat);
+
 } // namespace app
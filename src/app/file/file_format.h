@@ -27,6 +27,8 @@
 #define FILE_SUPPORT_FRAME_TAGS         0x00001000
 #define FILE_SUPPORT_BIG_PALETTES       0x00002000 // Palettes w/more than 256 colors
 #define FILE_SUPPORT_PALETTE_WITH_ALPHA 0x00004000
+#define FILE_SUPPORT_REENTRANT_SAVE     0x00008000 // onSave() can be called from several threads
+#define FILE_SUPPORT_REENTRANT_LOAD     0x00010000 // onLoad() can be called from several threads
 
 namespace app {
 
@@ -12,14 +12,31 @@
 #include "app/document.h"
 #include "app/file/file.h"
 #include "app/file/file_formats_manager.h"
+#include "base/fs.h"
 #include "doc/doc.h"
 
 #include <cstdio>
 #include <cstdlib>
+#include <memory>
+#include <string>
 #include <vector>
 
 using namespace app;
 
+static app::Document* load_document_with_lazy_cels(app::Context* ctx, const char* fn)
+{
+  std::unique_ptr<FileOp> fop(
+    FileOp::createLoadDocumentOperation(
+      ctx, fn, FILE_LOAD_SEQUENCE_NONE | FILE_LOAD_LAZY_CELS));
+  if (!fop)
+    return nullptr;
+
+  fop->operate();
+  fop->done();
+  fop->postLoad();
+  return fop->releaseDocument();
+}
+
 TEST(File, SeveralSizes)
 {
   // Register all possible image formats.
@@ -80,3 +97,209 @@ TEST(File, SeveralSizes)
     }
   }
 }
+
+TEST(File, LazyCelsWhenTheFileIsOverwritten)
+{
+  app::Context ctx;
+  const char* fn = "test_lazy.ase";
+  const color_t red = rgba(255, 0, 0, 255);
+  const color_t blue = rgba(0, 0, 255, 255);
+
+  {
+    doc::Document* doc = ctx.documents().add(32, 32, doc::ColorMode::RGB, 256);
+    doc->setFilename(fn);
+    Layer* layer = doc->sprite()->folder()->getFirstLayer();
+    clear_image(layer->cel(frame_t(0))->image(), red);
+    ASSERT_EQ(0, save_document(&ctx, doc));
+    doc->close();
+    delete doc;
+  }
+
+  app::Document* doc1 = load_document_with_lazy_cels(&ctx, fn);
+  app::Document* doc2 = load_document_with_lazy_cels(&ctx, fn);
+  ASSERT_TRUE(doc1 != nullptr);
+  ASSERT_TRUE(doc2 != nullptr);
+
+  auto cel2 = doc2->sprite()->folder()->getFirstLayer()->cel(frame_t(0));
+  EXPECT_TRUE(cel2->data()->hasPendingImage());
+
+  // Overwrite the file with other pixels
+  auto cel1 = doc1->sprite()->folder()->getFirstLayer()->cel(frame_t(0));
+  clear_image(cel1->image(), blue);
+  ASSERT_EQ(0, save_document(&ctx, doc1));
+
+  // The temporary file used to replace the old one was renamed
+  for (const std::string& file : base::list_files("."))
+    EXPECT_EQ(std::string::npos, file.find("test_lazy.ase.")) << file;
+
+  // The pending cel of the other document has the original pixels
+  EXPECT_TRUE(cel2->data()->hasPendingImage());
+  EXPECT_EQ(red, get_pixel(cel2->image(), 0, 0));
+  EXPECT_EQ(red, get_pixel(cel2->image(), 31, 31));
+
+  app::Document* doc3 = load_document(&ctx, fn);
+  ASSERT_TRUE(doc3 != nullptr);
+  EXPECT_EQ(blue, get_pixel(
+              doc3->sprite()->folder()->getFirstLayer()->cel(frame_t(0))->image(), 0, 0));
+
+  for (app::Document* doc : { doc1, doc2, doc3 }) {
+    doc->close();
+    delete doc;
+  }
+}
+
+TEST(File, LoadOneFrame)
+{
+  app::Context ctx;
+  const char* fn = "test_one_frame.ase";
+  const color_t colors[] = { rgba(255, 0, 0, 255),
+                             rgba(0, 255, 0, 255),
+                             rgba(0, 0, 255, 255) };
+
+  {
+    doc::Document* doc = ctx.documents().add(8, 8, doc::ColorMode::RGB, 256);
+    doc->setFilename(fn);
+    Sprite* sprite = doc->sprite();
+    LayerImage* layer = static_cast<LayerImage*>(sprite->folder()->getFirstLayer());
+    sprite->setTotalFrames(frame_t(3));
+    for (frame_t frame(0); frame<3; ++frame) {
+      if (frame > 0) {
+        ImageRef image(Image::create(IMAGE_RGB, 8, 8));
+        layer->addCel(std::make_shared<Cel>(frame, image));
+      }
+      clear_image(layer->cel(frame)->image(), colors[frame]);
+      sprite->setFrameDuration(frame, 100*(frame+1));
+    }
+    ASSERT_EQ(0, save_document(&ctx, doc));
+    doc->close();
+    delete doc;
+  }
+
+  std::unique_ptr<FileOp> fop(
+    FileOp::createLoadDocumentOperation(&ctx, fn, FILE_LOAD_SEQUENCE_NONE));
+  ASSERT_TRUE(fop != nullptr);
+  fop->setOneFrame(frame_t(1));
+  fop->operate();
+  fop->done();
+  fop->postLoad();
+  app::Document* doc = fop->releaseDocument();
+  ASSERT_TRUE(doc != nullptr);
+
+  // Just the given frame as the first one
+  Sprite* sprite = doc->sprite();
+  EXPECT_EQ(frame_t(1), sprite->totalFrames());
+  EXPECT_EQ(200, sprite->frameDuration(frame_t(0)));
+  auto cel = sprite->folder()->getFirstLayer()->cel(frame_t(0));
+  ASSERT_TRUE(cel != nullptr);
+  EXPECT_EQ(colors[1], get_pixel(cel->image(), 0, 0));
+
+  // Saving it cannot replace the whole animation
+  EXPECT_FALSE(doc->isAssociatedToFile());
+
+  doc->close();
+  delete doc;
+}
+
+static void make_gif(app::Context* ctx, const char* fn, doc::ColorMode colorMode)
+{
+  doc::Document* doc = ctx->documents().add(16, 16, colorMode, 256);
+  doc->setFilename(fn);
+  Sprite* sprite = doc->sprite();
+  LayerImage* layer = static_cast<LayerImage*>(sprite->folder()->getFirstLayer());
+  sprite->setTotalFrames(frame_t(3));
+  for (frame_t frame(0); frame<3; ++frame) {
+    if (frame > 0) {
+      ImageRef image(Image::create(sprite->pixelFormat(), 16, 16));
+      layer->addCel(std::make_shared<Cel>(frame, image));
+    }
+    Image* image = layer->cel(frame)->image();
+    std::srand(frame+1);
+    for (int y=0; y<16; ++y)
+      for (int x=0; x<16; ++x)
+        put_pixel(image, x, y,
+                  sprite->pixelFormat() == IMAGE_INDEXED ?
+                  std::rand()%256: rgba(std::rand()%256, std::rand()%256, std::rand()%256, 255));
+  }
+  ASSERT_EQ(0, save_document(ctx, doc));
+  doc->close();
+  delete doc;
+}
+
+static void expect_same_file(app::Context* ctx, const char* fn1, const char* fn2)
+{
+  app::Document* doc1 = load_document(ctx, fn1);
+  app::Document* doc2 = load_document(ctx, fn2);
+  ASSERT_TRUE(doc1 != nullptr);
+  ASSERT_TRUE(doc2 != nullptr);
+
+  Sprite* spr1 = doc1->sprite();
+  Sprite* spr2 = doc2->sprite();
+  EXPECT_EQ(spr1->pixelFormat(), spr2->pixelFormat());
+  EXPECT_EQ(spr1->transparentColor(), spr2->transparentColor());
+  EXPECT_EQ(0, spr1->palette(0)->countDiff(*spr2->palette(0), nullptr, nullptr));
+
+  Image* img1 = spr1->folder()->getFirstLayer()->cel(frame_t(0))->image();
+  Image* img2 = spr2->folder()->getFirstLayer()->cel(frame_t(0))->image();
+  for (int y=0; y<img1->height(); ++y)
+    for (int x=0; x<img1->width(); ++x)
+      ASSERT_EQ(get_pixel(img1, x, y), get_pixel(img2, x, y));
+
+  doc1->close();
+  doc2->close();
+  delete doc1;
+  delete doc2;
+}
+
+// Converting a GIF frame by frame gives the same files as loading
+// and saving the whole document (GIF files with local colormaps are
+// loaded as a whole).
+TEST(File, ConvertDocumentFrames)
+{
+  app::Context ctx;
+
+  for (doc::ColorMode colorMode : { doc::ColorMode::INDEXED,
+                                    doc::ColorMode::RGB }) {
+    make_gif(&ctx, "test_convert.gif", colorMode);
+
+    ASSERT_TRUE(convert_document_frames(&ctx, "test_convert.gif",
+                                        "test_streamed.png", ""));
+
+    app::Document* doc = load_document(&ctx, "test_convert.gif");
+    ASSERT_TRUE(doc != nullptr);
+    std::unique_ptr<FileOp> fop(
+      FileOp::createSaveDocumentOperation(&ctx, doc, "test_loaded.png", ""));
+    ASSERT_TRUE(fop != nullptr);
+    fop->operate();
+    fop->done();
+    EXPECT_FALSE(fop->hasError());
+    doc->close();
+    delete doc;
+
+    for (int frame=1; frame<=3; ++frame) {
+      std::string streamed = "test_streamed" + std::to_string(frame) + ".png";
+      std::string loaded = "test_loaded" + std::to_string(frame) + ".png";
+      expect_same_file(&ctx, streamed.c_str(), loaded.c_str());
+    }
+  }
+}
+
+// Errors saving a sequence from several threads (e.g. the files
+// cannot be created) are reported as errors of the FileOp.
+TEST(File, SaveSequenceInNonWritablePath)
+{
+  app::Context ctx;
+  doc::Document* doc = ctx.documents().add(8, 8, doc::ColorMode::RGB, 256);
+  doc->sprite()->setTotalFrames(frame_t(8));
+
+  std::unique_ptr<FileOp> fop(
+    FileOp::createSaveDocumentOperation(
+      &ctx, static_cast<app::Document*>(doc),
+      "test_dir_that_does_not_exist/frame.png", ""));
+  ASSERT_TRUE(fop != nullptr);
+  fop->operate();
+  fop->done();
+  EXPECT_TRUE(fop->hasError());
+
+  doc->close();
+  delete doc;
+}
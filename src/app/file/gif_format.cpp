@@ -30,7 +30,17 @@
 #include "gif_options.xml.h"
 
 #include <gif_lib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #ifdef _WIN32
   #include <io.h>
@@ -210,7 +220,7 @@ public:
       if (m_fop->isOneFrame() && m_frameNum > 0)
         break;
 
-      if (m_fop->isStop())
+      if (m_fop->isStop() || m_fop->isFrameConsumerCanceled())
         break;
 
       if (m_filesize > 0) {
@@ -220,6 +230,11 @@ public:
     }
 
     if (m_sprite) {
+      // All frames were given to the consumer (or the file must be
+      // loaded again without it)
+      if (m_fop->frameConsumer() || m_fop->isFrameConsumerCanceled())
+        return true;
+
       // Add entries to include the transparent color
       if (m_bgIndex >= m_sprite->palette(0)->size())
         m_sprite->palette(0)->resize(m_bgIndex+1);
@@ -334,8 +349,26 @@ private:
       compositeIndexedImageToRgb(frameBounds, frameImage.get());
     }
 
-    // Create cel
-    createCel();
+    // Set frame delay (1/100th seconds to milliseconds)
+    if (m_frameDelay >= 0)
+      m_sprite->setFrameDuration(m_frameNum, m_frameDelay*10);
+
+    if (m_fop->frameConsumer() && !canStreamFrame()) {
+      m_fop->cancelFrameConsumer();
+      return;
+    }
+
+    // Create cel, or give the frame to the consumer (in this case
+    // the sprite doesn't contain cels).
+    if (IFileOpFrameConsumer* consumer = m_fop->frameConsumer()) {
+      if (m_frameNum == 0 && m_opaque)
+        m_layer->configureAsBackground();
+
+      consumer->consumeFileOpFrame(m_sprite.get(), m_frameNum,
+                                   m_currentImage.get());
+    }
+    else
+      createCel();
 
     // Dispose/clear frame content
     process_disposal_method(m_previousImage.get(),
@@ -347,10 +380,6 @@ private:
     // Copy the current image into previous image
     copy_image(m_previousImage.get(), m_currentImage.get());
 
-    // Set frame delay (1/100th seconds to milliseconds)
-    if (m_frameDelay >= 0)
-      m_sprite->setFrameDuration(m_frameNum, m_frameDelay*10);
-
     // Reset extension variables
     m_disposalMethod = DisposalMethod::NONE;
     m_localTransparentIndex = -1;
@@ -360,6 +389,18 @@ private:
     ++m_frameNum;
   }
 
+  // Returns true if the frame given to the consumer is the same as
+  // the cel of the whole loaded sprite: decode() doesn't change the
+  // palette or pixels at the end (remapToGlobalColormap() is the
+  // identity and reduceToAnOptimizedPalette() is not used) if all
+  // frames use the global colormap and the sprite is never converted
+  // to RGB.
+  bool canStreamFrame() const {
+    return (m_gifFile->SColorMap &&
+            !m_gifFile->Image.ColorMap &&
+            m_sprite->pixelFormat() == IMAGE_INDEXED);
+  }
+
   Image* readFrameIndexedImage(const gfx::Rect& frameBounds) {
     std::unique_ptr<Image> frameImage(
       Image::create(IMAGE_INDEXED, frameBounds.w, frameBounds.h));
@@ -788,14 +829,101 @@ bool GifFormat::onLoad(FileOp* fop)
 
   GifDecoder decoder(fop, gif_file, fd, filesize);
   if (decoder.decode()) {
-    fop->createDocument(decoder.releaseSprite());
+    if (!fop->frameConsumer() && !fop->isFrameConsumerCanceled())
+      fop->createDocument(decoder.releaseSprite());
     return true;
   }
   else
     return false;
 }
 
+// Threads used by GifEncoder to render and quantize frames in
+// background. Tasks are executed in the same order they are added.
+class GifEncoderWorkers {
+public:
+  GifEncoderWorkers(int nthreads) : m_stop(false) {
+    for (int i=0; i<nthreads; ++i)
+      m_threads.emplace_back([this]{ run(); });
+  }
+
+  // Pending tasks are discarded (e.g. if the encoder throws an
+  // exception), running tasks are finished.
+  ~GifEncoderWorkers() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads)
+      thread.join();
+  }
+
+  template<typename T>
+  std::future<T> add(std::function<T()>&& func) {
+    auto task = std::make_shared<std::packaged_task<T()>>(std::move(func));
+    std::future<T> future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.push_back([task]{ (*task)(); });
+    }
+    m_cv.notify_one();
+    return future;
+  }
+
+private:
+  void run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this]{ return m_stop || !m_tasks.empty(); });
+        if (m_stop)
+          return;
+        task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::vector<std::thread> m_threads;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_stop;
+};
+
+struct GifColorMapDeleter {
+  void operator()(ColorMapObject* colormap) const {
+    GifFreeMapObject(colormap);
+  }
+};
+
+// A frame ready to be written in the GIF file (see
+// GifEncoder::encodeFrame()).
+struct GifEncodedFrame {
+  gfx::Rect bounds;
+  DisposalMethod disposal;
+  int transparentIndex;
+  // Local colormap, or nullptr to use the global one
+  std::unique_ptr<ColorMapObject, GifColorMapDeleter> colormap;
+  // Final indexes of each pixel, scanline by scanline
+  std::vector<uint8_t> pixels;
+};
+
 class GifEncoder {
+  typedef GifEncodedFrame EncodedFrame;
+
+  // RgbMap for a copy of a frame palette (see acquireRgbMap())
+  struct CachedRgbMap {
+    std::shared_ptr<Palette> palette;
+    int maskIndex;
+    std::unique_ptr<RgbMap> rgbmap;
+  };
+
+  // Maximum number of RgbMaps (of 512KB each) kept for next frames
+  static const std::size_t kMaxCachedRgbMaps = 8;
+
 public:
   GifEncoder(FileOp* fop, GifFileType* gifFile)
     : m_fop(fop)
@@ -872,23 +1000,66 @@ public:
     if (m_loop >= 0)
       writeLoopExtension();
 
+    // Frames are rendered and quantized in worker threads, some
+    // frames ahead of the frame that is being written. The disposal
+    // method of each frame (which depends on the previous disposed
+    // frame) and the LZW encoding are done here in order.
+    const int nframes = m_sprite->totalFrames();
+    const int nthreads = MID(1, int(std::thread::hardware_concurrency()), nframes);
+    const int lookahead = 2*nthreads;
+
+    std::vector<std::future<ImageRef>> renderedFrames(nframes);
+    std::vector<std::future<EncodedFrame>> encodedFrames(nframes);
+    int nextRender = 0;
+    int nextWrite = 0;
+
+    GifEncoderWorkers workers(nthreads);
+
     // Previous and next images are used to decide the best disposal
     // method (e.g. if it's more convenient to restore the background
     // color or to restore the previous frame to reach the next one).
-    m_previousImage = m_images[0].get();
-    m_currentImage = m_images[1].get();
-    m_nextImage = m_images[2].get();
+    ImageRef previousImage = m_images[0];
+    ImageRef currentImage = m_images[1];
+    ImageRef nextImage = m_images[2];
 
-    int nframes = m_sprite->totalFrames();
     for (int frameNum=0; frameNum<nframes; ++frameNum) {
+      // Write frames that are already encoded, waiting them if there
+      // are too many frames in memory
+      for (; nextWrite < frameNum; ++nextWrite) {
+        if (frameNum - nextWrite < lookahead &&
+            encodedFrames[nextWrite].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+          break;
+        writeFrame(nextWrite, encodedFrames[nextWrite].get());
+        m_fop->setProgress(double(nextWrite+1) / double(nframes));
+      }
+
+      for (; nextRender < std::min(nextWrite + lookahead + 2, nframes); ++nextRender) {
+        const int n = nextRender;
+        renderedFrames[n] = workers.add<ImageRef>(
+          [this, n]{
+            ImageRef image(Image::create(IMAGE_RGB,
+                                         m_spriteBounds.w,
+                                         m_spriteBounds.h));
+            renderFrame(n, image.get());
+            return image;
+          });
+      }
+
+      // The images are rotated like they were rendered in the same
+      // three buffers (the last frame compares with a stale "next"
+      // image, we keep that to generate the same output).
       if (frameNum == 0)
-        renderFrame(0, m_nextImage);
+        nextImage = renderedFrames[0].get();
       else if (frameNum > 0)
-        std::swap(m_previousImage, m_currentImage);
+        std::swap(previousImage, currentImage);
 
-      std::swap(m_currentImage, m_nextImage);
+      std::swap(currentImage, nextImage);
       if (frameNum+1 < nframes)
-        renderFrame(frameNum+1, m_nextImage);
+        nextImage = renderedFrames[frameNum+1].get();
+
+      m_previousImage = previousImage.get();
+      m_currentImage = currentImage.get();
+      m_nextImage = nextImage.get();
 
       gfx::Rect frameBounds;
       DisposalMethod disposal;
@@ -899,7 +1070,16 @@ public:
       if (frameBounds.isEmpty())
         frameBounds = gfx::Rect(0, 0, 1, 1);
 
-      writeImage(frameNum, frameBounds, disposal);
+      // Copy the pixels of the frame before disposing it
+      ImageRef frameImage(Image::create(IMAGE_RGB,
+                                        frameBounds.w,
+                                        frameBounds.h));
+      frameImage->copy(m_currentImage, gfx::Clip(0, 0, frameBounds));
+
+      encodedFrames[frameNum] = workers.add<EncodedFrame>(
+        [this, frameNum, frameImage, frameBounds, disposal]{
+          return encodeFrame(frameNum, frameImage.get(), frameBounds, disposal);
+        });
 
       // Dispose/clear frame content
       process_disposal_method(m_previousImage,
@@ -907,8 +1087,11 @@ public:
                               disposal,
                               frameBounds,
                               m_clearColor);
+    }
 
-      m_fop->setProgress(double(frameNum+1) / double(nframes));
+    for (; nextWrite < nframes; ++nextWrite) {
+      writeFrame(nextWrite, encodedFrames[nextWrite].get());
+      m_fop->setProgress(double(nextWrite+1) / double(nframes));
     }
     return true;
   }
@@ -1035,34 +1218,38 @@ private:
     }
   }
 
-  void writeImage(int frameNum, const gfx::Rect& frameBounds, DisposalMethod disposal) {
+  // Converts the RGB pixels of a frame (the frameBounds area of the
+  // rendered frame) to the indexes and colormap that will be stored
+  // in the GIF file. It's called from worker threads.
+  EncodedFrame encodeFrame(int frameNum, const Image* image,
+                           const gfx::Rect& frameBounds,
+                           DisposalMethod disposal) const {
+    EncodedFrame encoded;
+    encoded.bounds = frameBounds;
+    encoded.disposal = disposal;
+
     std::shared_ptr<Palette> framePaletteRef;
-    std::unique_ptr<RgbMap> rgbmapRef;
     Palette* framePalette = m_sprite->palette(frameNum);
-    RgbMap* rgbmap = m_sprite->rgbMap(frameNum);
 
     // Create optimized palette for RGB/Grayscale images
     if (m_quantizeColormaps) {
-      framePaletteRef = createOptimizedPalette(frameBounds);
+      framePaletteRef = createOptimizedPalette(image);
       framePalette = framePaletteRef.get();
-
-      rgbmapRef.reset(new RgbMap);
-      rgbmap = rgbmapRef.get();
-      rgbmap->regenerate(framePalette, m_transparentIndex);
     }
 
+    // For indexed images m_transparentIndex is the same mask index
+    // used by Sprite::rgbMap().
+    CachedRgbMap cached = acquireRgbMap(framePalette, m_transparentIndex);
+    const RgbMap& rgbmap = *cached.rgbmap;
+
     // We will store the frameBounds pixels in frameImage, with the
     // indexes that must be stored in the GIF file for this specific
     // frame.
-    if (!m_frameImageBuf)
-      m_frameImageBuf.reset(new ImageBuffer);
-
     ImageRef frameImage(Image::create(IMAGE_INDEXED,
                                       frameBounds.w,
-                                      frameBounds.h,
-                                      m_frameImageBuf));
+                                      frameBounds.h));
 
-    // Convert the frameBounds area of m_currentImage (RGB) to frameImage (Indexed)
+    // Convert the pixels of the frame (RGB) to frameImage (Indexed)
     // bool needsTransparent = false;
     PalettePicks usedColors(framePalette->size());
 
@@ -1078,7 +1265,7 @@ private:
     }
 
     {
-      LockImageBits<RgbTraits> bits(m_currentImage, frameBounds);
+      const LockImageBits<RgbTraits> bits(image);
       auto it = bits.begin();
       for (int y=0; y<frameBounds.h; ++y) {
         for (int x=0; x<frameBounds.w; ++x, ++it) {
@@ -1088,17 +1275,16 @@ private:
           int i;
 
           if (rgba_geta(color) >= 128) {
-            i = framePalette->findExactMatch(
+            i = rgbmap.findExactMatch(
               rgba_getr(color),
               rgba_getg(color),
               rgba_getb(color),
-              255,
-              m_transparentIndex);
+              255);
             if (i < 0)
-              i = rgbmap->mapColor(rgba_getr(color),
-                                   rgba_getg(color),
-                                   rgba_getb(color),
-                                   255);
+              i = rgbmap.mapColor(rgba_getr(color),
+                                  rgba_getg(color),
+                                  rgba_getb(color),
+                                  255);
           }
           else {
             ASSERT(m_transparentIndex >= 0);
@@ -1121,6 +1307,7 @@ private:
         }
       }
     }
+    releaseRgbMap(std::move(cached));
 
     int usedNColors = usedColors.picks();
 
@@ -1129,8 +1316,7 @@ private:
       remap.map(i, i);
 
     int localTransparent = m_transparentIndex;
-    ColorMapObject* colormap = m_globalColormap;
-    if (!colormap) {
+    if (!m_globalColormap) {
       auto reducedPalette = Palette::create(usedNColors);
       reducedPalette->setFrame(frameNum);
 
@@ -1142,7 +1328,7 @@ private:
         }
       }
 
-      colormap = createColorMap(*reducedPalette);
+      encoded.colormap.reset(createColorMap(*reducedPalette));
       if (localTransparent >= 0)
         localTransparent = remap[localTransparent];
     }
@@ -1150,58 +1336,94 @@ private:
     if (localTransparent >= 0 && m_transparentIndex != localTransparent)
       remap.map(m_transparentIndex, localTransparent);
 
+    encoded.transparentIndex = localTransparent;
+
+    // Final indexes of each scanline
+    encoded.pixels.resize(frameBounds.w*frameBounds.h);
+    auto dst = encoded.pixels.begin();
+    for (int y=0; y<frameBounds.h; ++y) {
+      IndexedTraits::address_t addr =
+        (IndexedTraits::address_t)frameImage->getPixelAddress(0, y);
+
+      for (int x=0; x<frameBounds.w; ++x, ++addr, ++dst)
+        *dst = remap[*addr];
+    }
+
+    return encoded;
+  }
+
+  void writeFrame(int frameNum, const EncodedFrame& encoded) {
+    const gfx::Rect& frameBounds = encoded.bounds;
+
     // Write extension record.
-    writeExtension(frameNum, localTransparent, disposal);
+    writeExtension(frameNum, encoded.transparentIndex, encoded.disposal);
 
     // Write the image record.
     if (EGifPutImageDesc(m_gifFile,
                          frameBounds.x, frameBounds.y,
                          frameBounds.w, frameBounds.h,
                          m_interlaced ? 1: 0,
-                         (colormap != m_globalColormap ? colormap: nullptr)) == GIF_ERROR) {
+                         encoded.colormap.get()) == GIF_ERROR) {
       throw Exception("Error writing GIF frame %d.\n", (int)frameNum);
     }
 
-    std::vector<uint8_t> scanline(frameBounds.w);
-
     // Write the image data (pixels).
     if (m_interlaced) {
       // Need to perform 4 passes on the images.
       for (int i=0; i<4; ++i)
         for (int y=interlaced_offset[i]; y<frameBounds.h; y+=interlaced_jumps[i]) {
-          IndexedTraits::address_t addr =
-            (IndexedTraits::address_t)frameImage->getPixelAddress(0, y);
-
-          for (int i=0; i<frameBounds.w; ++i, ++addr)
-            scanline[i] = remap[*addr];
-
-          if (EGifPutLine(m_gifFile, &scanline[0], frameBounds.w) == GIF_ERROR)
+          GifPixelType* scanline = (GifPixelType*)&encoded.pixels[y*frameBounds.w];
+          if (EGifPutLine(m_gifFile, scanline, frameBounds.w) == GIF_ERROR)
             throw Exception("Error writing GIF image scanlines for frame %d.\n", (int)frameNum);
         }
     }
     else {
       // Write all image scanlines (not interlaced in this case).
       for (int y=0; y<frameBounds.h; ++y) {
-        IndexedTraits::address_t addr =
-          (IndexedTraits::address_t)frameImage->getPixelAddress(0, y);
-
-        for (int i=0; i<frameBounds.w; ++i, ++addr)
-          scanline[i] = remap[*addr];
-
-        if (EGifPutLine(m_gifFile, &scanline[0], frameBounds.w) == GIF_ERROR)
+        GifPixelType* scanline = (GifPixelType*)&encoded.pixels[y*frameBounds.w];
+        if (EGifPutLine(m_gifFile, scanline, frameBounds.w) == GIF_ERROR)
           throw Exception("Error writing GIF image scanlines for frame %d.\n", (int)frameNum);
       }
     }
+  }
+
+  // Returns a RgbMap for the given palette, reusing the map of a
+  // previous frame with the same palette (e.g. consecutive frames
+  // with the same colors) to avoid calculating its entries again.
+  // Each thread needs its own RgbMap (entries are calculated on
+  // demand), so the map must be given back with releaseRgbMap().
+  CachedRgbMap acquireRgbMap(const Palette* palette, int maskIndex) const {
+    {
+      std::lock_guard<std::mutex> lock(m_rgbmapsMutex);
+      for (auto it=m_rgbmaps.begin(); it!=m_rgbmaps.end(); ++it) {
+        if (it->maskIndex == maskIndex && *it->palette == *palette) {
+          CachedRgbMap cached = std::move(*it);
+          m_rgbmaps.erase(it);
+          return cached;
+        }
+      }
+    }
 
-    if (colormap && colormap != m_globalColormap)
-      GifFreeMapObject(colormap);
+    CachedRgbMap cached;
+    cached.palette = palette->clone();
+    cached.maskIndex = maskIndex;
+    cached.rgbmap.reset(new RgbMap);
+    cached.rgbmap->regenerate(cached.palette.get(), maskIndex);
+    return cached;
   }
 
-  std::shared_ptr<Palette> createOptimizedPalette(const gfx::Rect& frameBounds) {
+  void releaseRgbMap(CachedRgbMap&& cached) const {
+    std::lock_guard<std::mutex> lock(m_rgbmapsMutex);
+    m_rgbmaps.push_front(std::move(cached));
+    if (m_rgbmaps.size() > kMaxCachedRgbMaps)
+      m_rgbmaps.pop_back();
+  }
+
+  std::shared_ptr<Palette> createOptimizedPalette(const Image* image) const {
     render::PaletteOptimizer optimizer;
 
-    // Feed the palette optimizer with pixels inside frameBounds
-    for (const auto& color : LockImageBits<RgbTraits>(m_currentImage, frameBounds)) {
+    // Feed the palette optimizer with pixels of the frame
+    for (const auto& color : LockImageBits<RgbTraits>(image)) {
       if (rgba_geta(color) >= 128)
         optimizer.feedWithRgbaColor(
           rgba(rgba_getr(color),
@@ -1214,7 +1436,7 @@ private:
     return palette;
   }
 
-  void renderFrame(int frameNum, Image* dst) {
+  void renderFrame(int frameNum, Image* dst) const {
     render::Render render;
     render.setBgType(render::BgType::NONE);
     clear_image(dst, m_clearColor);
@@ -1255,11 +1477,12 @@ private:
   bool m_quantizeColormaps;
   bool m_interlaced;
   int m_loop;
-  ImageBufferPtr m_frameImageBuf;
   ImageRef m_images[3];
   Image* m_previousImage;
   Image* m_currentImage;
   Image* m_nextImage;
+  mutable std::deque<CachedRgbMap> m_rgbmaps;
+  mutable std::mutex m_rgbmapsMutex;
 };
 
 bool GifFormat::onSave(FileOp* fop)
@@ -41,7 +41,9 @@ class PngFormat : public FileFormat {
       FILE_SUPPORT_GRAYA |
       FILE_SUPPORT_INDEXED |
       FILE_SUPPORT_SEQUENCES |
-      FILE_SUPPORT_PALETTE_WITH_ALPHA;
+      FILE_SUPPORT_PALETTE_WITH_ALPHA |
+      FILE_SUPPORT_REENTRANT_SAVE |
+      FILE_SUPPORT_REENTRANT_LOAD;
   }
 
   bool onLoad(FileOp* fop) override;
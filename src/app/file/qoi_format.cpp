@@ -38,7 +38,9 @@ class QoiFormat : public FileFormat {
       FILE_SUPPORT_RGB |
       FILE_SUPPORT_RGBA |
       FILE_SUPPORT_SEQUENCES |
-      FILE_SUPPORT_PALETTE_WITH_ALPHA;
+      FILE_SUPPORT_PALETTE_WITH_ALPHA |
+      FILE_SUPPORT_REENTRANT_SAVE |
+      FILE_SUPPORT_REENTRANT_LOAD;
   }
 
   bool onLoad(FileOp* fop) override;
@@ -34,7 +34,9 @@ class TgaFormat : public FileFormat {
       FILE_SUPPORT_RGBA |
       FILE_SUPPORT_GRAY |
       FILE_SUPPORT_INDEXED |
-      FILE_SUPPORT_SEQUENCES;
+      FILE_SUPPORT_SEQUENCES |
+      FILE_SUPPORT_REENTRANT_SAVE |
+      FILE_SUPPORT_REENTRANT_LOAD;
   }
 
   bool onLoad(FileOp* fop) override;
@@ -6,6 +6,7 @@
 // published by the Free Software Foundation.
 
 #include "app/modules/palettes.h"
+#include "doc/bitmap_ops.h"
 #include "doc/blend_funcs.h"
 #include "doc/image_impl.h"
 #include "doc/layer.h"
@@ -33,8 +34,6 @@ template<typename Derived>
 class InkProcessing {
 public:
   void operator()(int x1, int y, int x2, ToolLoop* loop) {
-    int x;
-
     // Use mask
     if (loop->useMask()) {
       Point maskOrigin(loop->getMaskOrigin());
@@ -49,21 +48,27 @@ public:
       if (x2 > maskOrigin.x+maskBounds.w-1)
         x2 = maskOrigin.x+maskBounds.w-1;
 
-      if (Image* bitmap = loop->getMask()->bitmap()) {
-        static_cast<Derived*>(this)->initIterators(loop, x1, y);
-
-        for (x=x1; x<=x2; ++x) {
-          if (bitmap->getPixel(x-maskOrigin.x, y-maskOrigin.y))
-            static_cast<Derived*>(this)->processPixel(x, y);
+      if (x1 > x2)
+        return;
 
-          static_cast<Derived*>(this)->moveIterators();
-        }
+      if (const Image* bitmap = loop->getMask()->bitmap()) {
+        // Process only the runs of selected pixels of this row
+        doc::BitmapRowSpans spans(bitmap, y-maskOrigin.y,
+                                  x1-maskOrigin.x, x2-maskOrigin.x);
+        int u1, u2;
+        while (spans.next(u1, u2))
+          processSpan(u1+maskOrigin.x, y, u2+maskOrigin.x, loop);
         return;
       }
     }
 
+    processSpan(x1, y, x2, loop);
+  }
+
+private:
+  void processSpan(int x1, int y, int x2, ToolLoop* loop) {
     static_cast<Derived*>(this)->initIterators(loop, x1, y);
-    for (x=x1; x<=x2; ++x) {
+    for (int x=x1; x<=x2; ++x) {
       static_cast<Derived*>(this)->processPixel(x, y);
       static_cast<Derived*>(this)->moveIterators();
     }
@@ -23,9 +23,10 @@ using namespace doc;
 
 Transaction::Transaction(Context* ctx, const std::string& label, Modification modification)
   : m_ctx(ctx)
+  , m_doc(ctx->activeDocument())
   , m_cmds(NULL)
 {
-  m_undo = m_ctx->activeDocument()->undoHistory();
+  m_undo = m_doc->undoHistory();
   m_cmds = new CmdTransaction(label,
     modification == Modification::ModifyDocument,
     m_undo->savedCounter());
@@ -34,6 +35,8 @@ Transaction::Transaction(Context* ctx, const std::string& label, Modification mo
   // SpritePosition. Sub-cmds are executed then one by one, in
   // Transaction::execute()
   m_cmds->execute(m_ctx);
+
+  m_doc->beginNotificationBatch();
 }
 
 Transaction::~Transaction()
@@ -58,16 +61,26 @@ void Transaction::commit()
   m_cmds->commit();
   m_undo->add(m_cmds);
   m_cmds = NULL;
+
+  m_doc->endNotificationBatch();
 }
 
 void Transaction::rollback()
 {
   ASSERT(m_cmds);
 
-  m_cmds->undo();
+  try {
+    m_cmds->undo();
+  }
+  catch (...) {
+    m_doc->endNotificationBatch();
+    throw;
+  }
 
   delete m_cmds;
   m_cmds = NULL;
+
+  m_doc->endNotificationBatch();
 }
 
 void Transaction::execute(Cmd* cmd)
@@ -14,6 +14,7 @@ namespace app {
   class Cmd;
   class CmdTransaction;
   class Context;
+  class Document;
   class DocumentUndo;
 
   enum Modification {
@@ -45,7 +46,9 @@ namespace app {
     virtual ~Transaction();
 
     // This must be called to commit all the changes, so the undo will
-    // be finally added in the sprite.
+    // be finally added in the sprite. Cel notifications of the
+    // executed commands are batched until the transaction is
+    // committed (or rollbacked).
     //
     // If you don't use this routine, all the changes will be discarded
     // (if the sprite's undo was enabled when the Transaction was
@@ -58,6 +61,7 @@ namespace app {
     void rollback();
 
     Context* m_ctx;
+    Document* m_doc;
     DocumentUndo* m_undo;
     CmdTransaction* m_cmds;
   };
@@ -410,6 +410,16 @@ void DocumentView::onRemoveCel(doc::DocumentEvent& ev)
   UIContext::instance()->notifyActiveSiteChanged();
 }
 
+void DocumentView::onBatchedChanges(doc::DocumentEvent& ev)
+{
+  UIContext::instance()->notifyActiveSiteChanged();
+
+  if (m_editor->isVisible() &&
+      m_editor->frame() >= ev.frame() &&
+      m_editor->frame() <= ev.lastFrame())
+    m_editor->drawSpriteClipped(ev.region());
+}
+
 void DocumentView::onTotalFramesChanged(doc::DocumentEvent& ev)
 {
   if (m_editor->frame() >= m_editor->sprite()->totalFrames()) {
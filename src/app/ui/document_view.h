@@ -79,6 +79,7 @@ namespace app {
     void onRemoveFrame(doc::DocumentEvent& ev) override;
     void onAddCel(doc::DocumentEvent& ev) override;
     void onRemoveCel(doc::DocumentEvent& ev) override;
+    void onBatchedChanges(doc::DocumentEvent& ev) override;
     void onTotalFramesChanged(doc::DocumentEvent& ev) override;
     void onLayerRestacked(doc::DocumentEvent& ev) override;
 
@@ -1156,6 +1156,11 @@ void Timeline::onLayerNameChange(doc::DocumentEvent& ev)
   invalidate();
 }
 
+void Timeline::onBatchedChanges(doc::DocumentEvent& ev)
+{
+  invalidate();
+}
+
 void Timeline::onStateChanged(Editor* editor)
 {
   m_aniControls.updateUsingEditor(editor);
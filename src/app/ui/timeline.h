@@ -115,6 +115,7 @@ namespace app {
     void onRemoveFrame(doc::DocumentEvent& ev) override;
     void onSelectionChanged(doc::DocumentEvent& ev) override;
     void onLayerNameChange(doc::DocumentEvent& ev) override;
+    void onBatchedChanges(doc::DocumentEvent& ev) override;
 
     // app::Context slots.
     void onAfterCommandExecution(CommandExecutionEvent& ev);
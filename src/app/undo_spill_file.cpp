@@ -0,0 +1,176 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "app/undo_spill_file.h"
+
+#include "base/convert_to.h"
+#include "base/debug.h"
+#include "base/fs.h"
+#include "base/fstream_path.h"
+#include "base/log.h"
+#include "base/path.h"
+#include "base/process.h"
+
+#include <iterator>
+#include <memory>
+
+namespace app {
+
+namespace {
+
+std::string g_dir;
+std::unique_ptr<UndoSpillFile> g_instance;
+bool g_failed = false;
+
+} // anonymous namespace
+
+UndoSpillFile::UndoSpillFile(const std::string& filename)
+  : m_filename(filename)
+  , m_size(0)
+  , m_entries(0)
+{
+  m_file.open(FSTREAM_PATH(filename),
+              std::ios::in | std::ios::out |
+              std::ios::binary | std::ios::trunc);
+}
+
+UndoSpillFile::~UndoSpillFile()
+{
+  m_file.close();
+  try {
+    if (base::is_file(m_filename))
+      base::delete_file(m_filename);
+  }
+  catch (const std::exception& ex) {
+    LOG("Cannot delete undo spill file '%s': %s\n",
+        m_filename.c_str(), ex.what());
+  }
+}
+
+// static
+UndoSpillFile* UndoSpillFile::instance()
+{
+  if (!g_instance && !g_failed) {
+    std::string dir = (g_dir.empty() ? base::get_temp_path(): g_dir);
+    std::string filename = base::join_path(
+      dir, "undo-" + base::convert_to<std::string>(
+        int(base::get_current_process_id())) + ".spill");
+
+    g_instance.reset(new UndoSpillFile(filename));
+    if (!g_instance->m_file.is_open()) {
+      LOG("Cannot create undo spill file '%s'\n", filename.c_str());
+      g_instance.reset();
+      g_failed = true;
+    }
+  }
+  return g_instance.get();
+}
+
+// static
+void UndoSpillFile::setDirectory(const std::string& dir)
+{
+  g_instance.reset();
+  g_failed = false;
+  g_dir = dir;
+}
+
+bool UndoSpillFile::write(const uint8_t* data, std::size_t size, Entry& entry)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // Reuse the first free range where the data fits
+  auto it = m_free.begin();
+  for (; it != m_free.end(); ++it)
+    if (it->second >= size)
+      break;
+
+  const uint64_t offset = (it != m_free.end() ? it->first: m_size);
+
+  m_file.clear();
+  m_file.seekp(std::streamoff(offset), std::ios::beg);
+  m_file.write((const char*)data, std::streamsize(size));
+  if (!m_file.good())
+    return false;
+
+  if (it != m_free.end()) {
+    if (it->second > size)
+      m_free[offset+size] = it->second - size;
+    m_free.erase(it);
+  }
+  else
+    m_size += size;
+
+  entry.offset = offset;
+  entry.size = size;
+  ++m_entries;
+  return true;
+}
+
+bool UndoSpillFile::read(const Entry& entry, uint8_t* data)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_file.clear();
+  m_file.seekg(std::streamoff(entry.offset), std::ios::beg);
+  m_file.read((char*)data, std::streamsize(entry.size));
+  return (m_file.good() &&
+          std::size_t(m_file.gcount()) == entry.size);
+}
+
+// static
+void UndoSpillFile::release(const Entry& entry)
+{
+  if (g_instance)
+    g_instance->releaseEntry(entry);
+}
+
+void UndoSpillFile::releaseEntry(const Entry& entry)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  ASSERT(m_entries > 0);
+  if (--m_entries == 0) {
+    // Nothing is used, so we can truncate the file
+    m_free.clear();
+    m_size = 0;
+    m_file.close();
+    m_file.open(FSTREAM_PATH(m_filename),
+                std::ios::in | std::ios::out |
+                std::ios::binary | std::ios::trunc);
+    return;
+  }
+
+  uint64_t offset = entry.offset;
+  std::size_t size = entry.size;
+
+  // Merge with the adjacent free ranges
+  auto next = m_free.lower_bound(offset);
+  if (next != m_free.end() && offset+size == next->first) {
+    size += next->second;
+    next = m_free.erase(next);
+  }
+  if (next != m_free.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      size += prev->second;
+      m_free.erase(prev);
+    }
+  }
+
+  // The end of the file is not a free range, it's just unused
+  if (offset+size == m_size)
+    m_size = offset;
+  else
+    m_free[offset] = size;
+}
+
+} // namespace app
@@ -0,0 +1,71 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#pragma once
+
+#include "base/disable_copying.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace app {
+
+  // File where the data of undo states far from the current state is
+  // moved to reduce memory use. The data is read back (one read per
+  // command) when those states are undone/redone. The space of
+  // released entries is reused, and the file is truncated when no
+  // entry is used.
+  //
+  // The file is created in the data recovery session directory (or in
+  // the temporary directory if data recovery is disabled), and it's
+  // deleted when the program ends.
+  class UndoSpillFile {
+  public:
+    struct Entry {
+      uint64_t offset = 0;
+      std::size_t size = 0;
+    };
+
+    ~UndoSpillFile();
+
+    // Returns the file to spill data (it's created the first time),
+    // or nullptr if the file cannot be created.
+    static UndoSpillFile* instance();
+
+    // Changes the directory where the file is created. The current
+    // file is deleted, so it cannot be called while there are
+    // commands with spilled data. An empty string means the temporary
+    // directory.
+    static void setDirectory(const std::string& dir);
+
+    bool write(const uint8_t* data, std::size_t size, Entry& entry);
+    bool read(const Entry& entry, uint8_t* data);
+
+    // Frees the space of an entry that is not needed anymore (the
+    // data was read back or the command was deleted). It does nothing
+    // if the file doesn't exist.
+    static void release(const Entry& entry);
+
+  private:
+    UndoSpillFile(const std::string& filename);
+    void releaseEntry(const Entry& entry);
+
+    std::string m_filename;
+    std::fstream m_file;
+    uint64_t m_size;
+    std::map<uint64_t, std::size_t> m_free; // Free ranges (offset -> size)
+    int m_entries;                          // Number of used entries
+    std::mutex m_mutex;
+
+    DISABLE_COPYING(UndoSpillFile);
+  };
+
+} // namespace app
@@ -0,0 +1,85 @@
+// LibreSprite
+// Copyright (C) 2026  LibreSprite contributors
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License version 2 as
+// published by the Free Software Foundation.
+
+#include "tests/test.h"
+
+#include "app/undo_spill_file.h"
+#include "base/fs.h"
+
+#include <vector>
+
+using namespace app;
+
+namespace {
+
+std::vector<uint8_t> make_data(std::size_t size, uint8_t value)
+{
+  return std::vector<uint8_t>(size, value);
+}
+
+bool read_equals(UndoSpillFile* file, const UndoSpillFile::Entry& entry,
+                 const std::vector<uint8_t>& expected)
+{
+  std::vector<uint8_t> data(entry.size);
+  return (file->read(entry, data.data()) && data == expected);
+}
+
+} // anonymous namespace
+
+TEST(UndoSpillFile, ReuseReleasedSpace)
+{
+  UndoSpillFile::setDirectory(".");
+  UndoSpillFile* file = UndoSpillFile::instance();
+  ASSERT_TRUE(file != nullptr);
+
+  auto a = make_data(100, 1);
+  auto b = make_data(50, 2);
+  auto c = make_data(30, 3);
+  UndoSpillFile::Entry ea, eb, ec, ed;
+  ASSERT_TRUE(file->write(a.data(), a.size(), ea));
+  ASSERT_TRUE(file->write(b.data(), b.size(), eb));
+  ASSERT_TRUE(file->write(c.data(), c.size(), ec));
+  EXPECT_EQ(0, ea.offset);
+  EXPECT_EQ(100, eb.offset);
+  EXPECT_EQ(150, ec.offset);
+
+  // The space of "a" is reused
+  UndoSpillFile::release(ea);
+  auto d = make_data(60, 4);
+  ASSERT_TRUE(file->write(d.data(), d.size(), ed));
+  EXPECT_EQ(0, ed.offset);
+
+  // Released ranges are merged ("a" rest + "b")
+  UndoSpillFile::release(eb);
+  UndoSpillFile::Entry ee;
+  auto e = make_data(90, 5);
+  ASSERT_TRUE(file->write(e.data(), e.size(), ee));
+  EXPECT_EQ(60, ee.offset);
+
+  EXPECT_TRUE(read_equals(file, ec, c));
+  EXPECT_TRUE(read_equals(file, ed, d));
+  EXPECT_TRUE(read_equals(file, ee, e));
+
+  // The last entry is at the end of the file, so new data is
+  // appended where it was
+  UndoSpillFile::release(ec);
+  UndoSpillFile::Entry ef;
+  ASSERT_TRUE(file->write(c.data(), c.size(), ef));
+  EXPECT_EQ(150, ef.offset);
+
+  // When nothing is used the file is truncated
+  UndoSpillFile::release(ed);
+  UndoSpillFile::release(ee);
+  UndoSpillFile::release(ef);
+  ASSERT_TRUE(file->write(b.data(), b.size(), eb));
+  EXPECT_EQ(0, eb.offset);
+  EXPECT_TRUE(read_equals(file, eb, b));
+  UndoSpillFile::release(eb);
+
+  // Deletes the file
+  UndoSpillFile::setDirectory("");
+}
@@ -11,7 +11,7 @@
 
 #include "app/util/clipboard_native.h"
 
-#include "base/serialization.h"
+#include "base/binary_stream.h"
 #include "clip/clip.h"
 #include "doc/color_scales.h"
 #include "doc/image.h"
@@ -31,9 +31,6 @@
 namespace app {
 namespace clipboard {
 
-using namespace base::serialization;
-using namespace base::serialization::little_endian;
-
 namespace {
   clip::format custom_image_format = 0;
 
@@ -80,24 +77,30 @@ bool set_native_clipboard_bitmap(const doc::Image* image,
 
   // Set custom clipboard formats
   if (custom_image_format) {
-    std::stringstream os;
-    write32(os,
-            (image   ? 1: 0) |
-            (mask    ? 2: 0) |
-            (palette ? 4: 0));
-    if (image) doc::write_image(os, image);
+    std::ostringstream os;
+    try {
+      base::BinaryWriter w(os);
+      w.write32((image   ? 1: 0) |
+                (mask    ? 2: 0) |
+                (palette ? 4: 0));
+
+      // Zlib with the fastest level, so other instances of the
+      // program (maybe old versions) can read the image.
+      if (image)
+        doc::write_image(w, image, image->id(),
+                         base::CompressionOptions(base::Compression::Zlib, 1));
+      w.flush();
+    }
+    catch (const std::exception&) {
+      os.setstate(std::ios::failbit);
+    }
     if (mask) doc::write_mask(os, mask);
     if (palette) doc::write_palette(os, *palette);
 
     if (os.good()) {
-      size_t size = (size_t)os.tellp();
-      if (size > 0) {
-        std::vector<char> data(size);
-        os.seekp(0);
-        os.read(&data[0], size);
-
-        l.set_data(custom_image_format, &data[0], size);
-      }
+      const std::string data = os.str();
+      if (!data.empty())
+        l.set_data(custom_image_format, data.c_str(), data.size());
     }
   }
 
@@ -182,12 +185,11 @@ bool get_native_clipboard_bitmap(doc::Image** image,
     if (size > 0) {
       std::vector<char> buf(size);
       if (l.get_data(custom_image_format, &buf[0], size)) {
-        std::stringstream is;
-        is.write(&buf[0], size);
-        is.seekp(0);
+        std::istringstream is(std::string(&buf[0], size));
+        base::BinaryReader r(is);
 
-        int bits = read32(is);
-        if (bits & 1) *image   = doc::read_image(is, false);
+        int bits = r.read32();
+        if (bits & 1) *image   = doc::read_image(r, false);
         if (bits & 2) *mask    = doc::read_mask(is);
         if (bits & 4) palette = doc::read_palette(is);
         if (image)
@@ -28,6 +28,8 @@
 #include "doc/site.h"
 #include "doc/sprite.h"
 
+#include <vector>
+
 namespace {
 
 // We cannot have two ExpandCelCanvas instances at the same time
@@ -182,21 +184,10 @@ void ExpandCelCanvas::commit()
 
     ASSERT(m_cel->image() == m_celImage.get());
 
-    gfx::Region* regionToPatch = &m_validDstRegion;
-    gfx::Region reduced;
-
-    if (m_canCompareSrcVsDst) {
-      ASSERT(gfx::Region().createSubtraction(m_validDstRegion, m_validSrcRegion).isEmpty());
-
-      for (gfx::Rect rc : m_validDstRegion) {
-        if (algorithm::shrink_bounds2(getSourceCanvas(),
-                                      getDestCanvas(), rc, rc)) {
-          reduced |= gfx::Region(rc);
-        }
-      }
-
-      regionToPatch = &reduced;
-    }
+    // Save whole tiles instead of the modified region (a freehand
+    // stroke can generate a region with thousands of small rectangles)
+    const gfx::Region tiles = getModifiedTiles(m_validDstRegion);
+    const gfx::Region* regionToPatch = &tiles;
 
     if (m_layer->isBackground()) {
       m_transaction.execute(
@@ -222,6 +213,70 @@ void ExpandCelCanvas::commit()
   m_committed = true;
 }
 
+gfx::Region ExpandCelCanvas::getModifiedTiles(const gfx::Region& rgn)
+{
+  const int T = kUndoTileSize;
+  const gfx::Rect dstBounds = getDestCanvas()->bounds();
+
+  // Tiles are aligned to the sprite origin
+  const int tx0 = (m_bounds.x >= 0 ? m_bounds.x / T: -((-m_bounds.x+T-1) / T));
+  const int ty0 = (m_bounds.y >= 0 ? m_bounds.y / T: -((-m_bounds.y+T-1) / T));
+  const gfx::Point tileOrigin(tx0*T - m_bounds.x, ty0*T - m_bounds.y);
+  const int cols = (dstBounds.w - tileOrigin.x + T-1) / T;
+  const int rows = (dstBounds.h - tileOrigin.y + T-1) / T;
+
+  // Mark tiles touched by the region
+  std::vector<bool> touched(cols*rows, false);
+  for (const gfx::Rect& rc : rgn) {
+    if (rc.isEmpty())
+      continue;
+
+    const int u1 = (rc.x - tileOrigin.x) / T;
+    const int v1 = (rc.y - tileOrigin.y) / T;
+    const int u2 = (rc.x2()-1 - tileOrigin.x) / T;
+    const int v2 = (rc.y2()-1 - tileOrigin.y) / T;
+    for (int v=v1; v<=v2; ++v)
+      for (int u=u1; u<=u2; ++u)
+        touched[v*cols+u] = true;
+  }
+
+  // Create the region with whole tiles (only the ones with modified
+  // pixels if we can compare src vs dst), joining consecutive tiles of
+  // each row of tiles.
+  gfx::Region tiles;
+  for (int v=0; v<rows; ++v) {
+    gfx::Rect run;
+    for (int u=0; u<=cols; ++u) {
+      bool modified = false;
+      gfx::Rect tile;
+
+      if (u < cols && touched[v*cols+u]) {
+        tile = gfx::Rect(tileOrigin.x + u*T,
+                         tileOrigin.y + v*T, T, T) & dstBounds;
+
+        // Pixels of the tile outside the modified region must be
+        // valid too (they will be copied as they are)
+        validateDestCanvas(gfx::Region(gfx::Rect(tile).offset(m_bounds.origin())));
+
+        gfx::Rect modifiedBounds;
+        modified =
+          (!m_canCompareSrcVsDst ||
+           algorithm::shrink_bounds2(getSourceCanvas(),
+                                     getDestCanvas(), tile, modifiedBounds));
+      }
+
+      if (modified) {
+        run |= tile;
+      }
+      else if (!run.isEmpty()) {
+        tiles |= gfx::Region(run);
+        run = gfx::Rect();
+      }
+    }
+  }
+  return tiles;
+}
+
 void ExpandCelCanvas::rollback()
 {
   ASSERT(!m_closed);
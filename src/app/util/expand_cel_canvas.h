@@ -69,6 +69,11 @@ namespace app {
     const Cel* getCel() const { return m_cel.get(); }
 
   private:
+    // Size of the tiles (aligned to sprite coordinates) used to save
+    // undo information of the modified pixels.
+    static const int kUndoTileSize = 64;
+
+    gfx::Region getModifiedTiles(const gfx::Region& rgn);
     gfx::Rect getTrimDstImageBounds() const;
     ImageRef trimDstImage(const gfx::Rect& bounds) const;
 
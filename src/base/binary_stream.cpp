@@ -0,0 +1,423 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "base/binary_stream.h"
+
+#include "base/debug.h"
+#include "base/exception.h"
+#include "base/lz_rows.h"
+
+#include "zlib.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace base {
+
+namespace {
+
+// Bytes accumulated by BinaryWriter before they are sent to the
+// stream.
+const std::size_t kWriterBufferSize = 64*1024;
+
+// Size of each step of the output buffer of the zlib compressor.
+const std::size_t kZlibChunkSize = 64*1024;
+
+} // anonymous namespace
+
+//////////////////////////////////////////////////////////////////////
+// Compressors
+
+class BinaryWriter::Compressor {
+public:
+  virtual ~Compressor() { }
+  virtual void write(const uint8_t* data, std::size_t size) = 0;
+  virtual void finish() = 0;
+  const buffer& output() const { return m_output; }
+protected:
+  buffer m_output;
+};
+
+namespace {
+
+class NoneCompressor : public BinaryWriter::Compressor {
+public:
+  void write(const uint8_t* data, std::size_t size) override {
+    m_output.insert(m_output.end(), data, data+size);
+  }
+  void finish() override { }
+};
+
+class ZlibCompressor : public BinaryWriter::Compressor {
+public:
+  ZlibCompressor(int level) {
+    m_zstream.zalloc = (alloc_func)0;
+    m_zstream.zfree  = (free_func)0;
+    m_zstream.opaque = (voidpf)0;
+    int err = deflateInit(&m_zstream, level);
+    if (err != Z_OK)
+      throw Exception("ZLib error %d in deflateInit().", err);
+  }
+
+  ~ZlibCompressor() {
+    deflateEnd(&m_zstream);
+  }
+
+  void write(const uint8_t* data, std::size_t size) override {
+    m_zstream.next_in = (Bytef*)data;
+    m_zstream.avail_in = (uInt)size;
+    deflateAll(Z_NO_FLUSH);
+  }
+
+  void finish() override {
+    m_zstream.next_in = nullptr;
+    m_zstream.avail_in = 0;
+    deflateAll(Z_FINISH);
+  }
+
+private:
+  void deflateAll(int flush) {
+    do {
+      std::size_t used = m_output.size();
+      m_output.resize(used + kZlibChunkSize);
+      m_zstream.next_out = (Bytef*)&m_output[used];
+      m_zstream.avail_out = (uInt)kZlibChunkSize;
+
+      int err = deflate(&m_zstream, flush);
+      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+        throw Exception("ZLib error %d in deflate().", err);
+
+      m_output.resize(used + kZlibChunkSize - m_zstream.avail_out);
+    } while (m_zstream.avail_out == 0);
+  }
+
+  z_stream m_zstream;
+};
+
+// Each write() is compressed as one "row" of LzRowsWriter, so it can
+// reference the previous written piece of data (we keep a copy of it
+// because the given data can be temporary).
+class FastCompressor : public BinaryWriter::Compressor {
+public:
+  FastCompressor() : m_writer(m_output) { }
+
+  void write(const uint8_t* data, std::size_t size) override {
+    std::swap(m_prev, m_current);
+    m_current.assign(data, data+size);
+    m_writer.writeRow(m_current.data(), size);
+  }
+
+  void finish() override { }
+
+private:
+  LzRowsWriter m_writer;
+  buffer m_prev;
+  buffer m_current;
+};
+
+} // anonymous namespace
+
+//////////////////////////////////////////////////////////////////////
+// Decompressors
+
+class BinaryReader::Decompressor {
+public:
+  Decompressor(buffer&& input) : m_input(std::move(input)) { }
+  virtual ~Decompressor() { }
+  virtual bool read(uint8_t* data, std::size_t size) = 0;
+protected:
+  buffer m_input;
+};
+
+namespace {
+
+class NoneDecompressor : public BinaryReader::Decompressor {
+public:
+  NoneDecompressor(buffer&& input)
+    : Decompressor(std::move(input)), m_pos(0) {
+  }
+
+  bool read(uint8_t* data, std::size_t size) override {
+    if (size > m_input.size() - m_pos)
+      return false;
+    std::copy(m_input.begin()+m_pos, m_input.begin()+m_pos+size, data);
+    m_pos += size;
+    return true;
+  }
+
+private:
+  std::size_t m_pos;
+};
+
+class ZlibDecompressor : public BinaryReader::Decompressor {
+public:
+  ZlibDecompressor(buffer&& input)
+    : Decompressor(std::move(input)), m_end(false) {
+    m_zstream.zalloc = (alloc_func)0;
+    m_zstream.zfree  = (free_func)0;
+    m_zstream.opaque = (voidpf)0;
+    m_zstream.next_in = (m_input.empty() ? nullptr: (Bytef*)&m_input[0]);
+    m_zstream.avail_in = (uInt)m_input.size();
+    m_ok = (inflateInit(&m_zstream) == Z_OK);
+  }
+
+  ~ZlibDecompressor() {
+    if (m_ok)
+      inflateEnd(&m_zstream);
+  }
+
+  bool read(uint8_t* data, std::size_t size) override {
+    if (!m_ok)
+      return false;
+
+    m_zstream.next_out = (Bytef*)data;
+    m_zstream.avail_out = (uInt)size;
+
+    while (m_zstream.avail_out > 0) {
+      if (m_end)
+        return false;
+
+      int err = inflate(&m_zstream, Z_NO_FLUSH);
+      if (err == Z_STREAM_END)
+        m_end = true;
+      else if (err != Z_OK)
+        return false;      // Includes Z_BUF_ERROR (no more input)
+    }
+    return true;
+  }
+
+private:
+  z_stream m_zstream;
+  bool m_ok;
+  bool m_end;
+};
+
+// Reads what FastCompressor writes, each read() must have the size
+// of the original write() call.
+class FastDecompressor : public BinaryReader::Decompressor {
+public:
+  FastDecompressor(buffer&& input)
+    : Decompressor(std::move(input))
+    , m_reader(m_input.data(), m_input.size()) {
+  }
+
+  bool read(uint8_t* data, std::size_t size) override {
+    std::swap(m_prev, m_current);
+    m_current.resize(size);
+    if (!m_reader.readRow(m_current.data(), size))
+      return false;
+    std::copy(m_current.begin(), m_current.end(), data);
+    return true;
+  }
+
+private:
+  LzRowsReader m_reader;
+  buffer m_prev;
+  buffer m_current;
+};
+
+} // anonymous namespace
+
+//////////////////////////////////////////////////////////////////////
+// BinaryWriter
+
+BinaryWriter::BinaryWriter(std::ostream& os)
+  : m_os(os)
+{
+  m_buffer.reserve(kWriterBufferSize);
+}
+
+BinaryWriter::~BinaryWriter()
+{
+  try {
+    flush();
+  }
+  catch (...) {
+    // Ignore errors, the stream will be in fail state anyway
+  }
+}
+
+void BinaryWriter::write8(uint8_t value)
+{
+  write(&value, 1);
+}
+
+void BinaryWriter::write16(uint16_t value)
+{
+  uint8_t bytes[2] = {
+    uint8_t(value),
+    uint8_t(value >> 8)
+  };
+  write(bytes, 2);
+}
+
+void BinaryWriter::write32(uint32_t value)
+{
+  uint8_t bytes[4] = {
+    uint8_t(value),
+    uint8_t(value >> 8),
+    uint8_t(value >> 16),
+    uint8_t(value >> 24)
+  };
+  write(bytes, 4);
+}
+
+void BinaryWriter::write(const void* data, std::size_t size)
+{
+  if (m_compressor)
+    m_compressor->write((const uint8_t*)data, size);
+  else
+    put(data, size);
+}
+
+void BinaryWriter::beginCompression(const CompressionOptions& options)
+{
+  ASSERT(!m_compressor);
+
+  switch (options.method) {
+    case Compression::None: m_compressor.reset(new NoneCompressor); break;
+    case Compression::Zlib: m_compressor.reset(new ZlibCompressor(options.level)); break;
+    case Compression::Fast: m_compressor.reset(new FastCompressor); break;
+  }
+}
+
+void BinaryWriter::endCompression()
+{
+  ASSERT(m_compressor);
+
+  std::unique_ptr<Compressor> compressor;
+  std::swap(compressor, m_compressor);
+  compressor->finish();
+
+  const buffer& output = compressor->output();
+  write32(uint32_t(output.size()));
+  if (!output.empty())
+    put(output.data(), output.size());
+}
+
+void BinaryWriter::flush()
+{
+  if (m_buffer.empty())
+    return;
+
+  m_os.write((const char*)m_buffer.data(), m_buffer.size());
+  m_buffer.clear();
+
+  if (m_os.fail())
+    throw Exception("Error writing data in the stream.");
+}
+
+void BinaryWriter::put(const void* data, std::size_t size)
+{
+  if (m_buffer.size() + size > kWriterBufferSize) {
+    flush();
+
+    // Big blocks are sent directly to the stream
+    if (size > kWriterBufferSize) {
+      if (m_os.write((const char*)data, size).fail())
+        throw Exception("Error writing data in the stream.");
+      return;
+    }
+  }
+
+  const uint8_t* p = (const uint8_t*)data;
+  m_buffer.insert(m_buffer.end(), p, p+size);
+}
+
+//////////////////////////////////////////////////////////////////////
+// BinaryReader
+
+BinaryReader::BinaryReader(std::istream& is)
+  : m_is(is)
+  , m_ok(true)
+{
+}
+
+BinaryReader::~BinaryReader()
+{
+}
+
+uint8_t BinaryReader::read8()
+{
+  uint8_t value = 0;
+  read(&value, 1);
+  return value;
+}
+
+uint16_t BinaryReader::read16()
+{
+  uint8_t bytes[2] = { 0, 0 };
+  read(bytes, 2);
+  return uint16_t(bytes[0] | (bytes[1] << 8));
+}
+
+uint32_t BinaryReader::read32()
+{
+  uint8_t bytes[4] = { 0, 0, 0, 0 };
+  read(bytes, 4);
+  return (uint32_t(bytes[0])       |
+          uint32_t(bytes[1]) <<  8 |
+          uint32_t(bytes[2]) << 16 |
+          uint32_t(bytes[3]) << 24);
+}
+
+bool BinaryReader::read(void* data, std::size_t size)
+{
+  if (!m_ok)
+    return false;
+
+  if (m_decompressor)
+    m_ok = m_decompressor->read((uint8_t*)data, size);
+  else
+    m_ok = !m_is.read((char*)data, size).fail();
+
+  if (!m_ok)
+    std::memset(data, 0, size);
+  return m_ok;
+}
+
+bool BinaryReader::beginDecompression(Compression method)
+{
+  ASSERT(!m_decompressor);
+
+  std::size_t size = read32();
+  if (!m_ok)
+    return false;
+
+  // Read the block in pieces so a corrupted size doesn't allocate
+  // too much memory
+  buffer input;
+  while (input.size() < size) {
+    std::size_t used = input.size();
+    std::size_t n = std::min<std::size_t>(size - used, 1024*1024);
+    input.resize(used + n);
+    if (!read(&input[used], n))
+      return false;
+  }
+
+  switch (method) {
+    case Compression::None: m_decompressor.reset(new NoneDecompressor(std::move(input))); break;
+    case Compression::Zlib: m_decompressor.reset(new ZlibDecompressor(std::move(input))); break;
+    case Compression::Fast: m_decompressor.reset(new FastDecompressor(std::move(input))); break;
+    default:
+      m_ok = false;
+      return false;
+  }
+  return true;
+}
+
+void BinaryReader::endDecompression()
+{
+  m_decompressor.reset();
+}
+
+} // namespace base
@@ -0,0 +1,111 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include "base/buffer.h"
+#include "base/disable_copying.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+
+namespace base {
+
+  // Method used to compress a block of data written with
+  // BinaryWriter::beginCompression()/endCompression().
+  enum class Compression : uint8_t {
+    None = 0,                   // Data is stored as it is
+    Zlib = 1,                   // zlib stream
+    Fast = 2,                   // LZ77 (base::LzRowsWriter), faster but
+                                // bigger than zlib
+  };
+
+  struct CompressionOptions {
+    Compression method;
+    int level;                  // Only for Zlib: from 0 to 9 (or -1
+                                // for the default zlib level)
+
+    CompressionOptions(Compression method = Compression::Zlib,
+                       int level = -1)
+      : method(method), level(level) {
+    }
+  };
+
+  // Little-endian writer that accumulates the data in memory and
+  // sends it to the stream in big chunks (when the buffer is full,
+  // flush() is called, or the writer is destroyed).
+  //
+  // Bytes written between beginCompression() and endCompression()
+  // go through the compression stage, and are stored in the stream
+  // as a 32-bit size followed by the compressed data (with
+  // Compression::Zlib it's the format of the pixels of images saved
+  // by old versions of doc::write_image()).
+  class BinaryWriter {
+  public:
+    explicit BinaryWriter(std::ostream& os);
+    ~BinaryWriter();
+
+    void write8(uint8_t value);
+    void write16(uint16_t value);
+    void write32(uint32_t value);
+    void write(const void* data, std::size_t size);
+
+    void beginCompression(const CompressionOptions& options);
+    void endCompression();
+
+    // Throws a base::Exception if the data cannot be written.
+    void flush();
+
+    class Compressor;
+
+  private:
+    void put(const void* data, std::size_t size);
+
+    std::ostream& m_os;
+    buffer m_buffer;
+    std::unique_ptr<Compressor> m_compressor;
+
+    DISABLE_COPYING(BinaryWriter);
+  };
+
+  // Reads data written with BinaryWriter. It doesn't read ahead, so
+  // the stream can be used to read other things after it.
+  //
+  // When a block is compressed with Compression::Fast, it must be
+  // read in pieces of the same sizes that were used to write it.
+  class BinaryReader {
+  public:
+    explicit BinaryReader(std::istream& is);
+    ~BinaryReader();
+
+    uint8_t read8();
+    uint16_t read16();
+    uint32_t read32();
+    bool read(void* data, std::size_t size);
+
+    // Reads the whole compressed block (the size and the data), then
+    // read() calls return the uncompressed bytes until
+    // endDecompression().
+    bool beginDecompression(Compression method);
+    void endDecompression();
+
+    // Returns false if there was an error reading the stream or
+    // decompressing data.
+    bool ok() const { return m_ok; }
+
+    class Decompressor;
+
+  private:
+    std::istream& m_is;
+    std::unique_ptr<Decompressor> m_decompressor;
+    bool m_ok;
+
+    DISABLE_COPYING(BinaryReader);
+  };
+
+} // namespace base
@@ -0,0 +1,140 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <gtest/gtest.h>
+
+#include "base/binary_stream.h"
+
+#include <sstream>
+#include <string>
+
+using namespace base;
+
+namespace {
+
+buffer make_row(int y, std::size_t size)
+{
+  buffer row(size);
+  for (std::size_t x=0; x<size; ++x)
+    row[x] = uint8_t((x / 7) + (y & 3));
+  return row;
+}
+
+std::string write_sample(const CompressionOptions& options, int rows, std::size_t rowSize)
+{
+  std::ostringstream os;
+  BinaryWriter w(os);
+  w.write8(0x12);
+  w.write16(0x3456);
+  w.write32(0x789abcde);
+  w.beginCompression(options);
+  for (int y=0; y<rows; ++y) {
+    buffer row = make_row(y, rowSize);
+    w.write(row.data(), row.size());
+  }
+  w.endCompression();
+  w.write32(0xfeedbeef);
+  w.flush();
+  return os.str();
+}
+
+void expect_sample(const std::string& data, Compression method, int rows, std::size_t rowSize)
+{
+  std::istringstream is(data);
+  BinaryReader r(is);
+  EXPECT_EQ(0x12, r.read8());
+  EXPECT_EQ(0x3456, r.read16());
+  EXPECT_EQ(0x789abcde, r.read32());
+  ASSERT_TRUE(r.beginDecompression(method));
+  for (int y=0; y<rows; ++y) {
+    buffer row(rowSize, 0);
+    ASSERT_TRUE(r.read(row.data(), row.size()));
+    EXPECT_EQ(make_row(y, rowSize), row);
+  }
+  r.endDecompression();
+  EXPECT_EQ(0xfeedbeef, r.read32());
+  EXPECT_TRUE(r.ok());
+
+  // Nothing was read ahead
+  EXPECT_EQ(std::streamoff(data.size()), std::streamoff(is.tellg()));
+}
+
+} // anonymous namespace
+
+TEST(BinaryStream, LittleEndian)
+{
+  std::ostringstream os;
+  {
+    BinaryWriter w(os);
+    w.write16(0x0102);
+    w.write32(0x03040506);
+  }
+  EXPECT_EQ(std::string("\x02\x01\x06\x05\x04\x03", 6), os.str());
+}
+
+TEST(BinaryStream, AllMethods)
+{
+  for (auto method : { Compression::None, Compression::Zlib, Compression::Fast }) {
+    std::string data = write_sample(CompressionOptions(method), 300, 1000);
+    expect_sample(data, method, 300, 1000);
+  }
+}
+
+TEST(BinaryStream, CompressionReducesSize)
+{
+  std::string none = write_sample(CompressionOptions(Compression::None), 100, 4096);
+  std::string zlib = write_sample(CompressionOptions(Compression::Zlib, 1), 100, 4096);
+  std::string fast = write_sample(CompressionOptions(Compression::Fast), 100, 4096);
+  EXPECT_LT(zlib.size(), none.size() / 4);
+  EXPECT_LT(fast.size(), none.size() / 4);
+}
+
+TEST(BinaryStream, EmptyBlock)
+{
+  for (auto method : { Compression::None, Compression::Zlib, Compression::Fast }) {
+    std::string data = write_sample(CompressionOptions(method), 0, 0);
+    expect_sample(data, method, 0, 0);
+  }
+}
+
+TEST(BinaryStream, ReadMoreThanWritten)
+{
+  for (auto method : { Compression::None, Compression::Zlib, Compression::Fast }) {
+    std::string data = write_sample(CompressionOptions(method), 2, 100);
+    std::istringstream is(data);
+    BinaryReader r(is);
+    r.read8();
+    r.read16();
+    r.read32();
+    ASSERT_TRUE(r.beginDecompression(method));
+
+    buffer row(100);
+    EXPECT_TRUE(r.read(row.data(), row.size()));
+    EXPECT_TRUE(r.read(row.data(), row.size()));
+    EXPECT_FALSE(r.read(row.data(), row.size()));
+    EXPECT_FALSE(r.ok());
+  }
+}
+
+TEST(BinaryStream, TruncatedStream)
+{
+  std::string data = write_sample(CompressionOptions(Compression::Zlib), 10, 100);
+  data.resize(data.size() / 2);
+
+  std::istringstream is(data);
+  BinaryReader r(is);
+  r.read8();
+  r.read16();
+  r.read32();
+  EXPECT_FALSE(r.beginDecompression(Compression::Zlib));
+  EXPECT_FALSE(r.ok());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,69 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "base/file_mapping.h"
+
+#ifdef _WIN32
+  #include "base/file_mapping_win32.h"
+#else
+  #include "base/file_mapping_unix.h"
+#endif
+
+namespace base {
+
+FileMapping::FileMapping()
+  : m_data(nullptr)
+  , m_size(0)
+{
+}
+
+FileMapping::~FileMapping()
+{
+  close();
+}
+
+bool FileMapping::open(const std::string& filename)
+{
+  close();
+  if (!map_file(filename, m_data, m_size, m_stamp))
+    return false;
+
+  m_filename = filename;
+  return true;
+}
+
+void FileMapping::close()
+{
+  if (m_data) {
+    unmap_file(m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_filename.clear();
+  }
+}
+
+bool FileMapping::isModified() const
+{
+  if (!m_data)
+    return false;
+
+  // If the file doesn't exist or it's other file, the mapping still
+  // has the content of the original one.
+  FileMappingStamp stamp;
+  if (!get_file_stamp(m_filename, stamp) ||
+      stamp.device != m_stamp.device ||
+      stamp.inode != m_stamp.inode)
+    return false;
+
+  return (stamp.size != m_stamp.size ||
+          stamp.mtime != m_stamp.mtime);
+}
+
+} // namespace base
@@ -0,0 +1,59 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include "base/disable_copying.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace base {
+
+  // Identity, size and modification time (with the best precision
+  // of the platform) of a mapped file.
+  struct FileMappingStamp {
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+    std::uint64_t size = 0;
+    std::uint64_t mtime = 0;
+  };
+
+  // Read-only view of the whole content of a file in memory. The
+  // file must not be modified while it's mapped.
+  class FileMapping {
+  public:
+    FileMapping();
+    ~FileMapping();
+
+    // Returns false if the file cannot be mapped (it doesn't exist,
+    // it's empty, it's a pipe or other special file, etc.), in that
+    // case the file must be read in other way.
+    bool open(const std::string& filename);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const uint8_t* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+    // Returns true if the mapped file was modified (e.g. rewritten by
+    // other program) since it was mapped, so data() cannot be
+    // trusted. Deleting the file or replacing it with a new one
+    // (e.g. renaming other file over it) doesn't modify the mapped
+    // data.
+    bool isModified() const;
+
+  private:
+    const uint8_t* m_data;
+    std::size_t m_size;
+    std::string m_filename;
+    FileMappingStamp m_stamp;
+
+    DISABLE_COPYING(FileMapping);
+  };
+
+} // namespace base
@@ -0,0 +1,136 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <gtest/gtest.h>
+
+#include "base/file_handle.h"
+#include "base/file_mapping.h"
+#include "base/fs.h"
+
+#include <cstring>
+
+#ifndef _WIN32
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+using namespace base;
+
+namespace {
+
+void write_file(const char* fn, const char* content, std::size_t size)
+{
+  if (is_file(fn))
+    delete_file(fn);
+
+  FileHandle f(open_file_with_exception(fn, "wb"));
+  if (size > 0)
+    fwrite(content, 1, size, f.get());
+}
+
+} // anonymous namespace
+
+TEST(FileMapping, MapFile)
+{
+  const char* fn = "test_mapping.bin";
+  write_file(fn, "hello\0world", 11);
+
+  FileMapping mapping;
+  ASSERT_TRUE(mapping.open(fn));
+  EXPECT_TRUE(mapping.isOpen());
+  ASSERT_EQ(11, mapping.size());
+  EXPECT_EQ(0, std::memcmp(mapping.data(), "hello\0world", 11));
+
+  mapping.close();
+  EXPECT_FALSE(mapping.isOpen());
+  EXPECT_EQ(nullptr, mapping.data());
+  EXPECT_EQ(0, mapping.size());
+
+  delete_file(fn);
+}
+
+TEST(FileMapping, CannotMap)
+{
+  FileMapping mapping;
+  EXPECT_FALSE(mapping.open("file_that_does_not_exist.bin"));
+  EXPECT_FALSE(mapping.isOpen());
+
+  // Empty files cannot be mapped
+  const char* fn = "test_empty_mapping.bin";
+  write_file(fn, "", 0);
+  EXPECT_FALSE(mapping.open(fn));
+  delete_file(fn);
+
+  // Directories neither
+  EXPECT_FALSE(mapping.open("."));
+}
+
+TEST(FileMapping, IsModified)
+{
+  const char* fn = "test_modified_mapping.bin";
+  write_file(fn, "hello", 5);
+
+  FileMapping mapping;
+  ASSERT_TRUE(mapping.open(fn));
+  EXPECT_FALSE(mapping.isModified());
+
+  // Modify the same file
+  {
+    FileHandle f(open_file_with_exception(fn, "ab"));
+    fwrite(" world", 1, 6, f.get());
+  }
+  EXPECT_TRUE(mapping.isModified());
+
+  mapping.close();
+  EXPECT_FALSE(mapping.isModified());
+  delete_file(fn);
+}
+
+#ifndef _WIN32
+
+TEST(FileMapping, ReplacedFileIsNotModified)
+{
+  const char* fn = "test_replaced_mapping.bin";
+  const char* tmp = "test_replaced_mapping.tmp";
+  write_file(fn, "hello", 5);
+
+  FileMapping mapping;
+  ASSERT_TRUE(mapping.open(fn));
+
+  // The mapping keeps the content of the replaced file
+  write_file(tmp, "new content", 11);
+  move_file(tmp, fn);
+  EXPECT_FALSE(mapping.isModified());
+  ASSERT_EQ(5, mapping.size());
+  EXPECT_EQ(0, std::memcmp(mapping.data(), "hello", 5));
+
+  // And of the deleted file
+  delete_file(fn);
+  EXPECT_FALSE(mapping.isModified());
+  EXPECT_EQ(0, std::memcmp(mapping.data(), "hello", 5));
+}
+
+TEST(FileMapping, FifoDoesNotBlock)
+{
+  const char* fn = "test_mapping.fifo";
+  ::unlink(fn);
+  ASSERT_EQ(0, ::mkfifo(fn, 0600));
+
+  // A FIFO without writers must not block
+  FileMapping mapping;
+  EXPECT_FALSE(mapping.open(fn));
+  EXPECT_FALSE(mapping.isOpen());
+
+  ::unlink(fn);
+}
+
+#endif
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
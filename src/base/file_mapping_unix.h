@@ -0,0 +1,82 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace base {
+
+static void get_stat_stamp(const struct stat& sts, FileMappingStamp& stamp)
+{
+  stamp.device = std::uint64_t(sts.st_dev);
+  stamp.inode = std::uint64_t(sts.st_ino);
+  stamp.size = std::uint64_t(sts.st_size);
+#if __APPLE__
+  const struct timespec& mtime = sts.st_mtimespec;
+#else
+  const struct timespec& mtime = sts.st_mtim;
+#endif
+  stamp.mtime = std::uint64_t(mtime.tv_sec) * 1000000000 + mtime.tv_nsec;
+}
+
+static bool get_file_stamp(const std::string& filename, FileMappingStamp& stamp)
+{
+  struct stat sts;
+  if (::stat(filename.c_str(), &sts) != 0)
+    return false;
+
+  get_stat_stamp(sts, stamp);
+  return true;
+}
+
+static bool map_file(const std::string& filename,
+                     const uint8_t*& data, std::size_t& size,
+                     FileMappingStamp& stamp)
+{
+  // Special files are discarded before opening them (e.g. opening a
+  // FIFO blocks until there is a writer).
+  struct stat sts;
+  if (::stat(filename.c_str(), &sts) != 0 ||
+      !S_ISREG(sts.st_mode))
+    return false;
+
+  // The file could be replaced between stat() and open(), so we use
+  // O_NONBLOCK and check the opened file again.
+  int fd = ::open(filename.c_str(), O_RDONLY | O_NONBLOCK);
+  if (fd == -1)
+    return false;
+
+  if (fstat(fd, &sts) != 0 ||
+      !S_ISREG(sts.st_mode) ||
+      sts.st_size <= 0 ||
+      std::uint64_t(sts.st_size) > std::uint64_t(SIZE_MAX)) {
+    ::close(fd);
+    return false;
+  }
+
+  void* ptr = mmap(nullptr, std::size_t(sts.st_size),
+                   PROT_READ, MAP_PRIVATE, fd, 0);
+
+  // The mapping is still valid after closing the file descriptor
+  ::close(fd);
+
+  if (ptr == MAP_FAILED)
+    return false;
+
+  data = (const uint8_t*)ptr;
+  size = std::size_t(sts.st_size);
+  get_stat_stamp(sts, stamp);
+  return true;
+}
+
+static void unmap_file(const uint8_t* data, std::size_t size)
+{
+  munmap((void*)data, size);
+}
+
+} // namespace base
@@ -0,0 +1,84 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "base/string.h"
+
+#include <windows.h>
+
+namespace base {
+
+static bool get_handle_stamp(HANDLE file, FileMappingStamp& stamp)
+{
+  BY_HANDLE_FILE_INFORMATION info;
+  if (!GetFileInformationByHandle(file, &info))
+    return false;
+
+  stamp.device = info.dwVolumeSerialNumber;
+  stamp.inode = (std::uint64_t(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+  stamp.size = (std::uint64_t(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+  stamp.mtime = (std::uint64_t(info.ftLastWriteTime.dwHighDateTime) << 32) |
+    info.ftLastWriteTime.dwLowDateTime;
+  return true;
+}
+
+static bool get_file_stamp(const std::string& filename, FileMappingStamp& stamp)
+{
+  // Without access rights, just to read the attributes
+  HANDLE file = CreateFileW(from_utf8(filename).c_str(),
+                            0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  bool result = get_handle_stamp(file, stamp);
+  CloseHandle(file);
+  return result;
+}
+
+static bool map_file(const std::string& filename,
+                     const uint8_t*& data, std::size_t& size,
+                     FileMappingStamp& stamp)
+{
+  HANDLE file = CreateFileW(from_utf8(filename).c_str(),
+                            GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+  if (GetFileType(file) != FILE_TYPE_DISK ||
+      !GetFileSizeEx(file, &fileSize) ||
+      fileSize.QuadPart <= 0 ||
+      ULONGLONG(fileSize.QuadPart) > ULONGLONG(SIZE_MAX) ||
+      !get_handle_stamp(file, stamp)) {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  void* ptr = NULL;
+  if (mapping) {
+    ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    // The view keeps a reference to the mapping and the file
+    CloseHandle(mapping);
+  }
+  CloseHandle(file);
+
+  if (!ptr)
+    return false;
+
+  data = (const uint8_t*)ptr;
+  size = std::size_t(fileSize.QuadPart);
+  return true;
+}
+
+static void unmap_file(const uint8_t* data, std::size_t size)
+{
+  UnmapViewOfFile(data);
+}
+
+} // namespace base
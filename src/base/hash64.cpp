@@ -0,0 +1,194 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "base/hash64.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define BASE_HASH64_SSE2 1
+  #include <emmintrin.h>
+#endif
+
+namespace base {
+
+namespace {
+
+const uint64_t kPrime32 = 0x9E3779B1ULL;
+const uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+
+// Number of stripes accumulated between scrambles of the lanes.
+const std::size_t kStripesPerBlock = 16;
+
+alignas(16) const uint64_t kAccumulateKey[8] = {
+  0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL,
+  0xDB979083E96DD4DEULL, 0x1F67B3B7A4A44072ULL,
+  0x78E5C0CC4EE679CBULL, 0x2172FFCC7DD05A82ULL,
+  0x8E2443F7744608B8ULL, 0x4C263A81E69035E0ULL
+};
+
+alignas(16) const uint64_t kScrambleKey[8] = {
+  0xCB00C391BB52283CULL, 0xA32E531B8B65D088ULL,
+  0x4EF90DA297486471ULL, 0xD8ACDEA946EF1938ULL,
+  0x3F349CE33F76FAA8ULL, 0x1D4F0BC7C7BBDCF9ULL,
+  0x3159B4CD4BE0518AULL, 0x647378D9C97E9FC8ULL
+};
+
+inline uint64_t read64(const uint8_t* p)
+{
+  return
+    (uint64_t(p[0])      ) | (uint64_t(p[1]) <<  8) |
+    (uint64_t(p[2]) << 16) | (uint64_t(p[3]) << 24) |
+    (uint64_t(p[4]) << 32) | (uint64_t(p[5]) << 40) |
+    (uint64_t(p[6]) << 48) | (uint64_t(p[7]) << 56);
+}
+
+inline uint64_t avalanche(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= kPrime64_2;
+  h ^= h >> 29;
+  h *= kPrime64_1;
+  h ^= h >> 32;
+  return h;
+}
+
+inline void accumulate(uint64_t* acc, const uint8_t* data)
+{
+#ifdef BASE_HASH64_SSE2
+  __m128i* xacc = (__m128i*)acc;
+  for (int i=0; i<4; ++i) {
+    __m128i d = _mm_loadu_si128((const __m128i*)(data + 16*i));
+    __m128i k = _mm_load_si128((const __m128i*)(kAccumulateKey + 2*i));
+    __m128i dk = _mm_xor_si128(d, k);
+    __m128i product = _mm_mul_epu32(dk, _mm_shuffle_epi32(dk, _MM_SHUFFLE(0, 3, 0, 1)));
+    __m128i swapped = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+    xacc[i] = _mm_add_epi64(xacc[i], _mm_add_epi64(product, swapped));
+  }
+#else
+  for (int i=0; i<8; ++i) {
+    uint64_t d = read64(data + 8*i);
+    uint64_t k = d ^ kAccumulateKey[i];
+    acc[i ^ 1] += d;
+    acc[i] += (k & 0xffffffff) * (k >> 32);
+  }
+#endif
+}
+
+inline void scramble(uint64_t* acc)
+{
+#ifdef BASE_HASH64_SSE2
+  __m128i* xacc = (__m128i*)acc;
+  const __m128i prime = _mm_set1_epi32(int(kPrime32));
+  for (int i=0; i<4; ++i) {
+    __m128i a = xacc[i];
+    a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+    a = _mm_xor_si128(a, _mm_load_si128((const __m128i*)(kScrambleKey + 2*i)));
+    __m128i lo = _mm_mul_epu32(a, prime);
+    __m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), prime);
+    xacc[i] = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+  }
+#else
+  for (int i=0; i<8; ++i) {
+    uint64_t a = acc[i];
+    a ^= a >> 47;
+    a ^= kScrambleKey[i];
+    acc[i] = a * kPrime32;
+  }
+#endif
+}
+
+} // anonymous namespace
+
+Hash64::Hash64(uint64_t seed)
+  : m_seed(seed)
+  , m_totalSize(0)
+  , m_stripes(0)
+  , m_bufferSize(0)
+{
+  for (int i=0; i<8; ++i)
+    m_acc[i] = kScrambleKey[i] ^ (seed + i*kPrime64_1);
+}
+
+void Hash64::update(const void* data, std::size_t size)
+{
+  const uint8_t* p = (const uint8_t*)data;
+  m_totalSize += size;
+
+  // Complete the pending stripe
+  if (m_bufferSize > 0) {
+    std::size_t n = std::min(size, StripeSize - m_bufferSize);
+    std::memcpy(m_buffer+m_bufferSize, p, n);
+    m_bufferSize += n;
+    p += n;
+    size -= n;
+
+    if (m_bufferSize < StripeSize)
+      return;
+
+    processStripes(m_buffer, 1);
+    m_bufferSize = 0;
+  }
+
+  // Process full stripes directly from the given memory
+  std::size_t stripes = size / StripeSize;
+  if (stripes > 0) {
+    processStripes(p, stripes);
+    p += stripes*StripeSize;
+    size -= stripes*StripeSize;
+  }
+
+  if (size > 0) {
+    std::memcpy(m_buffer, p, size);
+    m_bufferSize = size;
+  }
+}
+
+uint64_t Hash64::digest() const
+{
+  alignas(16) uint64_t acc[8];
+  std::copy(m_acc, m_acc+8, acc);
+
+  if (m_bufferSize > 0) {
+    uint8_t last[StripeSize];
+    std::memcpy(last, m_buffer, m_bufferSize);
+    std::memset(last+m_bufferSize, 0, StripeSize-m_bufferSize);
+    accumulate(acc, last);
+  }
+  scramble(acc);
+
+  uint64_t h = m_seed ^ (m_totalSize * kPrime64_1);
+  for (int i=0; i<8; ++i)
+    h = (h ^ avalanche(acc[i])) * kPrime64_1 + kPrime64_2;
+  return avalanche(h);
+}
+
+// static
+uint64_t Hash64::calculate(const void* data, std::size_t size, uint64_t seed)
+{
+  Hash64 hash(seed);
+  hash.update(data, size);
+  return hash.digest();
+}
+
+void Hash64::processStripes(const uint8_t* data, std::size_t stripes)
+{
+  for (; stripes > 0; --stripes, data += StripeSize) {
+    accumulate(m_acc, data);
+    if (++m_stripes == kStripesPerBlock) {
+      scramble(m_acc);
+      m_stripes = 0;
+    }
+  }
+}
+
+} // namespace base
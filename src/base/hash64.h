@@ -0,0 +1,45 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace base {
+
+  // Fast non-cryptographic 64-bit hash to compare big memory blocks
+  // (e.g. image pixels). The main loop processes 64 bytes per step
+  // in 8 independent lanes (using SSE2 when it's available), and it
+  // gives the same result with or without SIMD support.
+  //
+  // Data can be given in several chunks with update(): the result is
+  // the same as hashing all the chunks concatenated in one call.
+  class Hash64 {
+  public:
+    enum { StripeSize = 64 };
+
+    explicit Hash64(uint64_t seed = 0);
+
+    void update(const void* data, std::size_t size);
+    uint64_t digest() const;
+
+    // Hashes one memory block in one call.
+    static uint64_t calculate(const void* data, std::size_t size,
+                              uint64_t seed = 0);
+
+  private:
+    void processStripes(const uint8_t* data, std::size_t stripes);
+
+    alignas(16) uint64_t m_acc[8];
+    uint64_t m_seed;
+    uint64_t m_totalSize;
+    std::size_t m_stripes;      // Stripes accumulated since the last scramble
+    std::size_t m_bufferSize;
+    uint8_t m_buffer[StripeSize];
+  };
+
+} // namespace base
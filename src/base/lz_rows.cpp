@@ -0,0 +1,208 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "base/lz_rows.h"
+
+#include <cstring>
+
+// Format of each row: a list of sequences, each one is
+//
+//   token                 High 4 bits = number of literals,
+//                         low 4 bits = match length - 4
+//   [extra literals]      If the number of literals is >= 15
+//   literals
+//   offset                Variable-length integer, only if the row
+//                         isn't completed with the literals
+//   [extra match length]  If the match length - 4 is >= 15
+//
+// The offset is the distance from the current position to the
+// source of the match, where the previous row is just before the
+// current one.
+
+namespace base {
+
+namespace {
+
+const int kHashBits = 12;
+const std::size_t kMinMatch = 4;
+
+inline uint32_t hash4(uint32_t seq)
+{
+  return (seq * 2654435761u) >> (32 - kHashBits);
+}
+
+} // anonymous namespace
+
+LzRowsWriter::LzRowsWriter(buffer& output)
+  : m_output(output)
+  , m_table(std::size_t(1) << kHashBits, 0)
+  , m_row(nullptr)
+  , m_prevRow(nullptr)
+  , m_pos(0)
+  , m_prevSize(0)
+{
+}
+
+void LzRowsWriter::writeRow(const uint8_t* row, std::size_t size)
+{
+  m_row = row;
+
+  const std::size_t prevPos = m_pos - m_prevSize;
+  std::size_t anchor = 0;
+  std::size_t i = 0;
+
+  while (i + kMinMatch <= size) {
+    uint32_t seq;
+    std::memcpy(&seq, row+i, 4);
+
+    std::size_t& entry = m_table[hash4(seq)];
+    std::size_t candidate = entry;
+    entry = m_pos + i + 1;
+
+    if (candidate > prevPos) {
+      --candidate;
+
+      std::size_t len = 0;
+      while (i+len < size && byteAt(candidate+len) == row[i+len])
+        ++len;
+
+      if (len >= kMinMatch) {
+        writeSequence(row+anchor, i-anchor, m_pos+i-candidate, len);
+        i += len;
+        anchor = i;
+        continue;
+      }
+    }
+    ++i;
+  }
+
+  if (anchor < size)
+    writeSequence(row+anchor, size-anchor, 0, 0);
+
+  m_prevRow = row;
+  m_prevSize = size;
+  m_pos += size;
+}
+
+void LzRowsWriter::writeSequence(const uint8_t* literals, std::size_t nliterals,
+                                 std::size_t offset, std::size_t matchLength)
+{
+  const std::size_t extraMatch = (matchLength ? matchLength - kMinMatch: 0);
+
+  m_output.push_back(
+    uint8_t(((nliterals < 15 ? nliterals: 15) << 4) |
+            (extraMatch < 15 ? extraMatch: 15)));
+
+  if (nliterals >= 15)
+    writeLength(nliterals - 15);
+  m_output.insert(m_output.end(), literals, literals+nliterals);
+
+  if (matchLength) {
+    for (; offset >= 0x80; offset >>= 7)
+      m_output.push_back(uint8_t(offset | 0x80));
+    m_output.push_back(uint8_t(offset));
+
+    if (extraMatch >= 15)
+      writeLength(extraMatch - 15);
+  }
+}
+
+void LzRowsWriter::writeLength(std::size_t length)
+{
+  for (; length >= 255; length -= 255)
+    m_output.push_back(255);
+  m_output.push_back(uint8_t(length));
+}
+
+uint8_t LzRowsWriter::byteAt(std::size_t pos) const
+{
+  if (pos < m_pos)
+    return m_prevRow[pos - (m_pos - m_prevSize)];
+  else
+    return m_row[pos - m_pos];
+}
+
+LzRowsReader::LzRowsReader(const uint8_t* data, std::size_t size)
+  : m_data(data)
+  , m_end(data+size)
+  , m_prevRow(nullptr)
+  , m_prevSize(0)
+{
+}
+
+bool LzRowsReader::readRow(uint8_t* row, std::size_t size)
+{
+  std::size_t i = 0;
+
+  while (i < size) {
+    if (m_data == m_end)
+      return false;
+
+    const uint8_t token = *(m_data++);
+
+    std::size_t nliterals = (token >> 4);
+    if (nliterals == 15 && !readLength(nliterals))
+      return false;
+    if (nliterals > size-i || nliterals > std::size_t(m_end-m_data))
+      return false;
+
+    std::memcpy(row+i, m_data, nliterals);
+    m_data += nliterals;
+    i += nliterals;
+    if (i == size)
+      break;
+
+    std::size_t offset = 0;
+    for (int shift=0; ; shift += 7) {
+      if (m_data == m_end || shift > 56)
+        return false;
+      const uint8_t b = *(m_data++);
+      offset |= std::size_t(b & 0x7f) << shift;
+      if (!(b & 0x80))
+        break;
+    }
+
+    std::size_t len = (token & 15);
+    if (len == 15 && !readLength(len))
+      return false;
+    len += kMinMatch;
+
+    if (offset == 0 || offset > m_prevSize+i || len > size-i)
+      return false;
+
+    // Bytes from the previous row
+    for (; len > 0 && offset > i; --len, ++i)
+      row[i] = m_prevRow[m_prevSize + i - offset];
+
+    // Bytes from the current row (the source can overlap the
+    // destination to repeat a pattern)
+    const uint8_t* src = row+i-offset;
+    for (; len > 0; --len, ++i)
+      row[i] = *(src++);
+  }
+
+  m_prevRow = row;
+  m_prevSize = size;
+  return true;
+}
+
+bool LzRowsReader::readLength(std::size_t& length)
+{
+  uint8_t b;
+  do {
+    if (m_data == m_end)
+      return false;
+    b = *(m_data++);
+    length += b;
+  } while (b == 255);
+  return true;
+}
+
+} // namespace base
@@ -0,0 +1,68 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include "base/buffer.h"
+#include "base/disable_copying.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace base {
+
+  // Fast LZ77 compression for a sequence of rows of pixels (e.g. the
+  // saved pixels of an undo command). Each row can copy bytes from
+  // itself or from the previous row, so areas with flat colors or
+  // repeated rows are compressed a lot.
+  //
+  // Rows must be read (with LzRowsReader) with the same sizes and in
+  // the same order they were written (with LzRowsWriter). The
+  // previous row given to writeRow() (and the one filled by
+  // readRow()) must be kept in memory until the next row is
+  // written/read, but rows don't need to be contiguous in memory.
+  class LzRowsWriter {
+  public:
+    explicit LzRowsWriter(buffer& output);
+
+    void writeRow(const uint8_t* row, std::size_t size);
+
+  private:
+    void writeSequence(const uint8_t* literals, std::size_t nliterals,
+                       std::size_t offset, std::size_t matchLength);
+    void writeLength(std::size_t length);
+    uint8_t byteAt(std::size_t pos) const;
+
+    buffer& m_output;
+    std::vector<std::size_t> m_table; // Last position+1 of each hash
+    const uint8_t* m_row;
+    const uint8_t* m_prevRow;
+    std::size_t m_pos;                // Position of the current row
+    std::size_t m_prevSize;
+
+    DISABLE_COPYING(LzRowsWriter);
+  };
+
+  class LzRowsReader {
+  public:
+    LzRowsReader(const uint8_t* data, std::size_t size);
+
+    // Returns false if the compressed data is corrupted.
+    bool readRow(uint8_t* row, std::size_t size);
+
+  private:
+    bool readLength(std::size_t& length);
+
+    const uint8_t* m_data;
+    const uint8_t* m_end;
+    const uint8_t* m_prevRow;
+    std::size_t m_prevSize;
+
+    DISABLE_COPYING(LzRowsReader);
+  };
+
+} // namespace base
@@ -0,0 +1,114 @@
+// Aseprite Base Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include <gtest/gtest.h>
+
+#include "base/lz_rows.h"
+
+#include <cstdlib>
+
+using namespace base;
+
+namespace {
+
+typedef std::vector<buffer> Rows;
+
+buffer compress(const Rows& rows)
+{
+  buffer output;
+  LzRowsWriter writer(output);
+  for (const auto& row : rows)
+    writer.writeRow(row.data(), row.size());
+  return output;
+}
+
+void expect_decompress(const Rows& rows, const buffer& data)
+{
+  Rows result;
+  for (const auto& row : rows)
+    result.push_back(buffer(row.size(), 0xcd));
+
+  LzRowsReader reader(data.data(), data.size());
+  for (auto& row : result)
+    ASSERT_TRUE(reader.readRow(row.data(), row.size()));
+
+  EXPECT_EQ(rows, result);
+}
+
+} // anonymous namespace
+
+TEST(LzRows, RandomData)
+{
+  std::srand(1);
+  Rows rows;
+  for (int i=0; i<50; ++i) {
+    buffer row(std::rand() % 300);
+    for (auto& b : row)
+      b = std::rand() % (i < 25 ? 4: 256);
+    rows.push_back(row);
+  }
+  expect_decompress(rows, compress(rows));
+}
+
+TEST(LzRows, FlatColors)
+{
+  Rows rows;
+  for (int y=0; y<256; ++y) {
+    buffer row(4*512);
+    for (int x=0; x<512; ++x) {
+      uint8_t c = (x < 100 || y < 30 ? 0: 255);
+      row[4*x  ] = c;
+      row[4*x+1] = 128;
+      row[4*x+2] = c/2;
+      row[4*x+3] = 255;
+    }
+    rows.push_back(row);
+  }
+
+  buffer data = compress(rows);
+  EXPECT_LT(data.size()*50, 256*4*512);
+  expect_decompress(rows, data);
+}
+
+TEST(LzRows, RepeatedRows)
+{
+  std::srand(2);
+  buffer pattern(1000);
+  for (auto& b : pattern)
+    b = std::rand() % 256;
+
+  Rows rows(20, pattern);
+  rows.insert(rows.begin()+10, buffer());
+
+  buffer data = compress(rows);
+  // Only the first row and the row after the empty one are stored
+  EXPECT_LT(data.size(), 2*pattern.size() + 20*16);
+  expect_decompress(rows, data);
+}
+
+TEST(LzRows, CorruptedData)
+{
+  Rows rows(4, buffer(100, 7));
+  buffer data = compress(rows);
+  data.resize(data.size()-1);
+
+  buffer row(100);
+  LzRowsReader reader(data.data(), data.size());
+  bool ok = true;
+  for (int i=0; i<4 && ok; ++i)
+    ok = reader.readRow(row.data(), row.size());
+  EXPECT_FALSE(ok);
+
+  buffer garbage(64, 0xff);
+  LzRowsReader reader2(garbage.data(), garbage.size());
+  EXPECT_FALSE(reader2.readRow(row.data(), row.size()));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
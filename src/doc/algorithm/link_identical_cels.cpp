@@ -0,0 +1,97 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/algorithm/link_identical_cels.h"
+
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace doc {
+namespace algorithm {
+
+namespace {
+
+bool is_same_cel_data(const CelData* a, const CelData* b)
+{
+  return (a->position() == b->position() &&
+          a->opacity() == b->opacity() &&
+          a->userData() == b->userData() &&
+          is_same_image(a->image(), b->image()));
+}
+
+} // anonymous namespace
+
+std::size_t link_identical_cels(LayerImage* layer)
+{
+  std::size_t released = 0;
+
+  // Cels grouped by image content hash (only the first cel of each
+  // different CelData is stored).
+  std::unordered_multimap<uint64_t, Cel*> candidates;
+  candidates.reserve(layer->getCelsCount());
+
+  CelIterator it = layer->getCelBegin();
+  CelIterator end = layer->getCelEnd();
+  for (; it != end; ++it) {
+    Cel* cel = it->get();
+    uint64_t hash = cel->image()->contentHash();
+
+    Cel* original = nullptr;
+    auto range = candidates.equal_range(hash);
+    for (auto jt=range.first; jt!=range.second; ++jt) {
+      if (jt->second->data() == cel->data() ||
+          is_same_cel_data(jt->second->data(), cel->data())) {
+        original = jt->second;
+        break;
+      }
+    }
+
+    if (!original) {
+      candidates.insert(std::make_pair(hash, cel));
+      continue;
+    }
+
+    if (original->data() == cel->data())
+      continue;
+
+    CelDataRef oldData = cel->dataRef();
+    cel->setDataRef(original->dataRef());
+
+    // If we were the last owner of the old CelData, its memory will
+    // be released with "oldData".
+    if (oldData.unique())
+      released += oldData->getMemSize();
+  }
+
+  return released;
+}
+
+std::size_t link_identical_cels(Sprite* sprite)
+{
+  std::size_t released = 0;
+
+  std::vector<Layer*> layers;
+  sprite->getLayersList(layers);
+  for (Layer* layer : layers) {
+    if (layer->isImage())
+      released += link_identical_cels(static_cast<LayerImage*>(layer));
+  }
+
+  return released;
+}
+
+} // namespace algorithm
+} // namespace doc
@@ -0,0 +1,27 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include <cstddef>
+
+namespace doc {
+  class LayerImage;
+  class Sprite;
+
+  namespace algorithm {
+
+    // Converts cels with the same pixels, position, opacity and user
+    // data (inside the same layer) into linked cels which share the
+    // CelData of the first one. It doesn't create undo information,
+    // so it's meant to be used on recently loaded sprites.
+    //
+    // Returns the approximate number of bytes that were released.
+    std::size_t link_identical_cels(LayerImage* layer);
+    std::size_t link_identical_cels(Sprite* sprite);
+
+  } // algorithm
+} // doc
@@ -0,0 +1,285 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/bitmap_ops.h"
+
+#include "base/base.h"
+#include "base/debug.h"
+#include "doc/image.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace doc {
+
+namespace {
+
+inline uint64_t load64(const uint8_t* p)
+{
+#ifdef ASEPRITE_BIG_ENDIAN
+  uint64_t v = 0;
+  for (int i=7; i>=0; --i)
+    v = (v << 8) | p[i];
+  return v;
+#else
+  uint64_t v;
+  std::memcpy(&v, p, 8);
+  return v;
+#endif
+}
+
+inline void store64(uint8_t* p, uint64_t v)
+{
+#ifdef ASEPRITE_BIG_ENDIAN
+  for (int i=0; i<8; ++i, v >>= 8)
+    p[i] = uint8_t(v);
+#else
+  std::memcpy(p, &v, 8);
+#endif
+}
+
+// Loads up to 8 bytes from "p", bytes at "end" or after are zero.
+inline uint64_t load64(const uint8_t* p, const uint8_t* end)
+{
+  if (end - p >= 8)
+    return load64(p);
+
+  uint64_t v = 0;
+  for (int i=0; p+i < end; ++i)
+    v |= uint64_t(p[i]) << (8*i);
+  return v;
+}
+
+// Reads 64 bits from the row starting at bit "pos".
+inline uint64_t read_bits(const uint8_t* row, int pos, const uint8_t* end)
+{
+  const uint8_t* p = row + (pos >> 3);
+  const int shift = (pos & 7);
+  uint64_t v = load64(p, end);
+  if (shift) {
+    v >>= shift;
+    if (p+8 < end)
+      v |= uint64_t(p[8]) << (64-shift);
+  }
+  return v;
+}
+
+inline uint64_t low_bits_mask(int n)
+{
+  return (n >= 64 ? ~uint64_t(0): (uint64_t(1) << n) - 1);
+}
+
+// Writes the first "n" bits (n <= 64) of "bits" in the row starting
+// at bit "pos". Other bits of the row are kept.
+void write_bits(uint8_t* row, int pos, uint64_t bits, int n)
+{
+  uint8_t* p = row + (pos >> 3);
+  int shift = (pos & 7);
+  uint64_t mask = low_bits_mask(n);
+  bits &= mask;
+
+  for (int remaining = shift+n; remaining > 0; remaining -= 8, ++p) {
+    uint8_t byteMask, byteBits;
+    if (shift) {
+      byteMask = uint8_t(mask << shift);
+      byteBits = uint8_t(bits << shift);
+      mask >>= (8-shift);
+      bits >>= (8-shift);
+      shift = 0;
+    }
+    else {
+      byteMask = uint8_t(mask);
+      byteBits = uint8_t(bits);
+      mask >>= 8;
+      bits >>= 8;
+    }
+    *p = (*p & ~byteMask) | byteBits;
+  }
+}
+
+inline int row_bytes(int w)
+{
+  return (w+7) / 8;
+}
+
+} // anonymous namespace
+
+void bitmap_fill_row(uint8_t* row, int x1, int x2, bool value)
+{
+  ASSERT(x1 <= x2);
+
+  uint8_t* p1 = row + (x1 >> 3);
+  uint8_t* p2 = row + (x2 >> 3);
+  uint8_t mask1 = uint8_t(0xff << (x1 & 7));
+  uint8_t mask2 = uint8_t(0xff >> (7 - (x2 & 7)));
+
+  if (p1 == p2) {
+    mask1 &= mask2;
+    if (value) *p1 |= mask1; else *p1 &= ~mask1;
+    return;
+  }
+
+  if (value) *p1 |= mask1; else *p1 &= ~mask1;
+  if (p2 - p1 > 1)
+    std::memset(p1+1, (value ? 0xff: 0), p2-p1-1);
+  if (value) *p2 |= mask2; else *p2 &= ~mask2;
+}
+
+void bitmap_copy_row(uint8_t* dst, int dstX,
+                     const uint8_t* src, int srcX, int w)
+{
+  if (w <= 0)
+    return;
+
+  const uint8_t* srcEnd = src + row_bytes(srcX+w);
+
+  // Bits until "dst" is aligned to a byte
+  int head = std::min((8 - (dstX & 7)) & 7, w);
+  if (head > 0) {
+    write_bits(dst, dstX, read_bits(src, srcX, srcEnd), head);
+    dstX += head;
+    srcX += head;
+    w -= head;
+  }
+
+  uint8_t* d = dst + (dstX >> 3);
+  if ((srcX & 7) == 0) {
+    // Both rows are aligned, we can copy whole bytes
+    int n = (w >> 3);
+    std::memmove(d, src + (srcX >> 3), n);
+    d += n;
+    srcX += 8*n;
+    dstX += 8*n;
+    w -= 8*n;
+  }
+  else {
+    for (; w >= 64; w -= 64, d += 8, srcX += 64, dstX += 64)
+      store64(d, read_bits(src, srcX, srcEnd));
+    for (; w >= 8; w -= 8, ++d, srcX += 8, dstX += 8)
+      *d = uint8_t(read_bits(src, srcX, srcEnd));
+  }
+
+  if (w > 0)
+    write_bits(dst, dstX, read_bits(src, srcX, srcEnd), w);
+}
+
+void bitmap_invert_row(uint8_t* row, int w)
+{
+  const int n = row_bytes(w);
+  int i = 0;
+  for (; i+8 <= n; i += 8)
+    store64(row+i, ~load64(row+i));
+  for (; i < n; ++i)
+    row[i] = ~row[i];
+
+  if (w & 7)
+    row[n-1] &= uint8_t((1 << (w & 7)) - 1);
+}
+
+bool bitmap_is_full_row(const uint8_t* row, int w)
+{
+  const int n = (w >> 3);
+  int i = 0;
+  for (; i+8 <= n; i += 8)
+    if (load64(row+i) != ~uint64_t(0))
+      return false;
+  for (; i < n; ++i)
+    if (row[i] != 0xff)
+      return false;
+
+  if (w & 7) {
+    uint8_t mask = uint8_t((1 << (w & 7)) - 1);
+    if ((row[n] & mask) != mask)
+      return false;
+  }
+  return true;
+}
+
+bool bitmap_row_bounds(const uint8_t* row, int w, int& x1, int& x2)
+{
+  const int n = row_bytes(w);
+  const uint8_t lastMask = ((w & 7) ? uint8_t((1 << (w & 7)) - 1): 0xff);
+  auto byteAt = [row, n, lastMask](int i) -> uint8_t {
+    return (i == n-1 ? row[i] & lastMask: row[i]);
+  };
+
+  // First set bit
+  int i = 0;
+  while (i+8 <= n-1 && load64(row+i) == 0)
+    i += 8;
+  while (i < n && byteAt(i) == 0)
+    ++i;
+  if (i == n)
+    return false;
+  x1 = 8*i + std::countr_zero(byteAt(i));
+
+  // Last set bit
+  int j = n-1;
+  if (byteAt(j) == 0) {
+    --j;
+    while (j-7 > i && load64(row+j-7) == 0)
+      j -= 8;
+    while (byteAt(j) == 0)
+      --j;
+  }
+  x2 = 8*j + 7 - std::countl_zero(byteAt(j));
+  return true;
+}
+
+BitmapRowSpans::BitmapRowSpans(const Image* bitmap, int y, int x1, int x2)
+  : m_row(bitmap->getPixelAddress(0, y))
+  , m_end(m_row + bitmap->getRowStrideSize())
+  , m_x(std::max(x1, 0))
+  , m_xEnd(std::min(x2+1, bitmap->width()))
+{
+  ASSERT(bitmap->pixelFormat() == IMAGE_BITMAP);
+}
+
+BitmapRowSpans::BitmapRowSpans(const uint8_t* row, int x1, int x2)
+  : m_row(row)
+  , m_end(row + row_bytes(x2+1))
+  , m_x(x1)
+  , m_xEnd(x2+1)
+{
+}
+
+bool BitmapRowSpans::next(int& x1, int& x2)
+{
+  // Find the first set bit
+  for (;;) {
+    if (m_x >= m_xEnd)
+      return false;
+
+    uint64_t bits = read_bits(m_row, m_x, m_end)
+      & low_bits_mask(m_xEnd - m_x);
+    if (bits) {
+      m_x += std::countr_zero(bits);
+      break;
+    }
+    m_x += 64;
+  }
+  x1 = m_x;
+
+  // Find the next zero bit (or the end of the range)
+  for (;;) {
+    uint64_t zeros = ~read_bits(m_row, m_x, m_end)
+      | ~low_bits_mask(m_xEnd - m_x);
+    if (zeros) {
+      m_x += std::countr_zero(zeros);
+      break;
+    }
+    m_x += 64;
+  }
+  x2 = m_x-1;
+  return true;
+}
+
+} // namespace doc
@@ -0,0 +1,60 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include <cstdint>
+
+namespace doc {
+
+  class Image;
+
+  // Low-level operations over rows of 1bpp images (IMAGE_BITMAP),
+  // where pixel "x" is the bit (x%8) of byte (x/8). They work with
+  // whole bytes/64-bit words instead of pixel by pixel.
+
+  // Sets (or clears) the bits from x1 to x2 (inclusive).
+  void bitmap_fill_row(uint8_t* row, int x1, int x2, bool value);
+
+  // Copies "w" bits from "src" (starting at "srcX") to "dst"
+  // (starting at "dstX").
+  void bitmap_copy_row(uint8_t* dst, int dstX,
+                       const uint8_t* src, int srcX, int w);
+
+  // Inverts the first "w" bits of the row. Unused bits of the last
+  // byte are left as 0.
+  void bitmap_invert_row(uint8_t* row, int w);
+
+  // Returns true if the first "w" bits of the row are set.
+  bool bitmap_is_full_row(const uint8_t* row, int w);
+
+  // Gets the first (x1) and the last (x2) set bit in the first "w"
+  // bits of the row. Returns false if there is no set bit.
+  bool bitmap_row_bounds(const uint8_t* row, int w, int& x1, int& x2);
+
+  // Iterates the runs of consecutive set bits (selected pixels) of
+  // one row of a bitmap image inside the [x1, x2] range:
+  //
+  //   BitmapRowSpans spans(bitmap, y, x1, x2);
+  //   int u1, u2;
+  //   while (spans.next(u1, u2)) {
+  //     // Pixels from u1 to u2 (inclusive) are set
+  //   }
+  class BitmapRowSpans {
+  public:
+    BitmapRowSpans(const Image* bitmap, int y, int x1, int x2);
+    BitmapRowSpans(const uint8_t* row, int x1, int x2);
+
+    bool next(int& x1, int& x2);
+
+  private:
+    const uint8_t* m_row;
+    const uint8_t* m_end;
+    int m_x;                    // Next bit to check
+    int m_xEnd;                 // Last bit + 1
+  };
+
+} // namespace doc
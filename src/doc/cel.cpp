@@ -58,6 +58,9 @@ void Cel::setDataRef(const CelDataRef& celData)
 {
   ASSERT(celData);
   m_data = celData;
+
+  if (m_layer)
+    m_layer->invalidateLinks();
 }
 
 void Cel::setPosition(int x, int y)
@@ -126,14 +129,7 @@ std::size_t Cel::links() const
 
 gfx::Rect Cel::bounds() const
 {
-  auto image = this->image();
-  ASSERT(image);
-  if (image)
-    return gfx::Rect(
-      position().x, position().y,
-      image->width(), image->height());
-  else
-    return gfx::Rect();
+  return m_data->bounds();
 }
 
 void Cel::setParentLayer(LayerImage* layer)
@@ -144,8 +140,9 @@ void Cel::setParentLayer(LayerImage* layer)
 
 void Cel::fixupImage()
 {
-  // Change the mask color to the sprite mask color
-  if (m_layer && image())
+  // Change the mask color to the sprite mask color (pending images
+  // are created with the right mask color by their ImageLoader)
+  if (m_layer && !m_data->hasPendingImage() && image())
     image()->setMaskColor(m_layer->sprite()->transparentColor());
 }
 
@@ -22,22 +22,80 @@ CelData::CelData(const ImageRef& image)
   , m_image(image)
   , m_position(0, 0)
   , m_opacity(255)
+  , m_pending(false)
 {
 }
 
 CelData::CelData(const CelData& celData)
   : WithUserData(ObjectType::CelData)
-  , m_image(celData.m_image)
+  , m_image(celData.imageRef()) // The copy shares the same image
   , m_position(celData.m_position)
   , m_opacity(celData.m_opacity)
+  , m_pending(false)
 {
 }
 
+gfx::Rect CelData::bounds() const
+{
+  if (hasPendingImage())
+    return gfx::Rect(m_position, m_pendingSize);
+
+  ASSERT(m_image);
+  if (m_image)
+    return gfx::Rect(m_position.x, m_position.y,
+                     m_image->width(), m_image->height());
+  else
+    return gfx::Rect();
+}
+
 void CelData::setImage(const ImageRef& image)
 {
   ASSERT(image.get());
 
+  std::lock_guard<std::mutex> lock(m_loadMutex);
   m_image = image;
+  m_loader.reset();
+  m_pending.store(false, std::memory_order_release);
+}
+
+void CelData::setPendingImage(const gfx::Size& size, const ImageLoaderPtr& loader)
+{
+  ASSERT(loader);
+
+  std::lock_guard<std::mutex> lock(m_loadMutex);
+  m_image.reset();
+  m_loader = loader;
+  m_pendingSize = size;
+  m_pending.store(true, std::memory_order_release);
+}
+
+int CelData::getMemSize() const
+{
+  // Pending images don't use memory yet
+  if (hasPendingImage())
+    return sizeof(CelData);
+
+  ASSERT(m_image);
+  return sizeof(CelData) + m_image->getMemSize();
+}
+
+void CelData::loadPendingImage() const
+{
+  std::lock_guard<std::mutex> lock(m_loadMutex);
+
+  // Other thread could load the image while we were waiting the lock
+  if (!m_pending.load(std::memory_order_relaxed))
+    return;
+
+  m_image = m_loader->loadImage();
+  ASSERT(m_image);
+  ASSERT(m_image->width() == m_pendingSize.w);
+  ASSERT(m_image->height() == m_pendingSize.h);
+
+  // The loader can keep resources (e.g. the file mapping), so it's
+  // released as soon as possible
+  m_loader.reset();
+  m_pending.store(false, std::memory_order_release);
 }
 
 } // namespace doc
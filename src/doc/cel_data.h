@@ -7,9 +7,15 @@
 #pragma once
 
 #include "base/shared_ptr.h"
+#include "doc/image_loader.h"
 #include "doc/image_ref.h"
 #include "doc/object.h"
 #include "doc/with_user_data.h"
+#include "gfx/rect.h"
+#include "gfx/size.h"
+
+#include <atomic>
+#include <mutex>
 
 namespace doc {
 
@@ -20,10 +26,27 @@ namespace doc {
 
     const gfx::Point& position() const { return m_position; }
     int opacity() const { return m_opacity; }
-    Image* image() const { return const_cast<Image*>(m_image.get()); };
-    ImageRef imageRef() const { return m_image; }
+    Image* image() const {
+      loadImage();
+      return const_cast<Image*>(m_image.get());
+    }
+    ImageRef imageRef() const {
+      loadImage();
+      return m_image;
+    }
+
+    // Position and size of the image (it doesn't load a pending
+    // image).
+    gfx::Rect bounds() const;
 
     void setImage(const ImageRef& image);
+
+    // The image will be created by the given loader the first time
+    // that image()/imageRef() are called.
+    void setPendingImage(const gfx::Size& size, const ImageLoaderPtr& loader);
+    bool hasPendingImage() const {
+      return m_pending.load(std::memory_order_acquire);
+    }
     void setPosition(int x, int y) {
       m_position.x = x;
       m_position.y = y;
@@ -31,13 +54,20 @@ namespace doc {
     void setPosition(const gfx::Point& pos) { m_position = pos; }
     void setOpacity(int opacity) { m_opacity = opacity; }
 
-    virtual int getMemSize() const override {
-      ASSERT(m_image);
-      return sizeof(CelData) + m_image->getMemSize();
-    }
+    virtual int getMemSize() const override;
 
   private:
-    ImageRef m_image;
+    void loadImage() const {
+      if (hasPendingImage())
+        loadPendingImage();
+    }
+    void loadPendingImage() const;
+
+    mutable ImageRef m_image;
+    mutable ImageLoaderPtr m_loader;
+    gfx::Size m_pendingSize;
+    mutable std::atomic<bool> m_pending;
+    mutable std::mutex m_loadMutex;
     gfx::Point m_position;      // X/Y screen position
     int m_opacity;              // Opacity level
   };
@@ -0,0 +1,134 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/cel.h"
+#include "doc/cel_data.h"
+#include "doc/image.h"
+#include "doc/image_loader.h"
+#include "doc/layer.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace doc;
+
+namespace {
+
+class TestLoader : public ImageLoader {
+public:
+  TestLoader(int w, int h, std::atomic<int>& calls)
+    : m_w(w), m_h(h), m_calls(calls) { }
+
+  ImageRef loadImage() override {
+    ++m_calls;
+    ImageRef image(Image::create(IMAGE_RGB, m_w, m_h));
+    clear_image(image.get(), rgba(255, 0, 0, 255));
+    return image;
+  }
+
+private:
+  int m_w, m_h;
+  std::atomic<int>& m_calls;
+};
+
+} // anonymous namespace
+
+TEST(CelData, PendingImage)
+{
+  std::atomic<int> calls(0);
+  CelDataRef data(new CelData(ImageRef()));
+  data->setPosition(2, 3);
+  data->setPendingImage(gfx::Size(4, 5),
+                        std::make_shared<TestLoader>(4, 5, calls));
+
+  // Bounds and memory size don't load the image
+  EXPECT_TRUE(data->hasPendingImage());
+  EXPECT_EQ(gfx::Rect(2, 3, 4, 5), data->bounds());
+  EXPECT_EQ(int(sizeof(CelData)), data->getMemSize());
+  EXPECT_EQ(0, calls);
+
+  Image* image = data->image();
+  ASSERT_TRUE(image != nullptr);
+  EXPECT_FALSE(data->hasPendingImage());
+  EXPECT_EQ(1, calls);
+  EXPECT_EQ(rgba(255, 0, 0, 255), get_pixel(image, 3, 4));
+  EXPECT_EQ(gfx::Rect(2, 3, 4, 5), data->bounds());
+
+  // The loader is used just once
+  EXPECT_EQ(image, data->imageRef().get());
+  EXPECT_EQ(1, calls);
+}
+
+TEST(CelData, LoadFromSeveralThreads)
+{
+  std::atomic<int> calls(0);
+  CelDataRef data(new CelData(ImageRef()));
+  data->setPendingImage(gfx::Size(32, 32),
+                        std::make_shared<TestLoader>(32, 32, calls));
+
+  std::vector<Image*> images(8, nullptr);
+  std::vector<std::thread> threads;
+  for (int i=0; i<int(images.size()); ++i)
+    threads.emplace_back([&data, &images, i]{ images[i] = data->image(); });
+  for (auto& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(1, calls);
+  for (Image* image : images)
+    EXPECT_EQ(images[0], image);
+}
+
+TEST(CelData, CopyLoadsImage)
+{
+  std::atomic<int> calls(0);
+  CelDataRef data(new CelData(ImageRef()));
+  data->setPendingImage(gfx::Size(4, 4),
+                        std::make_shared<TestLoader>(4, 4, calls));
+
+  CelDataRef copy(new CelData(*data));
+  EXPECT_EQ(1, calls);
+  EXPECT_FALSE(data->hasPendingImage());
+  EXPECT_FALSE(copy->hasPendingImage());
+  EXPECT_EQ(data->image(), copy->image());
+}
+
+TEST(CelData, PendingImageInSprite)
+{
+  std::atomic<int> calls(0);
+  Sprite* spr = new Sprite(IMAGE_RGB, 32, 32, 256);
+  LayerImage* lay = new LayerImage(spr);
+  spr->folder()->addLayer(lay);
+
+  CelDataRef data(new CelData(ImageRef()));
+  data->setPendingImage(gfx::Size(16, 8),
+                        std::make_shared<TestLoader>(16, 8, calls));
+  lay->addCel(std::make_shared<Cel>(frame_t(0), data));
+
+  // Adding the cel and asking for sizes don't load the image
+  EXPECT_EQ(gfx::Rect(0, 0, 16, 8), lay->cel(frame_t(0))->bounds());
+  EXPECT_EQ(16*8*4, spr->getMemSize());
+  EXPECT_EQ(0, calls);
+
+  EXPECT_EQ(16, lay->cel(frame_t(0))->image()->width());
+  EXPECT_EQ(1, calls);
+
+  delete spr;
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -45,8 +45,8 @@ CelsRange::iterator::iterator(const Sprite* sprite, frame_t first, frame_t last,
     }
     layer = layer->getNext();
   }
-  if (m_cel && flags == CelsRange::UNIQUE)
-    m_visited.insert(m_cel->data()->id());
+  if (m_cel)
+    visit(m_cel);
 }
 
 CelsRange::iterator& CelsRange::iterator::operator++()
@@ -63,16 +63,10 @@ CelsRange::iterator& CelsRange::iterator::operator++()
     for (frame_t f=first; f<=m_last; ++f) {
       m_cel = layer->cel(f);
       if (m_cel) {
-        if (m_flags == CelsRange::UNIQUE) {
-          if (m_visited.find(m_cel->data()->id()) == m_visited.end()) {
-            m_visited.insert(m_cel->data()->id());
-            break;
-          }
-          else
-            m_cel = nullptr;
-        }
-        else
+        if (visit(m_cel))
           break;
+        else
+          m_cel = nullptr;
       }
     }
     layer = layer->getNext();
@@ -81,4 +75,15 @@ CelsRange::iterator& CelsRange::iterator::operator++()
   return *this;
 }
 
+bool CelsRange::iterator::visit(const std::shared_ptr<Cel>& cel) const
+{
+  if (m_flags != CelsRange::UNIQUE)
+    return true;
+
+  // Linked cels are always in the same layer, so the cel is the first
+  // one of its CelData in the range if the previous linked cel is
+  // before the range.
+  return (cel->layer()->prevLinkedFrame(cel.get()) < m_first);
+}
+
 } // namespace doc
@@ -9,13 +9,14 @@
 #include "doc/frame.h"
 #include "doc/object_id.h"
 
-#include <set>
 #include <memory>
 
 namespace doc {
   class Cel;
   class Sprite;
 
+  // Iterates cels layer by layer. With UNIQUE flag, linked cels are
+  // returned only once (the first cel of each CelData in the range).
   class CelsRange {
   public:
     enum Flags {
@@ -46,10 +47,11 @@ namespace doc {
       iterator& operator++();
 
     private:
+      bool visit(const std::shared_ptr<Cel>& cel) const;
+
       std::shared_ptr<Cel> m_cel;
       frame_t m_first, m_last;
       Flags m_flags;
-      std::set<ObjectId> m_visited;
     };
 
     iterator begin() { return m_begin; }
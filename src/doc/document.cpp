@@ -10,8 +10,11 @@
 
 #include "doc/document.h"
 
+#include "base/base.h"
 #include "base/path.h"
+#include "doc/cel.h"
 #include "doc/context.h"
+#include "doc/document_event.h"
 #include "doc/sprite.h"
 
 namespace doc {
@@ -20,6 +23,11 @@ Document::Document()
   : Object(ObjectType::Document)
   , m_sprites(this)
   , m_ctx(NULL)
+  , m_batchLevel(0)
+  , m_batchHasEvents(false)
+  , m_batchSprite(NULL)
+  , m_batchFirstFrame(0)
+  , m_batchLastFrame(0)
 {
 }
 
@@ -78,6 +86,59 @@ void Document::close()
   removeFromContext();
 }
 
+void Document::beginNotificationBatch()
+{
+  ++m_batchLevel;
+}
+
+void Document::endNotificationBatch()
+{
+  ASSERT(m_batchLevel > 0);
+  if (--m_batchLevel > 0 || !m_batchHasEvents)
+    return;
+
+  DocumentEvent ev(this);
+  ev.sprite(m_batchSprite);
+  ev.region(m_batchRegion);
+  ev.frame(m_batchFirstFrame);
+  ev.lastFrame(m_batchLastFrame);
+
+  m_batchHasEvents = false;
+  m_batchSprite = NULL;
+  m_batchRegion.clear();
+
+  notifyObservers<DocumentEvent&>(&DocumentObserver::onBatchedChanges, ev);
+}
+
+void Document::notifyCelEvent(void (DocumentObserver::*method)(DocumentEvent&),
+                              DocumentEvent& ev)
+{
+  if (m_batchLevel == 0) {
+    notifyObservers<DocumentEvent&>(method, ev);
+    return;
+  }
+
+  frame_t frame = ev.frame();
+  if (ev.cel()) {
+    frame = ev.cel()->frame();
+    m_batchRegion.createUnion(m_batchRegion, gfx::Region(ev.cel()->bounds()));
+  }
+  if (!ev.region().isEmpty())
+    m_batchRegion.createUnion(m_batchRegion, ev.region());
+
+  if (!m_batchHasEvents) {
+    m_batchHasEvents = true;
+    m_batchFirstFrame = m_batchLastFrame = frame;
+  }
+  else {
+    m_batchFirstFrame = MIN(m_batchFirstFrame, frame);
+    m_batchLastFrame = MAX(m_batchLastFrame, frame);
+  }
+
+  if (ev.sprite())
+    m_batchSprite = ev.sprite();
+}
+
 void Document::onContextChanged()
 {
   // Do nothing
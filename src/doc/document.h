@@ -8,10 +8,13 @@
 
 #include <string>
 
+#include "base/disable_copying.h"
 #include "base/observable.h"
 #include "doc/document_observer.h"
+#include "doc/frame.h"
 #include "doc/object.h"
 #include "doc/sprites.h"
+#include "gfx/region.h"
 
 namespace doc {
 
@@ -42,6 +45,18 @@ namespace doc {
 
     void close();
 
+    // Cel events (added/removed/moved cels, etc.) sent with
+    // notifyCelEvent() between beginNotificationBatch() and
+    // endNotificationBatch() are not sent to observers, they receive
+    // only one DocumentObserver::onBatchedChanges() event with the
+    // combined region and frame range when the outermost batch ends.
+    // Used to avoid one UI update for each cel when thousands of
+    // cels are modified (e.g. undoing a flatten).
+    void beginNotificationBatch();
+    void endNotificationBatch();
+    void notifyCelEvent(void (DocumentObserver::*method)(DocumentEvent&),
+                        DocumentEvent& ev);
+
   protected:
     virtual void onContextChanged();
 
@@ -53,6 +68,31 @@ namespace doc {
     std::string m_filename;
     Sprites m_sprites;
     Context* m_ctx;
+
+    // Accumulated cel events while notifications are batched
+    int m_batchLevel;
+    bool m_batchHasEvents;
+    Sprite* m_batchSprite;
+    gfx::Region m_batchRegion;
+    frame_t m_batchFirstFrame;
+    frame_t m_batchLastFrame;
+  };
+
+  // Batches cel notifications of the document in the current scope.
+  class DocumentNotificationBatch {
+  public:
+    DocumentNotificationBatch(Document* doc) : m_doc(doc) {
+      if (m_doc)
+        m_doc->beginNotificationBatch();
+    }
+    ~DocumentNotificationBatch() {
+      if (m_doc)
+        m_doc->endNotificationBatch();
+    }
+  private:
+    Document* m_doc;
+
+    DISABLE_COPYING(DocumentNotificationBatch);
   };
 
 } // namespace doc
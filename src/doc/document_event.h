@@ -32,6 +32,7 @@ namespace doc {
       , m_image(NULL)
       , m_imageIndex(-1)
       , m_frame(0)
+      , m_lastFrame(0)
       , m_targetLayer(NULL)
       , m_targetFrame(0) {
     }
@@ -46,6 +47,10 @@ namespace doc {
     frame_t frame() const { return m_frame; }
     const gfx::Region& region() const { return m_region; }
 
+    // For onBatchedChanges(), frame() is the first modified frame and
+    // lastFrame() the last one.
+    frame_t lastFrame() const { return m_lastFrame; }
+
     void sprite(Sprite* sprite) { m_sprite = sprite; }
     void layer(Layer* layer) { m_layer = layer; }
     void cel(std::shared_ptr<Cel> cel) { m_cel = cel; }
@@ -53,6 +58,7 @@ namespace doc {
     void imageIndex(int imageIndex) { m_imageIndex = imageIndex; }
     void frame(frame_t frame) { m_frame = frame; }
     void region(const gfx::Region& rgn) { m_region = rgn; }
+    void lastFrame(frame_t frame) { m_lastFrame = frame; }
 
     // Destination of the operation.
     Layer* targetLayer() const { return m_targetLayer; }
@@ -69,6 +75,7 @@ namespace doc {
     Image* m_image;
     int m_imageIndex;
     frame_t m_frame;
+    frame_t m_lastFrame;
     gfx::Region m_region;
 
     // For copy/move commands, the m_layer/m_frame are source of the
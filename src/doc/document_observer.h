@@ -50,6 +50,10 @@ namespace doc {
     virtual void onCelPositionChanged(DocumentEvent& ev) { }
     virtual void onCelOpacityChange(DocumentEvent& ev) { }
 
+    // Summary of the cel events that were batched (see
+    // Document::beginNotificationBatch()).
+    virtual void onBatchedChanges(DocumentEvent& ev) { }
+
     virtual void onFrameDurationChanged(DocumentEvent& ev) { }
 
     virtual void onImagePixelsModified(DocumentEvent& ev) { }
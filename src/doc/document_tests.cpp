@@ -0,0 +1,154 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/cel.h"
+#include "doc/document.h"
+#include "doc/document_event.h"
+#include "doc/document_observer.h"
+#include "doc/image.h"
+#include "doc/sprite.h"
+
+#include <memory>
+
+using namespace doc;
+
+namespace {
+
+class BatchObserver : public DocumentObserver {
+public:
+  int celEvents = 0;
+  int batches = 0;
+  gfx::Rect bounds;
+  frame_t firstFrame = -1;
+  frame_t lastFrame = -1;
+  Sprite* sprite = nullptr;
+
+  void onCelPositionChanged(DocumentEvent& ev) override {
+    ++celEvents;
+  }
+
+  void onBatchedChanges(DocumentEvent& ev) override {
+    ++batches;
+    bounds = ev.region().bounds();
+    firstFrame = ev.frame();
+    lastFrame = ev.lastFrame();
+    sprite = ev.sprite();
+  }
+};
+
+void notify_region(Document& doc, const gfx::Rect& rc, frame_t frame)
+{
+  DocumentEvent ev(&doc);
+  ev.sprite(doc.sprite());
+  ev.region(gfx::Region(rc));
+  ev.frame(frame);
+  doc.notifyCelEvent(&DocumentObserver::onCelPositionChanged, ev);
+}
+
+} // anonymous namespace
+
+TEST(Document, CelEventsWithoutBatch)
+{
+  Document doc;
+  doc.sprites().add(32, 32);
+  BatchObserver obs;
+  doc.addObserver(&obs);
+
+  notify_region(doc, gfx::Rect(0, 0, 4, 4), 1);
+  notify_region(doc, gfx::Rect(8, 8, 4, 4), 2);
+  EXPECT_EQ(2, obs.celEvents);
+  EXPECT_EQ(0, obs.batches);
+
+  doc.removeObserver(&obs);
+}
+
+TEST(Document, NotificationBatch)
+{
+  Document doc;
+  Sprite* spr = doc.sprites().add(32, 32);
+  BatchObserver obs;
+  doc.addObserver(&obs);
+
+  doc.beginNotificationBatch();
+  notify_region(doc, gfx::Rect(2, 3, 4, 4), 5);
+  notify_region(doc, gfx::Rect(10, 12, 2, 2), 2);
+
+  // Cel events use the cel bounds and frame
+  DocumentEvent ev(&doc);
+  ev.sprite(spr);
+  auto cel = std::make_shared<Cel>(frame_t(7), ImageRef(Image::create(IMAGE_RGB, 4, 4)));
+  cel->setPosition(20, 1);
+  ev.cel(cel);
+  doc.notifyCelEvent(&DocumentObserver::onCelPositionChanged, ev);
+
+  EXPECT_EQ(0, obs.celEvents);
+  EXPECT_EQ(0, obs.batches);
+  doc.endNotificationBatch();
+
+  EXPECT_EQ(0, obs.celEvents);
+  EXPECT_EQ(1, obs.batches);
+  EXPECT_EQ(gfx::Rect(2, 1, 22, 13), obs.bounds);
+  EXPECT_EQ(2, obs.firstFrame);
+  EXPECT_EQ(7, obs.lastFrame);
+  EXPECT_EQ(spr, obs.sprite);
+
+  doc.removeObserver(&obs);
+}
+
+TEST(Document, NestedNotificationBatch)
+{
+  Document doc;
+  doc.sprites().add(32, 32);
+  BatchObserver obs;
+  doc.addObserver(&obs);
+
+  {
+    DocumentNotificationBatch outer(&doc);
+    notify_region(doc, gfx::Rect(0, 0, 2, 2), 3);
+    {
+      DocumentNotificationBatch inner(&doc);
+      notify_region(doc, gfx::Rect(6, 6, 2, 2), 4);
+    }
+    // Only the outermost batch sends the event
+    EXPECT_EQ(0, obs.batches);
+    notify_region(doc, gfx::Rect(1, 1, 2, 2), 1);
+  }
+  EXPECT_EQ(0, obs.celEvents);
+  EXPECT_EQ(1, obs.batches);
+  EXPECT_EQ(gfx::Rect(0, 0, 8, 8), obs.bounds);
+  EXPECT_EQ(1, obs.firstFrame);
+  EXPECT_EQ(4, obs.lastFrame);
+
+  // A batch without events doesn't send anything
+  {
+    DocumentNotificationBatch batch(&doc);
+  }
+  EXPECT_EQ(1, obs.batches);
+
+  // The next batch starts from scratch
+  {
+    DocumentNotificationBatch batch(&doc);
+    notify_region(doc, gfx::Rect(30, 30, 2, 2), 9);
+  }
+  EXPECT_EQ(2, obs.batches);
+  EXPECT_EQ(gfx::Rect(30, 30, 2, 2), obs.bounds);
+  EXPECT_EQ(9, obs.firstFrame);
+  EXPECT_EQ(9, obs.lastFrame);
+
+  doc.removeObserver(&obs);
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
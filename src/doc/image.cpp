@@ -16,12 +16,15 @@
 #include "doc/palette.h"
 #include "doc/primitives.h"
 #include "doc/rgbmap.h"
+#include "base/hash64.h"
 
 namespace doc {
 
 Image::Image(PixelFormat format, int width, int height)
   : Object(ObjectType::Image)
   , m_format(format)
+  , m_hash(0)
+  , m_hashVersion(-1)
 {
   m_width = width;
   m_height = height;
@@ -47,6 +50,41 @@ int Image::getRowStrideSize(int pixels_per_row) const
   return calculate_rowstride_bytes(pixelFormat(), pixels_per_row);
 }
 
+uint64_t Image::contentHash() const
+{
+  const int64_t ver = version();
+  if (m_hashVersion.load(std::memory_order_acquire) == ver)
+    return m_hash.load(std::memory_order_relaxed);
+
+  base::Hash64 hash(
+    (uint64_t(m_format) << 56) ^
+    (uint64_t(m_width) << 28) ^
+    uint64_t(m_height));
+
+  // In bitmaps the unused bits of the last byte of each row must be
+  // ignored.
+  int rowBytes = getRowStrideSize();
+  int lastBits = 0;
+  if (m_format == IMAGE_BITMAP && (m_width & 7)) {
+    --rowBytes;
+    lastBits = (m_width & 7);
+  }
+
+  for (int y=0; y<m_height; ++y) {
+    const uint8_t* row = getPixelAddress(0, y);
+    hash.update(row, rowBytes);
+    if (lastBits) {
+      uint8_t last = row[rowBytes] & ((1 << lastBits) - 1);
+      hash.update(&last, 1);
+    }
+  }
+
+  const uint64_t result = hash.digest();
+  m_hash.store(result, std::memory_order_relaxed);
+  m_hashVersion.store(ver, std::memory_order_release);
+  return result;
+}
+
 // static
 Image* Image::create(PixelFormat format, int width, int height,
                      const ImageBufferPtr& buffer)
@@ -14,6 +14,9 @@
 #include "gfx/rect.h"
 #include "gfx/size.h"
 
+#include <atomic>
+#include <cstdint>
+
 namespace doc {
 
   template<typename ImageTraits> class ImageBits;
@@ -48,6 +51,12 @@ namespace doc {
     int getRowStrideSize() const;
     int getRowStrideSize(int pixels_per_row) const;
 
+    // Returns a hash of the image pixels (including its format and
+    // size). It's calculated the first time and cached until the
+    // image version changes, so any code that modifies the pixels
+    // must call incrementVersion() (as cmd::CopyRegion does).
+    uint64_t contentHash() const;
+
     template<typename ImageTraits>
     ImageBits<ImageTraits> lockBits(LockType lockType, const gfx::Rect& bounds) {
       return ImageBits<ImageTraits>(this, bounds);
@@ -83,6 +92,11 @@ namespace doc {
     int m_width;
     int m_height;
     color_t m_maskColor;  // Skipped color in merge process.
+
+    // Cached contentHash() and the version() it was calculated
+    // for (-1 if it wasn't calculated yet).
+    mutable std::atomic<uint64_t> m_hash;
+    mutable std::atomic<int64_t> m_hashVersion;
   };
 
 } // namespace doc
@@ -10,7 +10,7 @@
 
 #include "doc/image_impl.h"
 
-#include "doc/image_iterator.h"
+#include "doc/bitmap_ops.h"
 #include "doc/image_traits.h"
 
 namespace doc {
@@ -20,20 +20,13 @@ void copy_bitmaps(Image* dst, const Image* src, gfx::Clip area)
   if (!area.clip(dst->width(), dst->height(), src->width(), src->height()))
     return;
 
-  // Copy process
-  ImageConstIterator<BitmapTraits> src_it(src, area.srcBounds(), area.src.x, area.src.y);
-  ImageIterator<BitmapTraits> dst_it(dst, area.dstBounds(), area.dst.x, area.dst.y);
-
-  int end_x = area.dst.x+area.size.w;
-
+  // Copy process (row by row, using whole bytes/words)
   for (int end_y=area.dst.y+area.size.h;
        area.dst.y<end_y;
        ++area.dst.y, ++area.src.y) {
-    for (int x=area.dst.x; x<end_x; ++x) {
-      *dst_it = *src_it;
-      ++src_it;
-      ++dst_it;
-    }
+    bitmap_copy_row(dst->getPixelAddress(0, area.dst.y), area.dst.x,
+                    src->getPixelAddress(0, area.src.y), area.src.x,
+                    area.size.w);
   }
 }
 
@@ -10,6 +10,7 @@
 #include <cstdlib>
 #include <cstring>
 
+#include "doc/bitmap_ops.h"
 #include "doc/blend_funcs.h"
 #include "doc/image.h"
 #include "doc/image_bits.h"
@@ -250,10 +251,15 @@ namespace doc {
       (*(m_rows[y] + d.quot)) &= ~(1 << d.rem);
   }
 
+  template<>
+  inline void ImageImpl<BitmapTraits>::drawHLine(int x1, int y, int x2, color_t color) {
+    bitmap_fill_row(m_rows[y], x1, x2, color != 0);
+  }
+
   template<>
   inline void ImageImpl<BitmapTraits>::fillRect(int x1, int y1, int x2, int y2, color_t color) {
     for (int y=y1; y<=y2; ++y)
-      ImageImpl<BitmapTraits>::drawHLine(x1, y, x2, color);
+      bitmap_fill_row(m_rows[y], x1, x2, color != 0);
   }
 
   template<>
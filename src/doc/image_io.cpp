@@ -10,97 +10,94 @@
 
 #include "doc/image_io.h"
 
-#include "base/base.h"
 #include "base/exception.h"
-#include "base/serialization.h"
 #include "doc/image.h"
-#include "zlib.h"
 
 #include <iostream>
 #include <memory>
 
 namespace doc {
 
-using namespace base::serialization;
-using namespace base::serialization::little_endian;
+namespace {
 
-// TODO Create a zlib wrapper for iostreams
+// The compression method is saved in the high bits of the pixel
+// format byte. Zlib is 0 so old versions can read these images.
+const uint8_t kPixelFormatMask = 0x0f;
+const int kMethodShift = 4;
 
-void write_image(std::ostream& os, const Image* image)
+uint8_t method_to_bits(base::Compression method)
 {
-  write32(os, image->id());
-  write8(os, image->pixelFormat());    // Pixel format
-  write16(os, image->width());         // Width
-  write16(os, image->height());        // Height
-  write32(os, image->maskColor());     // Mask color
-
-  int rowSize = image->getRowStrideSize();
-#if 0
-  {
-    for (int c=0; c<image->height(); c++)
-      os.write((char*)image->getPixelAddress(0, c), rowSize);
+  switch (method) {
+    case base::Compression::Zlib: return 0;
+    case base::Compression::None: return 1;
+    case base::Compression::Fast: return 2;
   }
-#else
-  {
-    std::ostream::pos_type total_output_pos = os.tellp();
-    write32(os, 0);    // Compressed size (we update this value later)
-
-    z_stream zstream;
-    zstream.zalloc = (alloc_func)0;
-    zstream.zfree  = (free_func)0;
-    zstream.opaque = (voidpf)0;
-    int err = deflateInit(&zstream, Z_DEFAULT_COMPRESSION);
-    if (err != Z_OK)
-      throw base::Exception("ZLib error %d in deflateInit().", err);
-
-    std::vector<uint8_t> compressed(4096);
-    int total_output_bytes = 0;
-
-    for (int y=0; y<image->height(); y++) {
-      zstream.next_in = (Bytef*)image->getPixelAddress(0, y);
-      zstream.avail_in = rowSize;
-      int flush = (y == image->height()-1 ? Z_FINISH: Z_NO_FLUSH);
-
-      do {
-        zstream.next_out = (Bytef*)&compressed[0];
-        zstream.avail_out = compressed.size();
-
-        // Compress
-        err = deflate(&zstream, flush);
-        if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
-          throw base::Exception("ZLib error %d in deflate().", err);
-
-        int output_bytes = compressed.size() - zstream.avail_out;
-        if (output_bytes > 0) {
-          if (os.write((char*)&compressed[0], output_bytes).fail())
-            throw base::Exception("Error writing compressed image pixels.\n");
-
-          total_output_bytes += output_bytes;
-        }
-      } while (zstream.avail_out == 0);
-    }
-
-    err = deflateEnd(&zstream);
-    if (err != Z_OK)
-      throw base::Exception("ZLib error %d in deflateEnd().", err);
-
-    std::ostream::pos_type bak = os.tellp();
-    os.seekp(total_output_pos);
-    write32(os, total_output_bytes);
-    os.seekp(bak);
+  return 0;
+}
+
+bool bits_to_method(uint8_t bits, base::Compression& method)
+{
+  switch (bits) {
+    case 0: method = base::Compression::Zlib; return true;
+    case 1: method = base::Compression::None; return true;
+    case 2: method = base::Compression::Fast; return true;
   }
-#endif
+  return false;
+}
+
+} // anonymous namespace
+
+void write_image(std::ostream& os, const Image* image)
+{
+  write_image(os, image, image->id(), base::CompressionOptions());
+}
+
+void write_image(std::ostream& os, const Image* image,
+                 ObjectId id, const base::CompressionOptions& compression)
+{
+  base::BinaryWriter w(os);
+  write_image(w, image, id, compression);
+  w.flush();
+}
+
+void write_image(base::BinaryWriter& w, const Image* image,
+                 ObjectId id, const base::CompressionOptions& compression)
+{
+  w.write32(id);
+  w.write8(image->pixelFormat() |       // Pixel format
+           (method_to_bits(compression.method) << kMethodShift));
+  w.write16(image->width());            // Width
+  w.write16(image->height());           // Height
+  w.write32(image->maskColor());        // Mask color
+
+  // Compressed size and pixels (row by row)
+  const int rowSize = image->getRowStrideSize();
+  w.beginCompression(compression);
+  for (int y=0; y<image->height(); y++)
+    w.write(image->getPixelAddress(0, y), rowSize);
+  w.endCompression();
 }
 
 Image* read_image(std::istream& is, bool setId)
 {
-  ObjectId id = read32(is);
-  int pixelFormat = read8(is);          // Pixel format
-  int width = read16(is);               // Width
-  int height = read16(is);              // Height
-  uint32_t maskColor = read32(is);      // Mask color
+  base::BinaryReader r(is);
+  return read_image(r, setId);
+}
 
-  if ((pixelFormat != IMAGE_RGB &&
+Image* read_image(base::BinaryReader& r, bool setId)
+{
+  ObjectId id = r.read32();
+  int formatAndMethod = r.read8();      // Pixel format
+  int width = r.read16();               // Width
+  int height = r.read16();              // Height
+  uint32_t maskColor = r.read32();      // Mask color
+
+  int pixelFormat = (formatAndMethod & kPixelFormatMask);
+  base::Compression method;
+
+  if (!r.ok() ||
+      !bits_to_method(formatAndMethod >> kMethodShift, method) ||
+      (pixelFormat != IMAGE_RGB &&
        pixelFormat != IMAGE_GRAYSCALE &&
        pixelFormat != IMAGE_INDEXED &&
        pixelFormat != IMAGE_BITMAP) ||
@@ -109,76 +106,16 @@ Image* read_image(std::istream& is, bool setId)
     return nullptr;
 
   std::unique_ptr<Image> image(Image::create(static_cast<PixelFormat>(pixelFormat), width, height));
-  int rowSize = image->getRowStrideSize();
+  const int rowSize = image->getRowStrideSize();
 
-#if 0
-  {
-    for (int c=0; c<image->height(); c++)
-      is.read((char*)image->getPixelAddress(0, c), rowSize);
-  }
-#else
-  {
-    int avail_bytes = read32(is);
-
-    z_stream zstream;
-    zstream.zalloc = (alloc_func)0;
-    zstream.zfree  = (free_func)0;
-    zstream.opaque = (voidpf)0;
-
-    int err = inflateInit(&zstream);
-    if (err != Z_OK)
-      throw base::Exception("ZLib error %d in inflateInit().", err);
-
-    int uncompressed_size = image->height() * rowSize;
-    int uncompressed_offset = 0;
-    int remain = avail_bytes;
-
-    std::vector<uint8_t> compressed(4096);
-    uint8_t* address = image->getPixelAddress(0, 0);
-    uint8_t* address_end = image->getPixelAddress(0, 0) + uncompressed_size;
-
-    while (remain > 0) {
-      int len = MIN(remain, (int)compressed.size());
-      if (is.read((char*)&compressed[0], len).fail()) {
-        ASSERT(false);
-        throw base::Exception("Error reading stream to restore image");
-      }
-
-      int bytes_read = (int)is.gcount();
-      if (bytes_read == 0) {
-        ASSERT(remain == 0);
-        break;
-      }
-
-      remain -= bytes_read;
-
-      zstream.next_in = (Bytef*)&compressed[0];
-      zstream.avail_in = (uInt)bytes_read;
-
-      do {
-        zstream.next_out = (Bytef*)address;
-        zstream.avail_out = address_end - address;
-
-        err = inflate(&zstream, Z_NO_FLUSH);
-        if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
-          throw base::Exception("ZLib error %d in inflate().", err);
-
-        int uncompressed_bytes = (int)((address_end - address) - zstream.avail_out);
-        if (uncompressed_bytes > 0) {
-          if (uncompressed_offset+uncompressed_bytes > uncompressed_size)
-            throw base::Exception("Bad compressed image.");
-
-          uncompressed_offset += uncompressed_bytes;
-          address += uncompressed_bytes;
-        }
-      } while (zstream.avail_in != 0 && zstream.avail_out == 0);
-    }
-
-    err = inflateEnd(&zstream);
-    if (err != Z_OK)
-      throw base::Exception("ZLib error %d in inflateEnd().", err);
+  if (!r.beginDecompression(method))
+    throw base::Exception("Error reading stream to restore image");
+
+  for (int y=0; y<height; y++) {
+    if (!r.read(image->getPixelAddress(0, y), rowSize))
+      throw base::Exception("Bad compressed image.");
   }
-#endif
+  r.endDecompression();
 
   image->setMaskColor(maskColor);
   if (setId)
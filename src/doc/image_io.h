@@ -6,6 +6,9 @@
 
 #pragma once
 
+#include "base/binary_stream.h"
+#include "doc/object_id.h"
+
 #include <iosfwd>
 
 namespace doc {
@@ -13,6 +16,16 @@ namespace doc {
   class Image;
 
   void write_image(std::ostream& os, const Image* image);
+
+  // Writes the image pixels with the given compression using "id" as
+  // the image ID (e.g. to write a copy of an image with the ID of the
+  // original one).
+  void write_image(std::ostream& os, const Image* image,
+                   ObjectId id, const base::CompressionOptions& compression);
+  void write_image(base::BinaryWriter& w, const Image* image,
+                   ObjectId id, const base::CompressionOptions& compression);
+
   Image* read_image(std::istream& is, bool setId = true);
+  Image* read_image(base::BinaryReader& r, bool setId = true);
 
 } // namespace doc
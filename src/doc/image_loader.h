@@ -0,0 +1,30 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include "doc/image_ref.h"
+
+#include <memory>
+
+namespace doc {
+
+  // Creates the image of a cel the first time its pixels are needed
+  // (see CelData::setPendingImage()), e.g. inflating the pixels from
+  // the original file. It can be called from any thread that accesses
+  // the image, but just once for each cel.
+  class ImageLoader {
+  public:
+    virtual ~ImageLoader() { }
+
+    // Must return a valid image (with the size given to
+    // setPendingImage()) even if the pixels cannot be loaded.
+    virtual ImageRef loadImage() = 0;
+  };
+
+  typedef std::shared_ptr<ImageLoader> ImageLoaderPtr;
+
+} // namespace doc
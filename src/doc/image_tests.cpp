@@ -69,7 +69,7 @@ TYPED_TEST(ImageAllTypes, PutGetAndIterators)
 
     // Read-only iterator (whole image)
     {
-      const LockImageBits<ImageTraits> bits((const Image*)image);
+      const LockImageBits<ImageTraits> bits((const Image*)image.get());
       typename LockImageBits<ImageTraits>::const_iterator
         begin = bits.begin(),
         it = begin,
@@ -87,7 +87,7 @@ TYPED_TEST(ImageAllTypes, PutGetAndIterators)
       if (bounds.w <= 0 || bounds.h <= 0)
         break;
 
-      const LockImageBits<ImageTraits> bits((const Image*)image, bounds);
+      const LockImageBits<ImageTraits> bits((const Image*)image.get(), bounds);
       typename LockImageBits<ImageTraits>::const_iterator
         begin = bits.begin(),
         it = begin,
@@ -108,7 +108,7 @@ TYPED_TEST(ImageAllTypes, PutGetAndIterators)
 
     // Write iterator (whole image)
     {
-      LockImageBits<ImageTraits> bits(image, Image::WriteLock);
+      LockImageBits<ImageTraits> bits(image.get(), Image::WriteLock);
       typename LockImageBits<ImageTraits>::iterator
         begin = bits.begin(),
         it = begin,
@@ -144,6 +144,40 @@ TEST(Image, DiffRgbImages)
   ASSERT_EQ(2, count_diff_between_images(a.get(), b.get()));
 }
 
+TYPED_TEST(ImageAllTypes, ContentHash)
+{
+  typedef TypeParam ImageTraits;
+
+  for (int w : { 1, 7, 8, 9, 33, 100 }) {
+    std::unique_ptr<Image> a(Image::create(ImageTraits::pixel_format, w, 17));
+    std::unique_ptr<Image> b(Image::create(ImageTraits::pixel_format, w, 17));
+    a->clear(0);
+    b->clear(0);
+    EXPECT_EQ(a->contentHash(), b->contentHash());
+    EXPECT_TRUE(is_same_image(a.get(), b.get()));
+
+    // The cached hash is used until the version changes
+    put_pixel(a.get(), w-1, 16, 1);
+    EXPECT_EQ(b->contentHash(), a->contentHash());
+    a->incrementVersion();
+    EXPECT_NE(b->contentHash(), a->contentHash());
+    EXPECT_FALSE(is_same_image(a.get(), b.get()));
+
+    put_pixel(b.get(), w-1, 16, 1);
+    b->incrementVersion();
+    EXPECT_EQ(a->contentHash(), b->contentHash());
+    EXPECT_TRUE(is_same_image(a.get(), b.get()));
+  }
+
+  // Same pixels with different size
+  std::unique_ptr<Image> a(Image::create(ImageTraits::pixel_format, 8, 2));
+  std::unique_ptr<Image> b(Image::create(ImageTraits::pixel_format, 16, 1));
+  a->clear(0);
+  b->clear(0);
+  EXPECT_NE(a->contentHash(), b->contentHash());
+  EXPECT_FALSE(is_same_image(a.get(), b.get()));
+}
+
 TYPED_TEST(ImageAllTypes, DrawHLine)
 {
   typedef TypeParam ImageTraits;
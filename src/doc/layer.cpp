@@ -17,6 +17,7 @@
 
 #include <algorithm>
 #include <cstring>
+#include <unordered_map>
 
 namespace doc {
 
@@ -86,6 +87,8 @@ LayerImage::LayerImage(Sprite* sprite)
   : Layer(ObjectType::LayerImage, sprite)
   , m_blendmode(BlendMode::NORMAL)
   , m_opacity(255)
+  , m_linksVersion(0)
+  , m_celsVersion(1)
 {
 }
 
@@ -114,17 +117,60 @@ int LayerImage::getMemSize() const
 void LayerImage::destroyAllCels()
 {
   m_cels.clear();
+  m_frameCels.clear();
+  invalidateLinks();
 }
 
 std::shared_ptr<Cel> LayerImage::cel(frame_t frame) const
 {
-  CelConstIterator it = findCelIterator(frame);
-  if (it != getCelEnd())
-    return *it;
+  if (frame >= 0 && frame < frame_t(m_frameCels.size()))
+    return m_frameCels[frame];
   else
     return nullptr;
 }
 
+frame_t LayerImage::prevLinkedFrame(const Cel* cel) const
+{
+  ASSERT(cel->layer() == this);
+
+  if (m_linksVersion.load(std::memory_order_acquire) != m_celsVersion)
+    updateLinks();
+
+  frame_t frame = cel->frame();
+  if (frame >= 0 && frame < frame_t(m_prevLinkedFrames.size()))
+    return m_prevLinkedFrames[frame];
+  else
+    return -1;
+}
+
+void LayerImage::updateLinks() const
+{
+  std::lock_guard<std::mutex> lock(m_linksMutex);
+
+  // Other thread could update the links while we were waiting the lock
+  if (m_linksVersion.load(std::memory_order_relaxed) == m_celsVersion)
+    return;
+
+  // Last frame where we've seen each CelData
+  std::unordered_map<const CelData*, frame_t> lastFrames;
+  lastFrames.reserve(m_cels.size());
+
+  m_prevLinkedFrames.resize(m_frameCels.size());
+  for (frame_t frame=0; frame<frame_t(m_frameCels.size()); ++frame) {
+    m_prevLinkedFrames[frame] = -1;
+
+    if (const Cel* cel = m_frameCels[frame].get()) {
+      auto result = lastFrames.emplace(cel->data(), frame);
+      if (!result.second) {
+        m_prevLinkedFrames[frame] = result.first->second;
+        result.first->second = frame;
+      }
+    }
+  }
+
+  m_linksVersion.store(m_celsVersion, std::memory_order_release);
+}
+
 void LayerImage::getCels(CelList& cels) const
 {
   CelConstIterator it = getCelBegin();
@@ -193,6 +239,14 @@ void LayerImage::addCel(std::shared_ptr<Cel> cel)
   CelIterator it = findFirstCelIteratorAfter(cel->frame());
   m_cels.insert(it, cel);
 
+  frame_t frame = cel->frame();
+  ASSERT(frame >= 0);
+  if (frame >= frame_t(m_frameCels.size()))
+    m_frameCels.resize(frame+1);
+  ASSERT(!m_frameCels[frame]);
+  m_frameCels[frame] = cel;
+  invalidateLinks();
+
   cel->setParentLayer(this);
 }
 
@@ -207,6 +261,13 @@ void LayerImage::removeCel(std::shared_ptr<Cel> cel)
 
   m_cels.erase(it);
 
+  frame_t frame = cel->frame();
+  ASSERT(frame < frame_t(m_frameCels.size()));
+  m_frameCels[frame].reset();
+  while (!m_frameCels.empty() && !m_frameCels.back())
+    m_frameCels.pop_back();
+  invalidateLinks();
+
   cel->setParentLayer(NULL);
 }
 
@@ -13,7 +13,11 @@
 #include "doc/object.h"
 #include "doc/with_user_data.h"
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace doc {
 
@@ -130,6 +134,16 @@ namespace doc {
     void getCels(CelList& cels) const override;
     void displaceFrames(frame_t fromThis, frame_t delta) override;
 
+    // Returns the previous frame with a cel linked to the given cel
+    // of this layer (i.e. with the same CelData), or -1 if there is
+    // no one. It can be called from several threads at the same time
+    // (e.g. from CelsRange::UNIQUE traversals).
+    frame_t prevLinkedFrame(const Cel* cel) const;
+
+    // Must be called when a cel of this layer changes its CelData
+    // (see Cel::setDataRef()).
+    void invalidateLinks() { ++m_celsVersion; }
+
     std::shared_ptr<Cel> getLastCel() const;
     CelConstIterator findCelIterator(frame_t frame) const;
     CelIterator findCelIterator(frame_t frame);
@@ -145,10 +159,24 @@ namespace doc {
 
   private:
     void destroyAllCels();
+    void updateLinks() const;
 
     BlendMode m_blendmode;
     int m_opacity;
     CelList m_cels;   // List of all cels inside this layer used by frames.
+
+    // Dense frame -> cel table so cel(frame) is O(1). It's kept in
+    // sync with m_cels by addCel()/removeCel() and it's trimmed to
+    // the last frame with a cel.
+    CelList m_frameCels;
+
+    // Result of prevLinkedFrame() for each frame of m_frameCels. It's
+    // calculated again when m_linksVersion != m_celsVersion (i.e.
+    // after cels are added/removed/relinked).
+    mutable std::vector<frame_t> m_prevLinkedFrames;
+    mutable std::atomic<uint32_t> m_linksVersion;
+    mutable std::mutex m_linksMutex;
+    uint32_t m_celsVersion;
   };
 
   //////////////////////////////////////////////////////////////////////
@@ -0,0 +1,115 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/algorithm/link_identical_cels.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+
+using namespace doc;
+using namespace doc::algorithm;
+
+namespace {
+
+class LinkIdenticalCels : public ::testing::Test {
+protected:
+  LinkIdenticalCels()
+    : m_sprite(new Sprite(IMAGE_RGB, 4, 4, 256))
+    , m_layer(new LayerImage(m_sprite)) {
+    m_sprite->setTotalFrames(frame_t(4));
+    m_sprite->folder()->addLayer(m_layer);
+  }
+
+  ~LinkIdenticalCels() {
+    delete m_sprite;
+  }
+
+  std::shared_ptr<Cel> addCel(frame_t frame, color_t color) {
+    ImageRef image(Image::create(IMAGE_RGB, 4, 4));
+    clear_image(image.get(), color);
+    auto cel = std::make_shared<Cel>(frame, image);
+    m_layer->addCel(cel);
+    return cel;
+  }
+
+  Sprite* m_sprite;
+  LayerImage* m_layer;
+};
+
+} // anonymous namespace
+
+TEST_F(LinkIdenticalCels, LinkSamePixels)
+{
+  auto a = addCel(frame_t(0), rgba(255, 0, 0, 255));
+  auto b = addCel(frame_t(1), rgba(0, 255, 0, 255));
+  auto c = addCel(frame_t(2), rgba(255, 0, 0, 255));
+  auto d = addCel(frame_t(3), rgba(0, 255, 0, 255));
+  const std::size_t celSize = c->data()->getMemSize();
+
+  EXPECT_EQ(2*celSize, link_identical_cels(m_sprite));
+  EXPECT_EQ(a->data(), c->data());
+  EXPECT_EQ(b->data(), d->data());
+  EXPECT_NE(a->data(), b->data());
+  EXPECT_EQ(a, c->link());
+  EXPECT_EQ(b, d->link());
+
+  // Nothing else to link
+  EXPECT_EQ(0u, link_identical_cels(m_sprite));
+}
+
+TEST_F(LinkIdenticalCels, DifferentPositionOrOpacity)
+{
+  auto a = addCel(frame_t(0), rgba(255, 0, 0, 255));
+  auto b = addCel(frame_t(1), rgba(255, 0, 0, 255));
+  auto c = addCel(frame_t(2), rgba(255, 0, 0, 255));
+  b->setPosition(1, 0);
+  c->setOpacity(128);
+
+  EXPECT_EQ(0u, link_identical_cels(m_layer));
+  EXPECT_NE(a->data(), b->data());
+  EXPECT_NE(a->data(), c->data());
+  EXPECT_NE(b->data(), c->data());
+}
+
+TEST_F(LinkIdenticalCels, AlreadyLinkedCels)
+{
+  auto a = addCel(frame_t(0), rgba(255, 0, 0, 255));
+  auto link = Cel::createLink(a);
+  link->setFrame(frame_t(1));
+  m_layer->addCel(link);
+  auto c = addCel(frame_t(2), rgba(255, 0, 0, 255));
+  const std::size_t celSize = c->data()->getMemSize();
+
+  // Just the data of "c" is released
+  EXPECT_EQ(celSize, link_identical_cels(m_layer));
+  EXPECT_EQ(a->data(), link->data());
+  EXPECT_EQ(a->data(), c->data());
+}
+
+TEST_F(LinkIdenticalCels, SharedDataIsNotReleased)
+{
+  addCel(frame_t(0), rgba(255, 0, 0, 255));
+  auto b = addCel(frame_t(1), rgba(255, 0, 0, 255));
+
+  // Another reference to the data of "b" keeps it alive
+  CelDataRef data = b->dataRef();
+  EXPECT_EQ(0u, link_identical_cels(m_layer));
+  EXPECT_NE(data.get(), b->data());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -12,6 +12,7 @@
 
 #include "base/base.h"
 #include "base/memory.h"
+#include "doc/bitmap_ops.h"
 #include "doc/image_impl.h"
 
 #include <cstdlib>
@@ -19,6 +20,40 @@
 
 namespace doc {
 
+namespace {
+
+// Fills the "dst" bitmap with 1 where "isSelected(pixel)" is true
+// for each pixel of "src" (both images must have the same size). The
+// bits are packed in bytes instead of using image iterators.
+template<typename ImageTraits, typename Predicate>
+void bitmap_from_pixels(Image* dst, const Image* src, Predicate isSelected)
+{
+  typedef typename ImageTraits::pixel_t pixel_t;
+  const int w = src->width();
+
+  for (int y=0; y<src->height(); ++y) {
+    const pixel_t* s = (const pixel_t*)src->getPixelAddress(0, y);
+    uint8_t* d = dst->getPixelAddress(0, y);
+    int x = 0;
+
+    for (; x+8 <= w; x += 8, s += 8) {
+      uint8_t byte = 0;
+      for (int bit=0; bit<8; ++bit)
+        byte |= (isSelected(s[bit]) ? 1: 0) << bit;
+      *(d++) = byte;
+    }
+
+    if (x < w) {
+      uint8_t byte = 0;
+      for (int bit=0; x<w; ++x, ++bit)
+        byte |= (isSelected(*(s++)) ? 1: 0) << bit;
+      *d = byte;
+    }
+  }
+}
+
+} // anonymous namespace
+
 Mask::Mask()
   : Object(ObjectType::Mask)
 {
@@ -74,11 +109,9 @@ bool Mask::isRectangular() const
   if (!m_bitmap)
     return false;
 
-  LockImageBits<BitmapTraits> bits(m_bitmap.get());
-  LockImageBits<BitmapTraits>::iterator it = bits.begin(), end = bits.end();
-
-  for (; it != end; ++it) {
-    if (*it == 0)
+  const Image* bitmap = m_bitmap.get();
+  for (int y=0; y<bitmap->height(); ++y) {
+    if (!bitmap_is_full_row(bitmap->getPixelAddress(0, y), bitmap->width()))
       return false;
   }
 
@@ -115,11 +148,9 @@ void Mask::invert()
   if (!m_bitmap)
     return;
 
-  LockImageBits<BitmapTraits> bits(m_bitmap.get());
-  LockImageBits<BitmapTraits>::iterator it = bits.begin(), end = bits.end();
-
-  for (; it != end; ++it)
-    *it = (*it ? 0: 1);
+  Image* bitmap = m_bitmap.get();
+  for (int y=0; y<bitmap->height(); ++y)
+    bitmap_invert_row(bitmap->getPixelAddress(0, y), bitmap->width());
 
   shrink();
 }
@@ -190,95 +221,56 @@ void Mask::byColor(const Image *src, int color, int fuzziness)
   switch (src->pixelFormat()) {
 
     case IMAGE_RGB: {
-      const LockImageBits<RgbTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<RgbTraits>::const_iterator src_it = srcBits.begin(), src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      int src_r, src_g, src_b, src_a;
-      int dst_r, dst_g, dst_b, dst_a;
-      color_t c;
-
-      dst_r = rgba_getr(color);
-      dst_g = rgba_getg(color);
-      dst_b = rgba_getb(color);
-      dst_a = rgba_geta(color);
-
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
-
-        src_r = rgba_getr(c);
-        src_g = rgba_getg(c);
-        src_b = rgba_getb(c);
-        src_a = rgba_geta(c);
-
-        if (!((src_r >= dst_r-fuzziness) && (src_r <= dst_r+fuzziness) &&
-              (src_g >= dst_g-fuzziness) && (src_g <= dst_g+fuzziness) &&
-              (src_b >= dst_b-fuzziness) && (src_b <= dst_b+fuzziness) &&
-              (src_a >= dst_a-fuzziness) && (src_a <= dst_a+fuzziness)))
-          *dst_it = 0;
-      }
-      ASSERT(dst_it == dst_end);
+      int dst_r = rgba_getr(color);
+      int dst_g = rgba_getg(color);
+      int dst_b = rgba_getb(color);
+      int dst_a = rgba_geta(color);
+
+      bitmap_from_pixels<RgbTraits>(
+        dst, src,
+        [=](color_t c) -> bool {
+          int src_r = rgba_getr(c);
+          int src_g = rgba_getg(c);
+          int src_b = rgba_getb(c);
+          int src_a = rgba_geta(c);
+
+          return ((src_r >= dst_r-fuzziness) && (src_r <= dst_r+fuzziness) &&
+                  (src_g >= dst_g-fuzziness) && (src_g <= dst_g+fuzziness) &&
+                  (src_b >= dst_b-fuzziness) && (src_b <= dst_b+fuzziness) &&
+                  (src_a >= dst_a-fuzziness) && (src_a <= dst_a+fuzziness));
+        });
       break;
     }
 
     case IMAGE_GRAYSCALE: {
-      const LockImageBits<GrayscaleTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<GrayscaleTraits>::const_iterator src_it = srcBits.begin(), src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      int src_k, src_a;
-      int dst_k, dst_a;
-      color_t c;
-
-      dst_k = graya_getv(color);
-      dst_a = graya_geta(color);
-
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
-
-        src_k = graya_getv(c);
-        src_a = graya_geta(c);
-
-        if (!((src_k >= dst_k-fuzziness) && (src_k <= dst_k+fuzziness) &&
-              (src_a >= dst_a-fuzziness) && (src_a <= dst_a+fuzziness)))
-          *dst_it = 0;
-      }
-      ASSERT(dst_it == dst_end);
+      int dst_k = graya_getv(color);
+      int dst_a = graya_geta(color);
+
+      bitmap_from_pixels<GrayscaleTraits>(
+        dst, src,
+        [=](color_t c) -> bool {
+          int src_k = graya_getv(c);
+          int src_a = graya_geta(c);
+
+          return ((src_k >= dst_k-fuzziness) && (src_k <= dst_k+fuzziness) &&
+                  (src_a >= dst_a-fuzziness) && (src_a <= dst_a+fuzziness));
+        });
       break;
     }
 
     case IMAGE_INDEXED: {
-      const LockImageBits<IndexedTraits> srcBits(src);
-      LockImageBits<BitmapTraits> dstBits(dst, Image::WriteLock);
-      LockImageBits<IndexedTraits>::const_iterator src_it = srcBits.begin(), src_end = srcBits.end();
-      LockImageBits<BitmapTraits>::iterator dst_it = dstBits.begin();
-#ifdef _DEBUG
-      LockImageBits<BitmapTraits>::iterator dst_end = dstBits.end();
-#endif
-      color_t c, min, max;
-
-      for (; src_it != src_end; ++src_it, ++dst_it) {
-        ASSERT(dst_it != dst_end);
-        c = *src_it;
-
-        if (color > fuzziness)
-          min = color-fuzziness;
-        else
-          min = 0;
-        max = color + fuzziness;
-
-        if (!((c >= min) && (c <= max)))
-          *dst_it = 0;
-      }
-      ASSERT(dst_it == dst_end);
+      color_t min, max;
+      if (color > fuzziness)
+        min = color-fuzziness;
+      else
+        min = 0;
+      max = color + fuzziness;
+
+      bitmap_from_pixels<IndexedTraits>(
+        dst, src,
+        [=](color_t c) -> bool {
+          return ((c >= min) && (c <= max));
+        });
       break;
     }
   }
@@ -381,58 +373,39 @@ void Mask::shrink()
   if (m_freeze_count > 0)
     return;
 
-#define SHRINK_SIDE(u_begin, u_op, u_final, u_add,                      \
-                    v_begin, v_op, v_final, v_add, U, V, var)           \
-  {                                                                     \
-    for (u = u_begin; u u_op u_final; u u_add) {                        \
-      for (v = v_begin; v v_op v_final; v v_add) {                      \
-        if (get_pixel_fast<BitmapTraits>(m_bitmap.get(), U, V))         \
-          break;                                                        \
-      }                                                                 \
-      if (v == v_final)                                                 \
-        var;                                                            \
-      else                                                              \
-        break;                                                          \
-    }                                                                   \
+  if (!m_bitmap) {
+    clear();
+    return;
   }
 
-  int u, v, x1, y1, x2, y2;
-
-  x1 = m_bounds.x;
-  y1 = m_bounds.y;
-  x2 = m_bounds.x+m_bounds.w-1;
-  y2 = m_bounds.y+m_bounds.h-1;
-
-  SHRINK_SIDE(0, <, m_bounds.w, ++,
-              0, <, m_bounds.h, ++, u, v, x1++);
-
-  SHRINK_SIDE(0, <, m_bounds.h, ++,
-              0, <, m_bounds.w, ++, v, u, y1++);
-
-  SHRINK_SIDE(m_bounds.w-1, >, 0, --,
-              0, <, m_bounds.h, ++, u, v, x2--);
-
-  SHRINK_SIDE(m_bounds.h-1, >, 0, --,
-              0, <, m_bounds.w, ++, v, u, y2--);
+  const Image* bitmap = m_bitmap.get();
+  int x1 = bitmap->width(), x2 = -1;
+  int y1 = -1, y2 = -1;
+
+  for (int y=0; y<bitmap->height(); ++y) {
+    int u1, u2;
+    if (bitmap_row_bounds(bitmap->getPixelAddress(0, y), bitmap->width(), u1, u2)) {
+      if (y1 < 0)
+        y1 = y;
+      y2 = y;
+      x1 = MIN(x1, u1);
+      x2 = MAX(x2, u2);
+    }
+  }
 
-  if ((x1 > x2) || (y1 > y2)) {
+  if (y1 < 0) {
     clear();
   }
-  else if ((x1 != m_bounds.x) || (x2 != m_bounds.x+m_bounds.w-1) ||
-           (y1 != m_bounds.y) || (y2 != m_bounds.y+m_bounds.h-1)) {
-    u = m_bounds.x;
-    v = m_bounds.y;
+  else if (x1 != 0 || y1 != 0 ||
+           x2 != m_bounds.w-1 || y2 != m_bounds.h-1) {
+    Image* image = crop_image(bitmap, x1, y1, x2-x1+1, y2-y1+1, 0);
+    m_bitmap.reset(image);
 
-    m_bounds.x = x1;
-    m_bounds.y = y1;
+    m_bounds.x += x1;
+    m_bounds.y += y1;
     m_bounds.w = x2 - x1 + 1;
     m_bounds.h = y2 - y1 + 1;
-
-    Image* image = crop_image(m_bitmap.get(), m_bounds.x-u, m_bounds.y-v, m_bounds.w, m_bounds.h, 0);
-    m_bitmap.reset(image);
   }
-
-#undef SHRINK_SIDE
 }
 
 } // namespace doc
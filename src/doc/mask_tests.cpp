@@ -0,0 +1,128 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/bitmap_ops.h"
+#include "doc/image_impl.h"
+#include "doc/mask.h"
+#include "doc/primitives.h"
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace doc;
+
+static void random_bitmap(Image* image, int density)
+{
+  for (int y=0; y<image->height(); ++y)
+    for (int x=0; x<image->width(); ++x)
+      put_pixel_fast<BitmapTraits>(image, x, y, (rand() % 100) < density ? 1: 0);
+}
+
+TEST(Mask, BitmapCopyRow)
+{
+  for (int i=0; i<2000; ++i) {
+    int w = 1 + rand() % 200;
+    std::unique_ptr<Image> src(Image::create(IMAGE_BITMAP, 256, 1));
+    std::unique_ptr<Image> dst(Image::create(IMAGE_BITMAP, 256, 1));
+    random_bitmap(src.get(), 50);
+    random_bitmap(dst.get(), 50);
+    std::unique_ptr<Image> expected(Image::create(IMAGE_BITMAP, 256, 1));
+    copy_image(expected.get(), dst.get());
+
+    int srcX = rand() % (256-w+1);
+    int dstX = rand() % (256-w+1);
+    for (int x=0; x<w; ++x)
+      put_pixel_fast<BitmapTraits>(expected.get(), dstX+x, 0,
+        get_pixel_fast<BitmapTraits>(src.get(), srcX+x, 0));
+
+    bitmap_copy_row(dst->getPixelAddress(0, 0), dstX,
+                    src->getPixelAddress(0, 0), srcX, w);
+    ASSERT_EQ(0, count_diff_between_images(expected.get(), dst.get()));
+  }
+}
+
+TEST(Mask, BitmapRowSpans)
+{
+  for (int i=0; i<500; ++i) {
+    int w = 1 + rand() % 300;
+    std::unique_ptr<Image> bmp(Image::create(IMAGE_BITMAP, w, 1));
+    random_bitmap(bmp.get(), rand() % 101);
+
+    int x1 = rand() % w;
+    int x2 = x1 + rand() % (w-x1);
+    std::vector<int> expected(w, 0), result(w, 0);
+    for (int x=x1; x<=x2; ++x)
+      expected[x] = get_pixel_fast<BitmapTraits>(bmp.get(), x, 0);
+
+    BitmapRowSpans spans(bmp.get(), 0, x1, x2);
+    int u1, u2, last = -2;
+    while (spans.next(u1, u2)) {
+      ASSERT_LE(u1, u2);
+      ASSERT_LT(last+1, u1);    // Spans must not be contiguous
+      for (int x=u1; x<=u2; ++x)
+        result[x] = 1;
+      last = u2;
+    }
+    ASSERT_EQ(expected, result);
+  }
+}
+
+TEST(Mask, InvertAndShrink)
+{
+  Mask mask;
+  mask.add(gfx::Rect(10, 20, 70, 30));
+  mask.subtract(gfx::Rect(10, 20, 5, 30));
+  EXPECT_EQ(gfx::Rect(15, 20, 65, 30), mask.bounds());
+  EXPECT_TRUE(mask.isRectangular());
+
+  mask.add(gfx::Rect(0, 0, 1, 1));
+  EXPECT_EQ(gfx::Rect(0, 0, 80, 50), mask.bounds());
+  EXPECT_FALSE(mask.isRectangular());
+
+  mask.invert();
+  EXPECT_EQ(gfx::Rect(0, 0, 80, 50), mask.bounds());
+  EXPECT_FALSE(mask.containsPoint(0, 0));
+  EXPECT_TRUE(mask.containsPoint(1, 0));
+  EXPECT_TRUE(mask.containsPoint(14, 49));
+  EXPECT_FALSE(mask.containsPoint(15, 20));
+
+  mask.intersect(gfx::Rect(0, 10, 15, 40));
+  EXPECT_EQ(gfx::Rect(0, 10, 15, 40), mask.bounds());
+  EXPECT_TRUE(mask.isRectangular());
+}
+
+TEST(Mask, ByColor)
+{
+  std::unique_ptr<Image> image(Image::create(IMAGE_INDEXED, 37, 11));
+  clear_image(image.get(), 0);
+  fill_rect(image.get(), 3, 2, 20, 8, 5);
+  put_pixel(image.get(), 36, 10, 6);
+
+  Mask mask;
+  mask.byColor(image.get(), 5, 0);
+  EXPECT_EQ(gfx::Rect(3, 2, 18, 7), mask.bounds());
+  EXPECT_TRUE(mask.isRectangular());
+
+  mask.byColor(image.get(), 5, 1);
+  EXPECT_EQ(gfx::Rect(3, 2, 34, 9), mask.bounds());
+  EXPECT_FALSE(mask.isRectangular());
+
+  mask.byColor(image.get(), 9, 0);
+  EXPECT_TRUE(mask.isEmpty());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <mutex>
 
 namespace doc {
 
@@ -188,6 +189,7 @@ int Palette::findExactMatch(int r, int g, int b, int a, int mask_index) const
 // Based on Allegro's bestfit_color
 
 static std::vector<uint32_t> col_diff;
+static std::once_flag col_diff_once; // findBestfit() can be used from several threads
 static uint32_t* col_diff_g;
 static uint32_t* col_diff_r;
 static uint32_t* col_diff_b;
@@ -217,8 +219,7 @@ int Palette::findBestfit(int r, int g, int b, int a, int mask_index) const
   ASSERT(b >= 0 && b <= 255);
   ASSERT(a >= 0 && a <= 255);
 
-  if (col_diff.empty())
-    initBestfit();
+  std::call_once(col_diff_once, initBestfit);
 
   r >>= 3;
   g >>= 3;
@@ -0,0 +1,161 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/palette_kdtree.h"
+
+#include "base/base.h"
+#include "doc/palette.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace doc {
+
+// Weights of each component used in Palette::findBestfit()
+static const int weights[4] = { 30*30, 59*59, 11*11, 8*8 };
+
+PaletteKdTree::PaletteKdTree()
+  : m_maskIndex(-1)
+{
+}
+
+void PaletteKdTree::regenerate(const Palette* palette, int maskIndex)
+{
+  m_maskIndex = maskIndex;
+
+  // The first entry with each color is the one found by
+  // Palette::findExactMatch()
+  m_exact.clear();
+  for (int i=palette->size()-1; i>=0; --i)
+    if (i != maskIndex)
+      m_exact[palette->getEntry(i)] = i;
+
+  // Palette::findBestfit() uses the first 256 entries only
+  m_nodes.clear();
+  int size = MIN(256, palette->size());
+  for (int i=0; i<size; ++i) {
+    if (i == maskIndex)
+      continue;
+
+    color_t color = palette->getEntry(i);
+    Node node;
+    node.c[0] = rgba_getr(color) >> 3;
+    node.c[1] = rgba_getg(color) >> 3;
+    node.c[2] = rgba_getb(color) >> 3;
+    node.c[3] = rgba_geta(color) >> 3;
+    node.index = i;
+    node.axis = 0;
+    m_nodes.push_back(node);
+  }
+
+  build(0, int(m_nodes.size()));
+}
+
+int PaletteKdTree::findExactMatch(int r, int g, int b, int a) const
+{
+  auto it = m_exact.find(rgba(r, g, b, a));
+  if (it != m_exact.end())
+    return it->second;
+  else
+    return -1;
+}
+
+int PaletteKdTree::findBestfit(int r, int g, int b, int a) const
+{
+  ASSERT(r >= 0 && r <= 255);
+  ASSERT(g >= 0 && g <= 255);
+  ASSERT(b >= 0 && b <= 255);
+  ASSERT(a >= 0 && a <= 255);
+
+  int c[4] = { r >> 3, g >> 3, b >> 3, a >> 3 };
+
+  // Mask index is like alpha = 0, so we can use it as transparent color.
+  if (c[3] == 0 && m_maskIndex >= 0)
+    return m_maskIndex;
+
+  int bestDiff = std::numeric_limits<int>::max();
+  int bestIndex = 0;
+  search(0, int(m_nodes.size()), c, bestDiff, bestIndex);
+  return bestIndex;
+}
+
+void PaletteKdTree::build(int begin, int end)
+{
+  if (end - begin < 2)
+    return;
+
+  // Split the axis where the entries are more spread
+  int axis = 0;
+  int maxSpread = -1;
+  for (int i=0; i<4; ++i) {
+    int min = 31, max = 0;
+    for (int j=begin; j<end; ++j) {
+      min = MIN(min, m_nodes[j].c[i]);
+      max = MAX(max, m_nodes[j].c[i]);
+    }
+    int spread = (max - min) * (max - min) * weights[i];
+    if (spread > maxSpread) {
+      maxSpread = spread;
+      axis = i;
+    }
+  }
+
+  int mid = (begin + end) / 2;
+  std::nth_element(m_nodes.begin()+begin,
+                   m_nodes.begin()+mid,
+                   m_nodes.begin()+end,
+                   [axis](const Node& a, const Node& b) {
+                     return a.c[axis] < b.c[axis];
+                   });
+  m_nodes[mid].axis = axis;
+
+  build(begin, mid);
+  build(mid+1, end);
+}
+
+void PaletteKdTree::search(int begin, int end, const int* c,
+                           int& bestDiff, int& bestIndex) const
+{
+  if (begin >= end)
+    return;
+
+  int mid = (begin + end) / 2;
+  const Node& node = m_nodes[mid];
+
+  int diff = 0;
+  for (int i=0; i<4; ++i)
+    diff += (node.c[i] - c[i]) * (node.c[i] - c[i]) * weights[i];
+
+  // Like Palette::findBestfit() we prefer the first entry when there
+  // are several entries at the same distance
+  if (diff < bestDiff || (diff == bestDiff && node.index < bestIndex)) {
+    bestDiff = diff;
+    bestIndex = node.index;
+  }
+
+  if (end - begin == 1)
+    return;
+
+  int axisDiff = c[node.axis] - node.c[node.axis];
+  int axisDist = axisDiff * axisDiff * weights[node.axis];
+
+  if (axisDiff < 0) {
+    search(begin, mid, c, bestDiff, bestIndex);
+    if (axisDist <= bestDiff)
+      search(mid+1, end, c, bestDiff, bestIndex);
+  }
+  else {
+    search(mid+1, end, c, bestDiff, bestIndex);
+    if (axisDist <= bestDiff)
+      search(begin, mid, c, bestDiff, bestIndex);
+  }
+}
+
+} // namespace doc
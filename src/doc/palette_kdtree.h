@@ -0,0 +1,57 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#pragma once
+
+#include "doc/color.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace doc {
+
+  class Palette;
+
+  // Finds colors in a palette with the same results as
+  // Palette::findExactMatch() and Palette::findBestfit(), but without
+  // comparing the color with each palette entry: exact matches are
+  // found in a hash table, and the best fit through a k-d tree of
+  // the palette entries.
+  class PaletteKdTree {
+  public:
+    PaletteKdTree();
+
+    // Creates the tree for the current entries of the palette, it
+    // must be called again if the palette is modified.
+    void regenerate(const Palette* palette, int maskIndex);
+
+    int maskIndex() const { return m_maskIndex; }
+
+    // Same as palette->findExactMatch(r, g, b, a, maskIndex)
+    int findExactMatch(int r, int g, int b, int a) const;
+
+    // Same as palette->findBestfit(r, g, b, a, maskIndex)
+    int findBestfit(int r, int g, int b, int a) const;
+
+  private:
+    struct Node {
+      int c[4];                 // 5-bit R, G, B, A components
+      int index;                // Palette entry
+      int axis;                 // Axis used to split the children
+    };
+
+    void build(int begin, int end);
+    void search(int begin, int end, const int* c,
+                int& bestDiff, int& bestIndex) const;
+
+    // Nodes of the tree, the root of each [begin,end) range is the
+    // node in the middle
+    std::vector<Node> m_nodes;
+    std::unordered_map<color_t, int> m_exact;
+    int m_maskIndex;
+  };
+
+} // namespace doc
@@ -0,0 +1,101 @@
+// Aseprite Document Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/palette.h"
+#include "doc/palette_kdtree.h"
+#include "doc/rgbmap.h"
+
+#include <cstdlib>
+
+using namespace doc;
+
+namespace {
+
+int random_component()
+{
+  // Repeat some values to test entries at the same distance
+  return (std::rand() % 2) ? (std::rand() % 4) * 85: std::rand() % 256;
+}
+
+color_t random_color()
+{
+  return rgba(random_component(),
+              random_component(),
+              random_component(),
+              (std::rand() % 4) ? 255: random_component());
+}
+
+} // anonymous namespace
+
+TEST(PaletteKdTree, SameResultsAsPalette)
+{
+  std::srand(1);
+
+  for (int size : { 1, 2, 3, 16, 255, 256, 300 }) {
+    auto pal = Palette::create(size);
+    for (int i=0; i<size; ++i)
+      pal->setEntry(i, random_color());
+
+    // Duplicated entries
+    if (size > 3)
+      pal->setEntry(size-1, pal->getEntry(1));
+
+    for (int mask : { -1, 0, 1, size-1 }) {
+      PaletteKdTree tree;
+      tree.regenerate(pal.get(), mask);
+
+      for (int i=0; i<size; ++i) {
+        color_t c = pal->getEntry(i);
+        int r = rgba_getr(c), g = rgba_getg(c), b = rgba_getb(c), a = rgba_geta(c);
+        EXPECT_EQ(pal->findExactMatch(r, g, b, a, mask), tree.findExactMatch(r, g, b, a));
+        EXPECT_EQ(pal->findBestfit(r, g, b, a, mask), tree.findBestfit(r, g, b, a));
+      }
+
+      for (int i=0; i<1000; ++i) {
+        color_t c = random_color();
+        int r = rgba_getr(c), g = rgba_getg(c), b = rgba_getb(c), a = rgba_geta(c);
+        EXPECT_EQ(pal->findExactMatch(r, g, b, a, mask), tree.findExactMatch(r, g, b, a));
+        EXPECT_EQ(pal->findBestfit(r, g, b, a, mask), tree.findBestfit(r, g, b, a));
+      }
+    }
+  }
+}
+
+TEST(PaletteKdTree, RgbMap)
+{
+  auto pal = Palette::create(4);
+  pal->setEntry(0, rgba(0, 0, 0, 0));
+  pal->setEntry(1, rgba(255, 0, 0, 255));
+  pal->setEntry(2, rgba(0, 255, 0, 255));
+  pal->setEntry(3, rgba(255, 0, 0, 255));
+
+  RgbMap rgbmap;
+  rgbmap.regenerate(pal.get(), 0);
+  EXPECT_EQ(0, rgbmap.mapColor(10, 20, 30, 0));
+  EXPECT_EQ(1, rgbmap.mapColor(250, 10, 0, 255));
+  EXPECT_EQ(2, rgbmap.mapColor(0, 200, 0, 255));
+  EXPECT_EQ(1, rgbmap.findExactMatch(255, 0, 0, 255));
+  EXPECT_EQ(-1, rgbmap.findExactMatch(0, 0, 0, 0));
+  EXPECT_EQ(-1, rgbmap.findExactMatch(0, 0, 255, 255));
+
+  pal->setEntry(1, rgba(0, 0, 255, 255));
+  rgbmap.regenerate(pal.get(), -1);
+  EXPECT_EQ(0, rgbmap.findExactMatch(0, 0, 0, 0));
+  EXPECT_EQ(1, rgbmap.findExactMatch(0, 0, 255, 255));
+  EXPECT_EQ(3, rgbmap.mapColor(250, 10, 0, 255));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
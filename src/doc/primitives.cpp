@@ -17,6 +17,7 @@
 #include "doc/remap.h"
 #include "doc/rgbmap.h"
 
+#include <cstring>
 #include <stdexcept>
 
 namespace doc {
@@ -334,6 +335,36 @@ int count_diff_between_images(const Image* i1, const Image* i2)
   return -1;
 }
 
+bool is_same_image(const Image* i1, const Image* i2)
+{
+  if (i1 == i2)
+    return true;
+
+  if ((i1->pixelFormat() != i2->pixelFormat()) ||
+      (i1->width() != i2->width()) ||
+      (i1->height() != i2->height()) ||
+      (i1->contentHash() != i2->contentHash()))
+    return false;
+
+  int rowBytes = i1->getRowStrideSize();
+  int lastBits = 0;
+  if (i1->pixelFormat() == IMAGE_BITMAP && (i1->width() & 7)) {
+    --rowBytes;
+    lastBits = (i1->width() & 7);
+  }
+
+  for (int y=0; y<i1->height(); ++y) {
+    const uint8_t* row1 = i1->getPixelAddress(0, y);
+    const uint8_t* row2 = i2->getPixelAddress(0, y);
+    if (std::memcmp(row1, row2, rowBytes) != 0)
+      return false;
+    if (lastBits &&
+        ((row1[rowBytes] ^ row2[rowBytes]) & ((1 << lastBits) - 1)))
+      return false;
+  }
+  return true;
+}
+
 void remap_image(Image* image, const Remap& remap)
 {
   ASSERT(image->pixelFormat() == IMAGE_INDEXED);
@@ -39,6 +39,11 @@ namespace doc {
 
   int count_diff_between_images(const Image* i1, const Image* i2);
 
+  // Returns true if both images have the same format, size and
+  // pixels. Images with different Image::contentHash() are discarded
+  // without comparing pixels.
+  bool is_same_image(const Image* i1, const Image* i2);
+
   void remap_image(Image* image, const Remap& remap);
 
 } // namespace doc
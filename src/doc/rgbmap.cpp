@@ -41,6 +41,7 @@ void RgbMap::regenerate(const Palette* palette, int mask_index)
   m_palette = palette;
   m_modifications = palette->getModifications();
   m_maskIndex = mask_index;
+  m_tree.regenerate(palette, mask_index);
 
   // Mark all entries as invalid (need to be regenerated)
   for (uint16_t& entry : m_map)
@@ -50,11 +51,11 @@ void RgbMap::regenerate(const Palette* palette, int mask_index)
 int RgbMap::generateEntry(int i, int r, int g, int b, int a) const
 {
   return m_map[i] =
-    m_palette->findBestfit(
+    m_tree.findBestfit(
       scale_5bits_to_8bits(r>>3),
       scale_5bits_to_8bits(g>>3),
       scale_5bits_to_8bits(b>>3),
-      scale_3bits_to_8bits(a>>5), m_maskIndex);
+      scale_3bits_to_8bits(a>>5));
 }
 
 } // namespace doc
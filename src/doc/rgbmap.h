@@ -9,6 +9,7 @@
 #include "base/debug.h"
 #include "base/disable_copying.h"
 #include "doc/object.h"
+#include "doc/palette_kdtree.h"
 
 #include <vector>
 
@@ -38,12 +39,19 @@ namespace doc {
       return (v & INVALID) ? generateEntry(i, r, g, b, a): v;
     }
 
+    // Same as Palette::findExactMatch() with the mask index of the
+    // map, but it doesn't need to iterate the whole palette.
+    int findExactMatch(int r, int g, int b, int a) const {
+      return m_tree.findExactMatch(r, g, b, a);
+    }
+
     int maskIndex() const { return m_maskIndex; }
 
   private:
     int generateEntry(int i, int r, int g, int b, int a) const;
 
     mutable std::vector<uint16_t> m_map;
+    PaletteKdTree m_tree;
     const Palette* m_palette;
     int m_modifications;
     int m_maskIndex;
@@ -171,10 +171,12 @@ int Sprite::getMemSize() const
 {
   int size = 0;
 
-  std::vector<Image*> images;
-  getImages(images);
-  for (Image* image : images)
-    size += image->getRowStrideSize() * image->height();
+  // Pending images (not loaded yet) are counted too, but without
+  // loading them
+  for (const auto& cel : uniqueCels()) {
+    gfx::Rect bounds = cel->data()->bounds();
+    size += calculate_rowstride_bytes(pixelFormat(), bounds.w) * bounds.h;
+  }
 
   return size;
 }
@@ -16,6 +16,8 @@
 #include "doc/pixel_format.h"
 #include "doc/sprite.h"
 
+#include <vector>
+
 using namespace doc;
 
 // lay1 = A _ B
@@ -31,16 +33,16 @@ TEST(Sprite, CelsRange)
   spr->folder()->addLayer(lay2);
 
   ImageRef imgA(Image::create(IMAGE_RGB, 32, 32));
-  Cel* celA = new Cel(frame_t(0), imgA);
-  Cel* celB = Cel::createLink(celA);
+  auto celA = std::make_shared<Cel>(frame_t(0), imgA);
+  auto celB = Cel::createLink(celA);
   celB->setFrame(frame_t(2));
   lay1->addCel(celA);
   lay1->addCel(celB);
 
   ImageRef imgC(Image::create(IMAGE_RGB, 32, 32));
-  Cel* celC = new Cel(frame_t(0), imgC);
-  Cel* celD = Cel::createCopy(celC);
-  Cel* celE = Cel::createLink(celD);
+  auto celC = std::make_shared<Cel>(frame_t(0), imgC);
+  auto celD = Cel::createCopy(celC);
+  auto celE = Cel::createLink(celD);
   celD->setFrame(frame_t(1));
   celE->setFrame(frame_t(2));
   lay2->addCel(celC);
@@ -48,7 +50,7 @@ TEST(Sprite, CelsRange)
   lay2->addCel(celE);
 
   int i = 0;
-  for (Cel* cel : spr->cels()) {
+  for (auto cel : spr->cels()) {
     switch (i) {
       case 0: EXPECT_EQ(cel, celA); break;
       case 1: EXPECT_EQ(cel, celB); break;
@@ -61,7 +63,7 @@ TEST(Sprite, CelsRange)
   EXPECT_EQ(5, i);
 
   i = 0;
-  for (Cel* cel : spr->uniqueCels()) {
+  for (auto cel : spr->uniqueCels()) {
     switch (i) {
       case 0: EXPECT_EQ(cel, celA); break;
       case 1: EXPECT_EQ(cel, celC); break;
@@ -72,7 +74,7 @@ TEST(Sprite, CelsRange)
   EXPECT_EQ(3, i);
 
   i = 0;
-  for (Cel* cel : spr->cels(frame_t(0))) {
+  for (auto cel : spr->cels(frame_t(0))) {
     switch (i) {
       case 0: EXPECT_EQ(cel, celA); break;
       case 1: EXPECT_EQ(cel, celC); break;
@@ -82,7 +84,7 @@ TEST(Sprite, CelsRange)
   EXPECT_EQ(2, i);
 
   i = 0;
-  for (Cel* cel : spr->cels(frame_t(1))) {
+  for (auto cel : spr->cels(frame_t(1))) {
     switch (i) {
       case 0: EXPECT_EQ(cel, celD); break;
     }
@@ -91,7 +93,7 @@ TEST(Sprite, CelsRange)
   EXPECT_EQ(1, i);
 
   i = 0;
-  for (Cel* cel : spr->cels(frame_t(2))) {
+  for (auto cel : spr->cels(frame_t(2))) {
     switch (i) {
       case 0: EXPECT_EQ(cel, celB); break;
       case 1: EXPECT_EQ(cel, celE); break;
@@ -99,6 +101,104 @@ TEST(Sprite, CelsRange)
     ++i;
   }
   EXPECT_EQ(2, i);
+
+  EXPECT_EQ(celA, lay1->cel(frame_t(0)));
+  EXPECT_EQ(nullptr, lay1->cel(frame_t(1)));
+  EXPECT_EQ(celB, lay1->cel(frame_t(2)));
+  EXPECT_EQ(nullptr, lay1->cel(frame_t(3)));
+
+  lay1->moveCel(celB, frame_t(1));
+  EXPECT_EQ(celB, lay1->cel(frame_t(1)));
+  EXPECT_EQ(nullptr, lay1->cel(frame_t(2)));
+
+  i = 0;
+  for (auto cel : spr->uniqueCels()) {
+    (void)cel;
+    ++i;
+  }
+  EXPECT_EQ(3, i);
+}
+
+// lay1 = A B A A (and the same in frames 4..63 with a long animation)
+// lay2 = C C D _
+static void test_unique_cels(frame_t frames)
+{
+  Sprite* spr = new Sprite(IMAGE_RGB, 32, 32, 256);
+  spr->setTotalFrames(frames);
+
+  LayerImage* lay1 = new LayerImage(spr);
+  LayerImage* lay2 = new LayerImage(spr);
+  spr->folder()->addLayer(lay1);
+  spr->folder()->addLayer(lay2);
+
+  auto celA = std::make_shared<Cel>(frame_t(0), ImageRef(Image::create(IMAGE_RGB, 32, 32)));
+  auto celB = std::make_shared<Cel>(frame_t(1), ImageRef(Image::create(IMAGE_RGB, 32, 32)));
+  lay1->addCel(celA);
+  lay1->addCel(celB);
+  for (frame_t f=2; f<frames; ++f) {
+    auto link = Cel::createLink(f % 4 == 1 ? celB: celA);
+    link->setFrame(f);
+    lay1->addCel(link);
+  }
+
+  auto celC = std::make_shared<Cel>(frame_t(0), ImageRef(Image::create(IMAGE_RGB, 32, 32)));
+  auto celC2 = Cel::createLink(celC);
+  auto celD = std::make_shared<Cel>(frame_t(2), ImageRef(Image::create(IMAGE_RGB, 32, 32)));
+  celC2->setFrame(frame_t(1));
+  lay2->addCel(celC);
+  lay2->addCel(celC2);
+  lay2->addCel(celD);
+
+  std::vector<Cel*> expected = { celA.get(), celB.get(), celC.get(), celD.get() };
+
+  // Iterate the same range two times
+  CelsRange range = spr->uniqueCels();
+  for (int j=0; j<2; ++j) {
+    std::vector<Cel*> result;
+    for (auto cel : range)
+      result.push_back(cel.get());
+    EXPECT_EQ(expected, result);
+  }
+
+  // Nested traversals
+  int outer = 0;
+  for (auto cel : spr->uniqueCels()) {
+    (void)cel;
+    std::vector<Cel*> result;
+    for (auto cel2 : spr->uniqueCels())
+      result.push_back(cel2.get());
+    EXPECT_EQ(expected, result);
+    ++outer;
+  }
+  EXPECT_EQ(4, outer);
+
+  // A range that starts in a linked cel returns it
+  std::vector<Cel*> result;
+  for (auto cel : spr->uniqueCels(frame_t(2), frame_t(3)))
+    result.push_back(cel.get());
+  ASSERT_EQ(2, int(result.size()));
+  EXPECT_EQ(lay1->cel(frame_t(2)).get(), result[0]);
+  EXPECT_EQ(celD.get(), result[1]);
+
+  // Unlink a cel (it has its own CelData now)
+  celC2->setDataRef(CelDataRef(new CelData(*celC->data())));
+  expected = { celA.get(), celB.get(), celC.get(), celC2.get(), celD.get() };
+  result.clear();
+  for (auto cel : spr->uniqueCels())
+    result.push_back(cel.get());
+  EXPECT_EQ(expected, result);
+
+  delete spr;
+}
+
+TEST(Sprite, UniqueCels)
+{
+  test_unique_cels(frame_t(4));
+}
+
+TEST(Sprite, UniqueCelsInLongAnimation)
+{
+  test_unique_cels(frame_t(64));
 }
 
 int main(int argc, char** argv)
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <limits>
+#include <unordered_set>
 #include <vector>
 
 #include "doc/color.h"
@@ -59,13 +60,11 @@ namespace render {
       // image has more than 256 colors the m_histogram is used
       // instead.
       if (m_useHighPrecision) {
-        std::vector<doc::color_t>::iterator it =
-          std::find(m_highPrecision.begin(), m_highPrecision.end(), color);
-
         // The color is not in the high-precision table
-        if (it == m_highPrecision.end()) {
+        if (m_highPrecisionSet.find(color) == m_highPrecisionSet.end()) {
           if (m_highPrecision.size() < 256) {
             m_highPrecision.push_back(color);
+            m_highPrecisionSet.insert(color);
           }
           else {
             // In this case we reach the limit for the high-precision histogram.
@@ -126,6 +125,10 @@ namespace render {
     // source images contains less than 256 colors.
     std::vector<doc::color_t> m_highPrecision;
 
+    // Same colors as m_highPrecision to look up them quickly (the
+    // vector keeps the order in which the colors were added).
+    std::unordered_set<doc::color_t> m_highPrecisionSet;
+
     // True if we can use m_highPrecision still (it means that the
     // number of different samples is less than 256 colors still).
     bool m_useHighPrecision;
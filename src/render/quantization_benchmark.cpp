@@ -0,0 +1,181 @@
+// Aseprite Render Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+// Measures how many frames per second of an RGB animation can be
+// quantized to indexed colors (like the GIF encoder does for each
+// frame), comparing the linear search in the palette with the
+// RgbMap/PaletteKdTree and the reuse of the RgbMap of the previous
+// frame.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "doc/image.h"
+#include "doc/image_impl.h"
+#include "doc/image_ref.h"
+#include "doc/palette.h"
+#include "doc/primitives.h"
+#include "doc/primitives_fast.h"
+#include "doc/rgbmap.h"
+#include "render/quantization.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace doc;
+
+namespace {
+
+const int kWidth = 256;
+const int kHeight = 256;
+const int kFrames = 16;
+
+// Animation with thousands of colors in each frame (a moving
+// gradient with some noise).
+std::vector<ImageRef> create_gradient_animation()
+{
+  std::srand(1);
+
+  std::vector<ImageRef> frames;
+  for (int f=0; f<kFrames; ++f) {
+    ImageRef image(Image::create(IMAGE_RGB, kWidth, kHeight));
+    for (int y=0; y<kHeight; ++y)
+      for (int x=0; x<kWidth; ++x)
+        put_pixel_fast<RgbTraits>(
+          image.get(), x, y,
+          rgba((x + f*4) & 255,
+               (y + f*2) & 255,
+               ((x + y) / 2 + std::rand() % 8) & 255,
+               255));
+    frames.push_back(image);
+  }
+  return frames;
+}
+
+// Animation with the same 16 colors in all frames (like pixel-art
+// with a small palette moving in the canvas).
+std::vector<ImageRef> create_few_colors_animation()
+{
+  std::srand(2);
+
+  color_t colors[16];
+  for (color_t& c : colors)
+    c = rgba(std::rand() % 256, std::rand() % 256, std::rand() % 256, 255);
+
+  std::vector<ImageRef> frames;
+  for (int f=0; f<kFrames; ++f) {
+    ImageRef image(Image::create(IMAGE_RGB, kWidth, kHeight));
+    for (int y=0; y<kHeight; ++y)
+      for (int x=0; x<kWidth; ++x)
+        put_pixel_fast<RgbTraits>(
+          image.get(), x, y,
+          colors[((x + f) / 16 + (y / 16)) & 15]);
+    frames.push_back(image);
+  }
+  return frames;
+}
+
+std::shared_ptr<Palette> create_palette(const Image* image)
+{
+  render::PaletteOptimizer optimizer;
+  for (const auto& color : LockImageBits<RgbTraits>(image))
+    optimizer.feedWithRgbaColor(color);
+
+  auto palette = Palette::create(256);
+  optimizer.calculate(*palette, 0, nullptr);
+  return palette;
+}
+
+// Converts the frame using Palette functions directly (one linear
+// search over the palette entries for each pixel).
+int map_linear(const Image* image, const Palette* palette)
+{
+  int sum = 0;
+  for (const auto& color : LockImageBits<RgbTraits>(image)) {
+    int r = rgba_getr(color), g = rgba_getg(color), b = rgba_getb(color);
+    int i = palette->findExactMatch(r, g, b, 255, 0);
+    if (i < 0)
+      i = palette->findBestfit(r, g, b, 255, 0);
+    sum += i;
+  }
+  return sum;
+}
+
+int map_rgbmap(const Image* image, const RgbMap& rgbmap)
+{
+  int sum = 0;
+  for (const auto& color : LockImageBits<RgbTraits>(image)) {
+    int r = rgba_getr(color), g = rgba_getg(color), b = rgba_getb(color);
+    int i = rgbmap.findExactMatch(r, g, b, 255);
+    if (i < 0)
+      i = rgbmap.mapColor(r, g, b, 255);
+    sum += i;
+  }
+  return sum;
+}
+
+template<typename Func>
+void run(const char* name, const std::vector<ImageRef>& frames, Func func)
+{
+  auto t0 = std::chrono::steady_clock::now();
+  int sum = 0;
+  for (const ImageRef& frame : frames)
+    sum += func(frame.get());
+  auto t1 = std::chrono::steady_clock::now();
+
+  double secs = std::chrono::duration<double>(t1 - t0).count();
+  std::printf("  %-32s %8.1f fps  (checksum %d)\n",
+              name, double(frames.size()) / secs, sum);
+}
+
+void benchmark(const char* name, const std::vector<ImageRef>& frames)
+{
+  std::printf("%s (%d frames of %dx%d)\n", name, kFrames, kWidth, kHeight);
+
+  run("palette", frames,
+      [](const Image* image) {
+        return create_palette(image)->size();
+      });
+
+  run("palette + linear search", frames,
+      [](const Image* image) {
+        auto palette = create_palette(image);
+        return map_linear(image, palette.get());
+      });
+
+  run("palette + new RgbMap", frames,
+      [](const Image* image) {
+        auto palette = create_palette(image);
+        RgbMap rgbmap;
+        rgbmap.regenerate(palette.get(), 0);
+        return map_rgbmap(image, rgbmap);
+      });
+
+  std::shared_ptr<Palette> lastPalette;
+  RgbMap lastRgbmap;
+  run("palette + reused RgbMap", frames,
+      [&lastPalette, &lastRgbmap](const Image* image) {
+        auto palette = create_palette(image);
+        if (!lastPalette || *lastPalette != *palette) {
+          lastPalette = palette;
+          lastRgbmap.regenerate(palette.get(), 0);
+        }
+        return map_rgbmap(image, lastRgbmap);
+      });
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[])
+{
+  benchmark("Gradient", create_gradient_animation());
+  benchmark("Few colors", create_few_colors_animation());
+  return 0;
+}
@@ -0,0 +1,192 @@
+// Undo Library
+// LibreSprite - Copyright (C) 2026  LibreSprite contributors
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "test.h"
+
+#include "cmd.h"
+#include "undo_history.h"
+#include "undo_state.h"
+
+using namespace undo;
+
+class Counter : public UndoHistoryDelegate {
+public:
+  int deleted = 0;
+  int before = 0;
+  int after = 0;
+  void onDeleteUndoState(UndoState* state) override { ++deleted; }
+  void onBeforeUndoRedoState(const UndoState* state) override { ++before; }
+  void onAfterUndoRedoState(const UndoState* state) override { ++after; }
+};
+
+static void test_linear()
+{
+  int model = 0;
+  Cmd cmd1(model, 1, 0);
+  Cmd cmd2(model, 2, 1);
+  Cmd cmd3(model, 3, 2);
+
+  Counter counter;
+  UndoHistory history(&counter);
+  cmd1.redo(); history.add(&cmd1);
+  cmd2.redo(); history.add(&cmd2);
+  cmd3.redo(); history.add(&cmd3);
+
+  EXPECT_TRUE(history.deleteFirstState());
+  EXPECT_EQ(1, counter.deleted);
+  EXPECT_EQ(&cmd2, history.firstState()->cmd());
+
+  history.undo();
+  EXPECT_EQ(2, model);
+  history.undo();
+  EXPECT_EQ(1, model);
+  EXPECT_FALSE(history.canUndo());
+
+  // The current state (initial state) cannot be deleted
+  history.redo();
+  history.redo();
+  EXPECT_EQ(3, model);
+  EXPECT_TRUE(history.deleteFirstState());
+  EXPECT_FALSE(history.deleteFirstState());
+  EXPECT_EQ(2, counter.deleted);
+  EXPECT_EQ(history.firstState(), history.currentState());
+}
+
+static void test_branch_from_first()
+{
+  // 1 --- 2
+  //  |
+  //   ------ 3 --- 4
+  int model = 0;
+  Cmd cmd1(model, 1, 0);
+  Cmd cmd2(model, 2, 1);
+  Cmd cmd3(model, 3, 1);
+  Cmd cmd4(model, 4, 3);
+
+  Counter counter;
+  UndoHistory history(&counter);
+  cmd1.redo(); history.add(&cmd1);
+  cmd2.redo(); history.add(&cmd2);
+  history.undo();
+  cmd3.redo(); history.add(&cmd3);
+  cmd4.redo(); history.add(&cmd4);
+
+  // All states depend on 1, so only 1 is deleted
+  EXPECT_TRUE(history.deleteFirstState());
+  EXPECT_EQ(1, counter.deleted);
+
+  history.undo();
+  EXPECT_EQ(3, model);
+  history.undo();
+  EXPECT_EQ(2, model);
+  history.undo();
+  EXPECT_EQ(1, model);
+  EXPECT_FALSE(history.canUndo());
+}
+
+static void test_branch_from_initial_state()
+{
+  // 1 --- 2
+  //
+  // 3 --- 4  (created after undoing 1)
+  int model = 0;
+  Cmd cmd1(model, 1, 0);
+  Cmd cmd2(model, 2, 1);
+  Cmd cmd3(model, 3, 0);
+  Cmd cmd4(model, 4, 3);
+
+  Counter counter;
+  UndoHistory history(&counter);
+  cmd1.redo(); history.add(&cmd1);
+  cmd2.redo(); history.add(&cmd2);
+  history.undo();
+  history.undo();
+  cmd3.redo(); history.add(&cmd3);
+  cmd4.redo(); history.add(&cmd4);
+
+  // 1 and 2 cannot be reached without undoing/redoing 1
+  EXPECT_TRUE(history.deleteFirstState());
+  EXPECT_EQ(2, counter.deleted);
+  EXPECT_EQ(&cmd3, history.firstState()->cmd());
+
+  history.undo();
+  EXPECT_EQ(3, model);
+  history.undo();
+  EXPECT_EQ(0, model);
+  EXPECT_FALSE(history.canUndo());
+
+  // In the initial state 3 is not applied, so 3 and 4 are deleted
+  EXPECT_TRUE(history.deleteFirstState());
+  EXPECT_EQ(4, counter.deleted);
+  EXPECT_EQ(0, model);
+  EXPECT_FALSE(history.canUndo());
+  EXPECT_FALSE(history.canRedo());
+  EXPECT_FALSE(history.deleteFirstState());
+}
+
+static void test_linear_in_initial_state()
+{
+  int model = 0;
+  Cmd cmd1(model, 1, 0);
+  Cmd cmd2(model, 2, 1);
+
+  Counter counter;
+  UndoHistory history(&counter);
+  cmd1.redo(); history.add(&cmd1);
+  cmd2.redo(); history.add(&cmd2);
+  history.undo();
+  history.undo();
+  EXPECT_EQ(2, counter.before);
+  EXPECT_EQ(2, counter.after);
+
+  // Without the first command no state can be reached
+  EXPECT_TRUE(history.deleteFirstState());
+  EXPECT_EQ(2, counter.deleted);
+  EXPECT_EQ(nullptr, history.firstState());
+  EXPECT_FALSE(history.canRedo());
+}
+
+static void test_linear_after_branch()
+{
+  // 1 --- 2
+  //  |
+  //   ------ 3 --- 4
+  int model = 0;
+  Cmd cmd1(model, 1, 0);
+  Cmd cmd2(model, 2, 1);
+  Cmd cmd3(model, 3, 1);
+  Cmd cmd4(model, 4, 3);
+
+  Counter counter;
+  UndoHistory history(&counter);
+  cmd1.redo(); history.add(&cmd1);
+  cmd2.redo(); history.add(&cmd2);
+  history.undo();
+  cmd3.redo(); history.add(&cmd3);
+  cmd4.redo(); history.add(&cmd4);
+
+  // Delete 1, then 2 (which isn't needed to reach 3 and 4)
+  EXPECT_TRUE(history.deleteFirstState());
+  EXPECT_TRUE(history.deleteFirstState());
+  EXPECT_EQ(2, counter.deleted);
+  EXPECT_EQ(&cmd3, history.firstState()->cmd());
+
+  // Now the history is linear again
+  EXPECT_TRUE(history.deleteFirstState());
+  EXPECT_EQ(3, counter.deleted);
+  EXPECT_EQ(&cmd4, history.firstState()->cmd());
+  EXPECT_EQ(4, model);
+  EXPECT_FALSE(history.deleteFirstState());
+}
+
+int main(int argc, char** argv)
+{
+  test_linear();
+  test_linear_in_initial_state();
+  test_linear_after_branch();
+  test_branch_from_first();
+  test_branch_from_initial_state();
+}
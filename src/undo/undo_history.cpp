@@ -11,18 +11,22 @@
 
 #include <cassert>
 #include <stack>
+#include <unordered_set>
 
 namespace undo {
 
-UndoHistory::UndoHistory()
-  : m_first(nullptr)
+UndoHistory::UndoHistory(UndoHistoryDelegate* delegate)
+  : m_delegate(delegate)
+  , m_first(nullptr)
   , m_last(nullptr)
   , m_cur(nullptr)
+  , m_nonlinearStates(0)
 {
 }
 
 UndoHistory::~UndoHistory()
 {
+  m_delegate = nullptr;
   m_cur = nullptr;
   clearRedo();
 }
@@ -64,7 +68,7 @@ void UndoHistory::clearRedo()
        state && state != m_cur;
        state = prev) {
     prev = state->m_prev;
-    delete state;
+    deleteState(state);
   }
 
   if (m_cur) {
@@ -88,12 +92,88 @@ void UndoHistory::add(UndoCommand* cmd)
 
   m_cur = m_last = state;
 
+  if (isNonlinearState(state))
+    ++m_nonlinearStates;
+
   if (state->m_prev) {
     assert(!state->m_prev->m_next);
     state->m_prev->m_next = state;
   }
 }
 
+bool UndoHistory::deleteFirstState()
+{
+  UndoState* first = m_first;
+  if (!first || first == m_cur)
+    return false;
+
+  // In a linear history all states were created from the first one
+  // (the current state too), so we can delete it without looking for
+  // its descendants.
+  if (m_nonlinearStates == 0 && m_cur) {
+    m_first = first->m_next;
+    if (m_first) {
+      m_first->m_prev = nullptr;
+      m_first->m_parent = nullptr;
+    }
+    else
+      m_last = nullptr;
+
+    deleteState(first);
+    return true;
+  }
+
+  // States are sorted chronologically, so the parent of a state is
+  // always before it in the list. With one pass we can know which
+  // states were created from the first one.
+  std::unordered_set<const UndoState*> descendants;
+  descendants.insert(first);
+  for (const UndoState* state = first->m_next; state; state = state->m_next) {
+    if (state->m_parent && descendants.count(state->m_parent))
+      descendants.insert(state);
+  }
+
+  // If the current state was created from the first state, the
+  // command of the first state will be always applied, so we keep
+  // its descendants. In other case, its descendants cannot be reached
+  // anymore (they need the first command to be redone).
+  const bool keepDescendants = (m_cur && descendants.count(m_cur));
+
+  for (UndoState* state = first, *next; state; state = next) {
+    next = state->m_next;
+
+    if (state != first &&
+        (descendants.count(state) != 0) == keepDescendants) {
+      if (state->m_parent == first)
+        state->m_parent = nullptr;
+      continue;
+    }
+
+    // Unlink the state from the chronological list
+    if (state->m_prev)
+      state->m_prev->m_next = state->m_next;
+    else
+      m_first = state->m_next;
+
+    if (state->m_next)
+      state->m_next->m_prev = state->m_prev;
+    else
+      m_last = state->m_prev;
+
+    deleteState(state);
+  }
+
+  // Links between the remaining states could change
+  m_nonlinearStates = 0;
+  for (const UndoState* state = m_first; state; state = state->m_next) {
+    if (isNonlinearState(state))
+      ++m_nonlinearStates;
+  }
+
+  assert(!m_first || !m_first->m_prev);
+  return true;
+}
+
 const UndoState* UndoHistory::findCommonParent(const UndoState* a,
                                                const UndoState* b)
 {
@@ -122,7 +202,7 @@ void UndoHistory::moveTo(const UndoState* new_state)
 
   if (m_cur) {
     while (m_cur != common) {
-      m_cur->m_cmd->undo();
+      undoRedoState(m_cur, true);
       m_cur = m_cur->m_parent;
     }
   }
@@ -139,11 +219,43 @@ void UndoHistory::moveTo(const UndoState* new_state)
       p = redo_parents.top();
       redo_parents.pop();
 
-      p->m_cmd->redo();
+      undoRedoState(p, false);
+      m_cur = const_cast<UndoState*>(p);
     }
   }
 
   m_cur = const_cast<UndoState*>(new_state);
 }
 
+void UndoHistory::deleteState(UndoState* state)
+{
+  if (m_delegate)
+    m_delegate->onDeleteUndoState(state);
+
+  if (isNonlinearState(state))
+    --m_nonlinearStates;
+
+  delete state;
+}
+
+void UndoHistory::undoRedoState(const UndoState* state, bool undo)
+{
+  if (m_delegate)
+    m_delegate->onBeforeUndoRedoState(state);
+
+  if (undo)
+    state->m_cmd->undo();
+  else
+    state->m_cmd->redo();
+
+  if (m_delegate)
+    m_delegate->onAfterUndoRedoState(state);
+}
+
+// static
+bool UndoHistory::isNonlinearState(const UndoState* state)
+{
+  return (state->m_parent != state->m_prev);
+}
+
 } // namespace undo
@@ -13,9 +13,21 @@ namespace undo {
   class UndoCommand;
   class UndoState;
 
+  class UndoHistoryDelegate {
+  public:
+    virtual ~UndoHistoryDelegate() { }
+    // Called before the given state is deleted from the history
+    // (e.g. by clearRedo() or deleteFirstState()).
+    virtual void onDeleteUndoState(UndoState* state) = 0;
+    // Called before and after the command of the given state is
+    // undone or redone.
+    virtual void onBeforeUndoRedoState(const UndoState* state) { }
+    virtual void onAfterUndoRedoState(const UndoState* state) { }
+  };
+
   class UndoHistory {
   public:
-    UndoHistory();
+    UndoHistory(UndoHistoryDelegate* delegate = nullptr);
     virtual ~UndoHistory();
 
     const UndoState* firstState()   const { return m_first; }
@@ -29,6 +41,13 @@ namespace undo {
     void redo();
     void clearRedo();
 
+    // Deletes the oldest state of the history, so its command cannot
+    // be undone anymore. In a nonlinear history, all the states that
+    // cannot be reached without undoing/redoing the deleted command
+    // are deleted too. Returns false if the first state is the
+    // current one (or the history is empty).
+    bool deleteFirstState();
+
     // This can be used to jump to a specific UndoState in the whole
     // history.
     void moveTo(const UndoState* new_state);
@@ -36,10 +55,17 @@ namespace undo {
   private:
     const UndoState* findCommonParent(const UndoState* a,
                                       const UndoState* b);
+    void deleteState(UndoState* state);
+    void undoRedoState(const UndoState* state, bool undo);
+    static bool isNonlinearState(const UndoState* state);
 
+    UndoHistoryDelegate* m_delegate;
     UndoState* m_first;
     UndoState* m_last;
     UndoState* m_cur;          // Current action that can be undone
+    // Number of states that weren't created from the previous one
+    // (zero in a linear history).
+    int m_nonlinearStates;
   };
 
 } // namespace undo
@@ -32,6 +32,7 @@ namespace undo {
     }
     UndoState* prev() const { return m_prev; }
     UndoState* next() const { return m_next; }
+    UndoState* parent() const { return m_parent; }
     UndoCommand* cmd() const { return m_cmd; }
   private:
     UndoState* m_prev;